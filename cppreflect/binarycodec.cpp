@@ -0,0 +1,1368 @@
+#include "cppreflect.h"
+#include "binaryplan.h"                     //BinaryPlan
+#include "mappedfile.h"                     //MappedFile
+#include "compression.h"                    //BinaryCompressWriter
+#include "binarydecoder.h"                  //BinaryPushDecoder
+#include "pugixml/pugixml.hpp"              //as_utf8
+#include <string.h>                         //memcpy
+#include <limits.h>                         //INT_MAX
+#include <stdint.h>                         //SIZE_MAX
+#include <typeinfo>                         //typeid
+#include <thread>                           //thread
+#include <atomic>                           //atomic
+#include <condition_variable>               //condition_variable
+#include <deque>                            //deque
+#include <exception>                        //exception_ptr
+#include <stdexcept>                        //length_error
+#include <algorithm>                        //min
+
+void BinaryPlan::Compile(ClassTypeInfo& type)
+{
+    ops.clear();
+    swapOps.clear();
+    columnOps.clear();
+    Compile(type, 0);
+
+    fieldOps.clear();
+    for (FieldInfo& fi : type.fields)
+        fieldOps.push_back(MakeFieldOp(fi, 0));
+
+    fixed = true;
+    for (const BinaryOp& op : ops)
+        if (op.kind != binop_copy)
+            fixed = false;
+}
+
+void BinaryPlan::AddCopy(std::vector<BinaryOp>& list, size_t offset, size_t size, size_t unit)
+{
+    if (list.size() && list.back().kind == binop_copy && list.back().offset + list.back().size == offset &&
+        list.back().unit == unit)
+    {
+        // Continues previous run
+        list.back().size += size;
+        return;
+    }
+
+    BinaryOp op = {};
+    op.kind = binop_copy;
+    op.offset = offset;
+    op.size = size;
+    op.unit = unit;
+    list.push_back(op);
+}
+
+//
+//  Scalar size used to byte swap fixed size value, values of other sizes are not swapped.
+//
+static inline size_t GetSwapUnit(size_t size)
+{
+    return (size == 2 || size == 4 || size == 8) ? size : 1;
+}
+
+//
+//  Classifies variable sized type, so std::string / std::wstring can be accessed without virtual calls.
+//
+static BinaryElemKind GetVariableSizeKind(BasicTypeInfo* type)
+{
+    if (typeid(*type) == typeid(BasicTypeInfoT<std::string>))
+        return binelem_string;
+
+    if (typeid(*type) == typeid(BasicTypeInfoT<std::wstring>))
+        return binelem_wstring;
+
+    return binelem_blob;
+}
+
+BinaryOp BinaryPlan::MakeFieldOp(FieldInfo& fi, size_t base)
+{
+    BasicTypeInfo& fieldType = *fi.fieldType;
+    BasicTypeInfo* arrayType = fi.arrayElementType;
+    BinaryOp op = {};
+    op.offset = base + fi.offset;
+    op.type = &fieldType;
+
+    if (!arrayType)
+    {
+        op.elemClass = dynamic_cast<ClassTypeInfo*>(&fieldType);
+        if (op.elemClass)
+        {
+            op.kind = binop_class;
+            return op;
+        }
+
+        op.size = fieldType.GetFixedSize();
+        if (op.size != 0)
+        {
+            op.kind = binop_copy;
+            op.unit = GetSwapUnit(op.size);
+            return op;
+        }
+
+        switch (GetVariableSizeKind(&fieldType))
+        {
+            case binelem_string:    op.kind = binop_string;     break;
+            case binelem_wstring:   op.kind = binop_wstring;    break;
+            default:                op.kind = binop_blob;       break;
+        }
+        return op;
+    }
+
+    op.kind = binop_array;
+    op.size = arrayType->GetSizeOfType();
+    op.elemType = arrayType;
+    op.elemClass = dynamic_cast<ClassTypeInfo*>(arrayType);
+
+    if (op.elemClass)
+        op.elemKind = binelem_class;
+    else if (arrayType->GetFixedSize() != 0)
+    {
+        op.elemKind = binelem_pod;
+        op.unit = GetSwapUnit(op.size);
+    }
+    else
+        op.elemKind = GetVariableSizeKind(arrayType);
+
+    return op;
+}
+
+void BinaryPlan::Compile(ClassTypeInfo& type, size_t base)
+{
+    for (FieldInfo& fi : type.fields)
+    {
+        BinaryOp op = MakeFieldOp(fi, base);
+
+        switch (op.kind)
+        {
+            case binop_class:
+                // Nested class, inline its fields.
+                Compile(*op.elemClass, op.offset);
+                break;
+
+            case binop_copy:
+                // Merged regardless of scalar size, unless byte swapping is needed
+                AddCopy(ops, op.offset, op.size, 0);
+                AddCopy(swapOps, op.offset, op.size, op.unit);
+                columnOps.push_back(op);
+                break;
+
+            default:
+                ops.push_back(op);
+                swapOps.push_back(op);
+                columnOps.push_back(op);
+                break;
+        }
+    }
+}
+
+BinaryPlan& GetBinaryPlan(ClassTypeInfo& type)
+{
+    std::call_once(type.binaryPlanOnce, [&type]()
+    {
+        auto plan = std::make_shared<BinaryPlan>();
+        plan->Compile(type);
+        type.binaryPlan = plan;
+    });
+
+    return *type.binaryPlan;
+}
+
+static inline void BlobToBinaryData(BinaryEncoder& e, const void* p, size_t size)
+{
+    lengthToBinaryData(e, size);
+    e.w.Write(p, size);
+}
+
+static void PlanToBinaryData(BinaryEncoder& e, const char* pclass, BinaryPlan& plan);
+
+//
+//  Parallel loop state, shared with pool threads helping with it.
+//
+struct ParallelJob
+{
+    size_t count;
+    const std::function<void(size_t i)>* f;
+    std::atomic<size_t> next{ 0 };
+    std::exception_ptr error;
+    std::mutex lock;
+    std::condition_variable idle;
+    size_t running = 0;                     // Pool threads working on job
+};
+
+static void RunParallelJob(ParallelJob& job)
+{
+    try {
+        for (size_t i; (i = job.next++) < job.count; )
+            (*job.f)(i);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(job.lock);
+        if (!job.error)
+            job.error = std::current_exception();
+        job.next = job.count;
+    }
+}
+
+//
+//  Threads helping with parallel loops, created on first use and kept for further loops - starting threads for
+//  each loop costs more than decoding of medium sized array.
+//
+class WorkerPool
+{
+public:
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> l(lock);
+            stop = true;
+        }
+        wake.notify_all();
+
+        for (std::thread& t : threads)
+            t.join();
+    }
+
+    //
+    //  Lets helpers pool threads join job, pool grows up to helpers threads.
+    //
+    void Post(const std::shared_ptr<ParallelJob>& job, size_t helpers)
+    {
+        {
+            std::lock_guard<std::mutex> l(lock);
+            while (threads.size() < helpers)
+                threads.emplace_back([this]() { Work(); });
+
+            for (size_t i = 0; i < helpers; i++)
+                jobs.push_back(job);
+        }
+
+        if (helpers == 1)
+            wake.notify_one();
+        else
+            wake.notify_all();
+    }
+
+protected:
+    void Work()
+    {
+        std::unique_lock<std::mutex> l(lock);
+        for (;;)
+        {
+            wake.wait(l, [this]() { return stop || !jobs.empty(); });
+            if (stop)
+                return;
+
+            std::shared_ptr<ParallelJob> job = std::move(jobs.front());
+            jobs.pop_front();
+            l.unlock();
+
+            // Job may be already done, then f is not touched - caller might have returned
+            {
+                std::lock_guard<std::mutex> jl(job->lock);
+                job->running++;
+            }
+
+            RunParallelJob(*job);
+
+            {
+                std::lock_guard<std::mutex> jl(job->lock);
+                if (--job->running == 0)
+                    job->idle.notify_all();
+            }
+
+            l.lock();
+        }
+    }
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<ParallelJob>> jobs;
+    std::vector<std::thread> threads;
+    bool stop = false;
+};
+
+void ParallelFor(size_t count, int threads, const std::function<void(size_t i)>& f)
+{
+    // Decode resource (typically std::pmr::monotonic_buffer_resource) is not thread safe, so all work is done by
+    // calling thread, which has the resource set.
+    if (currentDecodeResource)
+        threads = 1;
+
+    auto job = std::make_shared<ParallelJob>();
+    job->count = count;
+    job->f = &f;
+
+    size_t helpers = threads > 1 ? std::min((size_t)threads, count) - 1 : 0;
+    if (helpers)
+    {
+        static WorkerPool pool;
+        pool.Post(job, helpers);
+    }
+
+    RunParallelJob(*job);
+
+    // Wait for pool threads still working on last indexes
+    std::unique_lock<std::mutex> l(job->lock);
+    job->idle.wait(l, [&]() { return job->running == 0; });
+
+    if (job->error)
+        std::rethrow_exception(job->error);
+}
+
+// Minimal amount of elements to encode class array in parallel
+static const size_t parallelMinElements = 512;
+
+//
+//  Encodes elements [first, last) of class array.
+//
+static void ClassBlockToBinaryData(BinaryEncoder& e, const char* p, size_t first, size_t last, size_t stride, BinaryPlan& plan)
+{
+    for (const char* pend = p + last * stride, *pelem = p + first * stride; pelem != pend; pelem += stride)
+        PlanToBinaryData(e, pelem, plan);
+}
+
+//
+//  Encodes class array in blocks of binaryOffsetBlock elements. Encoded size of each block is computed first, and
+//  written as offset table if requested. When encoding in parallel, prefix sum of block sizes gives final position
+//  of each block, so blocks are encoded concurrently directly into output.
+//
+static void ClassArrayToBinaryDataBlocks(BinaryEncoder& e, const char* p, size_t count, size_t stride, BinaryPlan& plan, bool table)
+{
+    size_t blocks = OffsetTableBlocks(count);
+    std::vector<size_t> offsets(blocks + 1);
+
+    ParallelFor(blocks, e.threads, [&](size_t b)
+    {
+        BinaryCountWriter w;
+        BinaryEncoder be = { w, e.format, 0, e.dict };
+        ClassBlockToBinaryData(be, p, b * binaryOffsetBlock, std::min((b + 1) * binaryOffsetBlock, count), stride, plan);
+        offsets[b + 1] = w.Size();
+    });
+
+    for (size_t b = 0; b < blocks; b++)
+    {
+        if (table)
+            lengthToBinaryData(e, offsets[b + 1]);
+
+        offsets[b + 1] += offsets[b];
+    }
+
+    if (e.threads <= 1)
+    {
+        BinaryEncoder be = { e.w, e.format, 0, e.dict };
+        ClassBlockToBinaryData(be, p, 0, count, stride, plan);
+        return;
+    }
+
+    size_t total = offsets[blocks];
+    std::unique_ptr<char[]> tmp;
+    char* out = e.w.Reserve(total);
+    if (!out)
+    {
+        // Writer cannot give contiguous space, encode into temporary buffer
+        tmp.reset(new char[total]);
+        out = tmp.get();
+    }
+
+    ParallelFor(blocks, e.threads, [&](size_t b)
+    {
+        BinaryMemoryWriter w(out + offsets[b], offsets[b + 1] - offsets[b]);
+        BinaryEncoder be = { w, e.format, 0, e.dict };
+        ClassBlockToBinaryData(be, p, b * binaryOffsetBlock, std::min((b + 1) * binaryOffsetBlock, count), stride, plan);
+    });
+
+    if (tmp)
+        e.w.Write(out, total);
+}
+
+static void ColumnsToBinaryData(BinaryEncoder& e, const char* p, size_t count, size_t stride, BinaryPlan& plan);
+
+static void ArrayToBinaryData(BinaryEncoder& e, const char* p, const BinaryOp& op)
+{
+    size_t size = op.type->ArraySize((void*)p);
+    lengthToBinaryData(e, size);
+    if (size == 0)
+        return;
+
+    const char* pstr2 = (const char*)op.type->ArrayElement((void*)p, 0);
+    const char* pend = pstr2 + size * op.size;
+
+    switch (op.elemKind)
+    {
+        case binelem_pod:
+            if (IsPackedElement(e.format, op.size))
+            {
+                PackedToBinaryData(e, pstr2, size, op.size, op.unit);
+                break;
+            }
+
+            // Primitive flat type, can be just copied.
+            if (NeedByteSwap(e.format) && op.unit > 1)
+                SwappedToBinaryData(e.w, pstr2, size * op.size / op.unit, op.unit);
+            else
+                e.w.Write(pstr2, size * op.size);
+            break;
+
+        case binelem_string:
+            for (; pstr2 != pend; pstr2 += op.size)
+                StringToBinaryData(e, *(const std::string*)pstr2);
+            break;
+
+        case binelem_wstring:
+            for (; pstr2 != pend; pstr2 += op.size)
+                WStringToBinaryData(e, *(const std::wstring*)pstr2);
+            break;
+
+        case binelem_blob:
+            for (; pstr2 != pend; pstr2 += op.size)
+                BlobToBinaryData(e, op.elemType->GetRawPtr((void*)pstr2), op.elemType->GetRawSize((void*)pstr2));
+            break;
+
+        case binelem_class:
+        {
+            BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+            if (e.format & binary_columnar)
+            {
+                ColumnsToBinaryData(e, pstr2, size, op.size, plan);
+                break;
+            }
+
+            bool table = HasOffsetTable(e.format, op);
+            if (table || (e.threads > 1 && size >= parallelMinElements))
+            {
+                ClassArrayToBinaryDataBlocks(e, pstr2, size, op.size, plan, table);
+                break;
+            }
+
+            for (; pstr2 != pend; pstr2 += op.size)
+                PlanToBinaryData(e, pstr2, plan);
+            break;
+        }
+    }
+}
+
+//
+//  Encodes single plan operation.
+//
+static inline void OpToBinaryData(BinaryEncoder& e, const char* p, const BinaryOp& op)
+{
+    switch (op.kind)
+    {
+        case binop_copy:
+            if (NeedByteSwap(e.format) && op.unit > 1)
+                SwappedToBinaryData(e.w, p, op.size / op.unit, op.unit);
+            else
+                e.w.Write(p, op.size);
+            break;
+
+        case binop_string:
+            StringToBinaryData(e, *(const std::string*)p);
+            break;
+
+        case binop_wstring:
+            WStringToBinaryData(e, *(const std::wstring*)p);
+            break;
+
+        case binop_blob:
+            BlobToBinaryData(e, op.type->GetRawPtr((void*)p), op.type->GetRawSize((void*)p));
+            break;
+
+        case binop_array:
+            ArrayToBinaryData(e, p, op);
+            break;
+
+        case binop_class:
+            PlanToBinaryData(e, p, GetBinaryPlan(*op.elemClass));
+            break;
+    }
+}
+
+void ValueToBinaryData(BinaryEncoder& e, const char* p, const BinaryOp& op)
+{
+    OpToBinaryData(e, p, op);
+}
+
+//
+//  Encodes class array column by column (binary_columnar). Fixed size columns are gathered directly into output
+//  when writer can provide contiguous space.
+//
+static void ColumnsToBinaryData(BinaryEncoder& e, const char* p, size_t count, size_t stride, BinaryPlan& plan)
+{
+    const char* pend = p + count * stride;
+
+    for (const BinaryOp& op : plan.columnOps)
+    {
+        char* out = op.kind == binop_copy ? e.w.Reserve(count * op.size) : nullptr;
+        if (out)
+        {
+            char* o = out;
+            for (const char* pelem = p; pelem != pend; pelem += stride, o += op.size)
+                memcpy(o, pelem + op.offset, op.size);
+
+            if (NeedByteSwap(e.format) && op.unit > 1)
+                SwapBytes(out, out, count * op.size / op.unit, op.unit);
+            continue;
+        }
+
+        for (const char* pelem = p; pelem != pend; pelem += stride)
+            OpToBinaryData(e, pelem + op.offset, op);
+    }
+}
+
+//
+//  Runs compiled plan over class instance.
+//
+static void PlanToBinaryData(BinaryEncoder& e, const char* pclass, BinaryPlan& plan)
+{
+    for (const BinaryOp& op : GetPlanOps(plan, e.format))
+        OpToBinaryData(e, pclass + op.offset, op);
+}
+
+//
+//  Encodes top level class instance, prefixed with schema header if requested, or in tagged format.
+//
+static void ClassBodyToBinaryData(BinaryEncoder& e, const char* pclass, ClassTypeInfo& type)
+{
+    if (e.format & binary_tagged)
+    {
+        TaggedToBinaryData(e, pclass, GetBinaryPlan(type));
+        return;
+    }
+
+    if (e.format & binary_schema)
+        SchemaToBinaryData(e, type);
+
+    PlanToBinaryData(e, pclass, GetBinaryPlan(type));
+}
+
+//
+//  Encodes top level class instance, preceded by string dictionary if requested.
+//
+static void ClassToBinaryData(BinaryEncoder& e, const char* pclass, ClassTypeInfo& type)
+{
+    if (!(e.format & binary_dictionary))
+    {
+        ClassBodyToBinaryData(e, pclass, type);
+        return;
+    }
+
+    StringDictionary dict;
+    CollectDictionary(pclass, GetBinaryPlan(type), dict);
+    DictionaryToBinaryData(e, dict);
+
+    BinaryEncoder de = { e.w, e.format, e.threads, &dict };
+    ClassBodyToBinaryData(de, pclass, type);
+}
+
+//
+//  Serializes class instance, without compression.
+//
+static void NodeToBinaryData(BinaryEncoder& e, void* pclass, BasicTypeInfo& type)
+{
+    ClassTypeInfo* clstype = dynamic_cast<ClassTypeInfo*>(&type);
+
+    if (clstype) {
+        ClassToBinaryData(e, (const char*)pclass, *clstype);
+        return;
+    }
+
+    // Primitive data type (string, int, bool)
+    size_t s = type.GetFixedSize();
+
+    if (s == 0) {
+        s = type.GetRawSize(pclass);
+        lengthToBinaryData(e, s);
+    }
+
+    e.w.Write(type.GetRawPtr(pclass), s);
+}
+
+//
+//  Serializes class instance, output is compressed chunk by chunk if binary_compressed is set or codec is specified.
+//
+static void EncodeNode(BinaryEncoder& e, void* pclass, BasicTypeInfo& type, CompressionCodec* codec)
+{
+    if (!codec && !(e.format & binary_compressed))
+    {
+        NodeToBinaryData(e, pclass, type);
+        return;
+    }
+
+    BinaryCompressWriter cw(e.w, codec ? *codec : GetLzCodec());
+    BinaryEncoder ce = { cw, e.format & ~binary_compressed, e.threads };
+    NodeToBinaryData(ce, pclass, type);
+    cw.Finish();
+}
+
+//
+//  Serializes class instance to binary writer.
+//
+void NodeToBinaryData(BinaryWriter& w, void* pclass, BasicTypeInfo& type, int format)
+{
+    BinaryEncoder e = { w, format };
+    EncodeNode(e, pclass, type, nullptr);
+}
+
+//
+//  Serializes class instance to binary buffer.
+//
+//  *buf if non-null - receives encoded buffer
+//  *len - buffer encoded length, set to -1 if encoded length does not fit into int (nothing is written then).
+//
+void NodeToBinaryData(char*& buf, int* len, void* pclass, BasicTypeInfo& type)
+{
+    BinaryCountWriter cw;
+    NodeToBinaryData(cw, pclass, type);
+    size_t l = cw.Size();
+
+    if (*len < 0 || l > (size_t)(INT_MAX - *len)) {
+        *len = -1;
+        return;
+    }
+
+    if (buf) {
+        BinaryMemoryWriter w(buf, l);
+        NodeToBinaryData(w, pclass, type);
+        buf += l;
+    }
+
+    *len += (int)l;
+}
+
+bool BinaryDataToVarint(BinaryDecoder& d, uint64_t& v)
+{
+    const unsigned char* p = (const unsigned char*)d.buf;
+
+#ifndef CPPREFLECT_BIG_ENDIAN
+    if (d.left >= 8)
+    {
+        uint64_t x;
+        memcpy(&x, p, 8);
+        // High bit cleared marks last byte.
+        uint64_t stop = ~x & 0x8080808080808080ull;
+
+        if (stop)
+        {
+            int bits = CountTrailingZeros(stop) + 1;
+            if (bits < 64)
+                x &= (1ull << bits) - 1;
+
+            // Squeeze 7-bit groups together: 2 x 7 => 14, 2 x 14 => 28, 2 x 28 => 56 bits.
+            x = ((x & 0x7f007f007f007f00ull) >> 1) | (x & 0x007f007f007f007full);
+            x = ((x & 0x3fff00003fff0000ull) >> 2) | (x & 0x00003fff00003fffull);
+            x = ((x & 0x0fffffff00000000ull) >> 4) | (x & 0x000000000fffffffull);
+            v = x;
+            d.buf += bits / 8;
+            d.left -= bits / 8;
+            return true;
+        }
+    }
+#endif
+
+    // Long value or end of buffer - byte by byte.
+    uint64_t r = 0;
+    size_t n = 0;
+
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (n == d.left)
+            return false;
+
+        unsigned char b = p[n++];
+        if (shift == 63 && b > 1)
+            return false;           // Does not fit into 64 bits
+
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            v = r;
+            d.buf += n;
+            d.left -= n;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline bool BinaryDataToString(BinaryDecoder& d, std::string& s)
+{
+    std::string_view v;
+    if (!BinaryDataToStringView(d, v) || !ChargeBinaryData(d, v.length()))
+        return false;
+
+    s.assign(v.data(), v.length());
+    return true;
+}
+
+static inline bool BinaryDataToBlob(BinaryDecoder& d, void* p, BasicTypeInfo& type)
+{
+    size_t l;
+    if (!BinaryDataToLength(d, l) || d.left < l || !ChargeBinaryData(d, l))
+        return false;
+
+    type.SetRawSize(p, l);
+    if (type.GetRawSize(p) != l)
+        return false;
+
+    return ReadBinaryData(d, type.GetRawPtr(p), l);
+}
+
+
+bool BinaryDataToOffsetTable(BinaryDecoder& d, size_t count, std::vector<size_t>* blocks, size_t& total)
+{
+    size_t n = OffsetTableBlocks(count);
+
+    // Each entry takes at least one byte
+    if (n > d.left)
+        return false;
+
+    if (blocks)
+        blocks->resize(n);
+
+    total = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t l;
+        if (!BinaryDataToLength(d, l) || l > SIZE_MAX - total)
+            return false;
+
+        total += l;
+        if (blocks)
+            (*blocks)[i] = l;
+    }
+
+    return total <= d.left;
+}
+
+//
+//  Decodes class array blocks in parallel, each block must be decoded exactly from its offset table entry.
+//
+static bool BinaryDataToClassBlocks(BinaryDecoder& d, char* p, size_t count, size_t stride, BinaryPlan& plan,
+    const std::vector<size_t>& blocks, size_t total)
+{
+    std::vector<size_t> offsets(blocks.size());
+    for (size_t b = 1; b < blocks.size(); b++)
+        offsets[b] = offsets[b - 1] + blocks[b - 1];
+
+    std::atomic<bool> failed(false);
+    ParallelFor(blocks.size(), d.threads, [&](size_t b)
+    {
+        BinaryDecoder bd = { d.buf + offsets[b], blocks[b], d.format, 0, d.dict, d.limits, d.depth };
+        char* pend = p + std::min((b + 1) * binaryOffsetBlock, count) * stride;
+
+        for (char* pelem = p + b * binaryOffsetBlock * stride; pelem != pend; pelem += stride)
+            if (!BinaryDataToPlan(bd, pelem, plan))
+            {
+                failed = true;
+                return;
+            }
+
+        if (bd.left != 0)
+            failed = true;
+    });
+
+    d.buf += total;
+    d.left -= total;
+    return !failed;
+}
+
+static bool ColumnsToClassArray(BinaryDecoder& d, char* p, size_t count, size_t stride, BinaryPlan& plan);
+
+static bool BinaryDataToArray(BinaryDecoder& d, char* p, const BinaryOp& op)
+{
+    size_t arrSize = 0;
+    if (!BinaryDataToLength(d, arrSize))
+        return false;
+
+    // Primitive flat type must fit into remaining buffer, packed one is validated as whole.
+    bool packed = op.elemKind == binelem_pod && IsPackedElement(d.format, op.size);
+    if (packed)
+    {
+        BinaryDecoder probe = d;
+        if (!SkipPacked(probe, arrSize, op.size))
+            return false;
+    }
+    else if (op.elemKind == binelem_pod && arrSize > d.left / op.size)
+    {
+        return false;
+    }
+    else if (op.elemKind != binelem_pod && arrSize > d.left &&
+        (op.elemKind != binelem_class || !GetBinaryPlan(*op.elemClass).ops.empty()))
+    {
+        // Each element takes at least one byte
+        return false;
+    }
+
+    if (!ChargeBinaryArray(d, arrSize, op.size))
+        return false;
+
+    // Offset table is validated before array is allocated
+    bool table = arrSize && HasOffsetTable(d.format, op);
+    std::vector<size_t> blocks;
+    size_t total = 0;
+    if (table && !BinaryDataToOffsetTable(d, arrSize, d.threads > 1 ? &blocks : nullptr, total))
+        return false;
+
+    op.type->SetArraySize(p, arrSize);
+    if (arrSize == 0)
+        return true;
+
+    char* pstr2 = (char*)op.type->ArrayElement(p, 0);
+    char* pend = pstr2 + arrSize * op.size;
+
+    switch (op.elemKind)
+    {
+        case binelem_pod:
+            if (packed)
+                return BinaryDataToPacked(d, pstr2, arrSize, op.size, op.unit);
+
+            if (!ReadBinaryData(d, pstr2, arrSize * op.size))
+                return false;
+
+            if (NeedByteSwap(d.format) && op.unit > 1)
+                SwapBytes(pstr2, pstr2, arrSize * op.size / op.unit, op.unit);
+            return true;
+
+        case binelem_string:
+            for (; pstr2 != pend; pstr2 += op.size)
+                if (!BinaryDataToString(d, *(std::string*)pstr2))
+                    return false;
+            break;
+
+        case binelem_wstring:
+            for (; pstr2 != pend; pstr2 += op.size)
+                if (!BinaryDataToWString(d, *(std::wstring*)pstr2))
+                    return false;
+            break;
+
+        case binelem_blob:
+            for (; pstr2 != pend; pstr2 += op.size)
+                if (!BinaryDataToBlob(d, pstr2, *op.elemType))
+                    return false;
+            break;
+
+        case binelem_class:
+        {
+            BinaryNestingScope nested(d);
+            if (!nested.Allowed())
+                return false;
+
+            BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+            if (d.format & binary_columnar)
+                return ColumnsToClassArray(d, pstr2, arrSize, op.size, plan);
+
+            if (blocks.size() > 1)
+                return BinaryDataToClassBlocks(d, pstr2, arrSize, op.size, plan, blocks, total);
+
+            size_t left = d.left;
+            for (; pstr2 != pend; pstr2 += op.size)
+                if (!BinaryDataToPlan(d, pstr2, plan))
+                    return false;
+
+            if (table && left - d.left != total)
+                return false;
+            break;
+        }
+    }
+
+    return true;
+}
+
+//
+//  Decodes single plan operation.
+//
+static inline bool BinaryDataToOp(BinaryDecoder& d, char* p, const BinaryOp& op)
+{
+    switch (op.kind)
+    {
+        case binop_copy:
+            if (!ReadBinaryData(d, p, op.size))
+                return false;
+
+            if (NeedByteSwap(d.format) && op.unit > 1)
+                SwapBytes(p, p, op.size / op.unit, op.unit);
+            return true;
+
+        case binop_string:
+            return BinaryDataToString(d, *(std::string*)p);
+
+        case binop_wstring:
+            return BinaryDataToWString(d, *(std::wstring*)p);
+
+        case binop_blob:
+            return BinaryDataToBlob(d, p, *op.type);
+
+        case binop_array:
+            return BinaryDataToArray(d, p, op);
+
+        case binop_class:
+        {
+            BinaryNestingScope nested(d);
+            return nested.Allowed() && BinaryDataToPlan(d, p, GetBinaryPlan(*op.elemClass));
+        }
+    }
+
+    return false;
+}
+
+bool BinaryDataToValue(BinaryDecoder& d, char* p, const BinaryOp& op)
+{
+    return BinaryDataToOp(d, p, op);
+}
+
+//
+//  Decodes class array encoded column by column (binary_columnar), values are scattered into elements.
+//
+static bool ColumnsToClassArray(BinaryDecoder& d, char* p, size_t count, size_t stride, BinaryPlan& plan)
+{
+    char* pend = p + count * stride;
+
+    for (const BinaryOp& op : plan.columnOps)
+    {
+        if (op.kind != binop_copy)
+        {
+            for (char* pelem = p; pelem != pend; pelem += stride)
+                if (!BinaryDataToOp(d, pelem + op.offset, op))
+                    return false;
+            continue;
+        }
+
+        if (count > d.left / op.size)
+            return false;
+
+        bool swap = NeedByteSwap(d.format) && op.unit > 1;
+        for (char* pelem = p; pelem != pend; pelem += stride)
+        {
+            memcpy(pelem + op.offset, d.buf, op.size);
+            if (swap)
+                SwapBytes(pelem + op.offset, pelem + op.offset, op.size / op.unit, op.unit);
+
+            d.buf += op.size;
+            d.left -= op.size;
+        }
+    }
+
+    return true;
+}
+
+//
+//  Runs compiled plan to restore class instance.
+//
+bool BinaryDataToPlan(BinaryDecoder& d, char* pclass, BinaryPlan& plan)
+{
+    for (const BinaryOp& op : GetPlanOps(plan, d.format))
+        if (!BinaryDataToOp(d, pclass + op.offset, op))
+            return false;
+
+    return true;
+}
+
+static inline bool SkipBinaryBytes(BinaryDecoder& d, size_t size)
+{
+    if (d.left < size)
+        return false;
+
+    d.buf += size;
+    d.left -= size;
+    return true;
+}
+
+bool SkipBinaryValue(BinaryDecoder& d, const BinaryOp& op)
+{
+    size_t l;
+    std::string_view s;
+
+    switch (op.kind)
+    {
+        case binop_string:
+            return BinaryDataToStringView(d, s);
+
+        case binop_copy:
+            return SkipBinaryBytes(d, op.size);
+
+        case binop_class:
+            return SkipBinaryData(d, GetBinaryPlan(*op.elemClass));
+
+        case binop_array:
+            return BinaryDataToLength(d, l) && SkipBinaryElements(d, op, l);
+
+        default:
+            return BinaryDataToLength(d, l) && SkipBinaryBytes(d, l);
+    }
+}
+
+bool SkipBinaryElements(BinaryDecoder& d, const BinaryOp& op, size_t count)
+{
+    size_t l;
+
+    switch (op.elemKind)
+    {
+        case binelem_pod:
+            if (IsPackedElement(d.format, op.size))
+                return SkipPacked(d, count, op.size);
+
+            return count <= d.left / op.size && SkipBinaryBytes(d, count * op.size);
+
+        case binelem_class:
+        {
+            BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+            if (plan.ops.empty())
+                return true;
+
+            if (d.format & binary_columnar)
+                return SkipBinaryColumns(d, plan, count);
+
+            if (count && HasOffsetTable(d.format, op))
+                return BinaryDataToOffsetTable(d, count, nullptr, l) && SkipBinaryBytes(d, l);
+
+            for (size_t i = 0; i < count; i++)
+                if (!SkipBinaryData(d, plan))
+                    return false;
+            return true;
+        }
+
+        case binelem_string:
+        {
+            // Each element takes at least one byte
+            std::string_view s;
+            if (count > d.left)
+                return false;
+
+            for (size_t i = 0; i < count; i++)
+                if (!BinaryDataToStringView(d, s))
+                    return false;
+            return true;
+        }
+
+        default:
+            for (size_t i = 0; i < count; i++)
+                if (!BinaryDataToLength(d, l) || !SkipBinaryBytes(d, l))
+                    return false;
+            return true;
+    }
+}
+
+bool SkipBinaryColumn(BinaryDecoder& d, const BinaryOp& op, size_t count)
+{
+    if (op.kind == binop_copy)
+        return count <= d.left / op.size && SkipBinaryBytes(d, count * op.size);
+
+    for (size_t i = 0; i < count; i++)
+        if (!SkipBinaryValue(d, op))
+            return false;
+
+    return true;
+}
+
+bool SkipBinaryColumns(BinaryDecoder& d, BinaryPlan& plan, size_t count)
+{
+    for (const BinaryOp& op : plan.columnOps)
+        if (!SkipBinaryColumn(d, op, count))
+            return false;
+
+    return true;
+}
+
+bool SkipBinaryData(BinaryDecoder& d, BinaryPlan& plan)
+{
+    for (const BinaryOp& op : plan.ops)
+        if (!SkipBinaryValue(d, op))
+            return false;
+
+    return true;
+}
+
+static bool CompressedToNode(BinaryDecoder& d, void* pclass, BasicTypeInfo& type);
+
+static bool BinaryDataToClass(BinaryDecoder& d, char* pclass, ClassTypeInfo& type)
+{
+    if (d.format & binary_tagged)
+        return BinaryDataToTagged(d, pclass, GetBinaryPlan(type));
+
+    if (d.format & binary_schema)
+        return BinaryDataToSchemaNode(d, pclass, type);
+
+    return BinaryDataToPlan(d, pclass, GetBinaryPlan(type));
+}
+
+//
+//  Reads string dictionary, and decodes class instance using it.
+//
+static bool DictionaryToClass(BinaryDecoder& d, char* pclass, ClassTypeInfo& type)
+{
+    StringDictionary dict;
+    BinaryDecoder dd = { d.buf, d.left, d.format, d.threads, &dict, d.limits, d.depth };
+    bool ok = BinaryDataToDictionary(dd, dict) && BinaryDataToClass(dd, pclass, type);
+
+    d.buf = dd.buf;
+    d.left = dd.left;
+    return ok;
+}
+
+//
+//  Deserializes class instance from binary buffer.
+//
+//  buf - advanced past decoded data
+//  left - amount of bytes left in buffer
+//
+static bool BinaryDataToNode(BinaryDecoder& d, void* pclass, BasicTypeInfo& type)
+{
+    try {
+        if (d.format & binary_compressed)
+            return CompressedToNode(d, pclass, type);
+
+        ClassTypeInfo* clstype = dynamic_cast<ClassTypeInfo*>(&type);
+
+        if (clstype && (d.format & binary_dictionary))
+            return DictionaryToClass(d, (char*)pclass, *clstype);
+
+        if (clstype)
+            return BinaryDataToClass(d, (char*)pclass, *clstype);
+
+        // Primitive data type (string, int, bool)
+        size_t s = type.GetFixedSize();
+
+        if (s == 0)
+            return BinaryDataToBlob(d, pclass, type);
+
+        return ReadBinaryData(d, type.GetRawPtr(pclass), s);
+    } catch (std::bad_alloc&) {
+        // Either out of memory or incorrectly decoded buffer
+        return false;
+    } catch (std::length_error&) {
+        // Incorrectly decoded length exceeding max_size()
+        return false;
+    }
+}
+
+//
+//  Decodes compressed data. Chunks are decoded by push decoder as they are decompressed, so whole decompressed data
+//  is not kept in memory, except for formats which push decoder does not handle and for decoding with depth limit
+//  (push decoder does not track nesting, decompressed data is charged against limits then).
+//
+static bool CompressedToNode(BinaryDecoder& d, void* pclass, BasicTypeInfo& type)
+{
+    int format = d.format & ~binary_compressed;
+    ClassTypeInfo* clstype = dynamic_cast<ClassTypeInfo*>(&type);
+    BinaryDecodeOptions options = d.limits ? d.limits->options : BinaryDecodeOptions();
+
+    if (clstype && !(format & (binary_tagged | binary_schema)) && d.threads <= 1 && options.maxDepth == SIZE_MAX)
+    {
+        BinaryPushDecoder decoder(pclass, *clstype, format, options);
+        bool ok = DecompressChunks(d.buf, d.left, [&](const char* p, size_t size)
+        {
+            size_t consumed;
+            return decoder.Feed(p, size, &consumed) != decode_error && consumed == size;
+        });
+
+        // Class without encoded data is completed by empty chunk
+        if (ok && decoder.GetStatus() == decode_need_more)
+            decoder.Feed(nullptr, 0);
+
+        return ok && decoder.GetStatus() == decode_done;
+    }
+
+    std::string data;
+    auto append = [&](const char* p, size_t size)
+    {
+        if (!ChargeBinaryData(d, size))
+            return false;
+
+        data.append(p, size);
+        return true;
+    };
+
+    if (!DecompressChunks(d.buf, d.left, append))
+        return false;
+
+    BinaryDecoder dd = { data.data(), data.size(), format, d.threads, nullptr, d.limits, d.depth };
+    return BinaryDataToNode(dd, pclass, type) && dd.left == 0;
+}
+
+bool BinaryDataToNode(const char*& buf, size_t& left, void* pclass, BasicTypeInfo& type, int format)
+{
+    BinaryDecoder d = { buf, left, format };
+    bool ok = BinaryDataToNode(d, pclass, type);
+
+    buf = d.buf;
+    left = d.left;
+    return ok;
+}
+
+bool BinaryDataToNode(char*& buf, int* left, void* pclass, BasicTypeInfo& type)
+{
+    if (*left < 0)
+        return false;
+
+    const char* p = buf;
+    size_t l = (size_t)*left;
+    bool ok = BinaryDataToNode(p, l, pclass, type);
+
+    buf = (char*)p;
+    *left = (int)l;
+    return ok;
+}
+
+size_t getEncodedSize64(void* pclass, ClassTypeInfo& type, int format)
+{
+    BinaryCountWriter w;
+    NodeToBinaryData(w, pclass, type, format);
+
+    return w.Size();
+}
+
+int getEncodedSize(void* pclass, ClassTypeInfo& type)
+{
+    size_t size = getEncodedSize64(pclass, type);
+    if (size > INT_MAX)
+        return -1;
+
+    return (int)size;
+}
+
+void serialize_to_buffer(std::string& buf, void* pclass, ClassTypeInfo& type, int format)
+{
+    BinaryBufferWriter w(buf);
+    NodeToBinaryData(w, pclass, type, format);
+    w.Finish();
+}
+
+void serialize_to_buffer(BinaryWriter& w, void* pclass, ClassTypeInfo& type, int format)
+{
+    NodeToBinaryData(w, pclass, type, format);
+}
+
+void serialize_to_buffer(std::string& buf, void* pclass, ClassTypeInfo& type, int format, CompressionCodec& codec)
+{
+    BinaryBufferWriter w(buf);
+    serialize_to_buffer(w, pclass, type, format, codec);
+    w.Finish();
+}
+
+void serialize_to_buffer(BinaryWriter& w, void* pclass, ClassTypeInfo& type, int format, CompressionCodec& codec)
+{
+    BinaryEncoder e = { w, format };
+    EncodeNode(e, pclass, type, &codec);
+}
+
+void serialize_to_buffer_parallel(std::string& buf, void* pclass, ClassTypeInfo& type, int format, int threads)
+{
+    BinaryBufferWriter w(buf);
+    serialize_to_buffer_parallel(w, pclass, type, format, threads);
+    w.Finish();
+}
+
+void serialize_to_buffer_parallel(BinaryWriter& w, void* pclass, ClassTypeInfo& type, int format, int threads)
+{
+    if (threads <= 0)
+        threads = (int)std::thread::hardware_concurrency();
+
+    BinaryEncoder e = { w, format, threads };
+    EncodeNode(e, pclass, type, nullptr);
+}
+
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, int format)
+{
+    const char* pbuf = (const char*)buf;
+
+    return BinaryDataToNode(pbuf, len, pclass, type, format);
+}
+
+bool parse_from_buffer(std::string_view buf, void* pclass, ClassTypeInfo& type, int format)
+{
+    return parse_from_buffer(buf.data(), buf.size(), pclass, type, format);
+}
+
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, std::pmr::memory_resource& resource, int format)
+{
+    DecodeResourceScope scope(&resource);
+    return parse_from_buffer(buf, len, pclass, type, format);
+}
+
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, const BinaryDecodeOptions& options, int format)
+{
+    BinaryDecodeLimits limits = { options };
+    BinaryDecoder d = { (const char*)buf, len, format, 0, nullptr, &limits };
+    return BinaryDataToNode(d, pclass, type);
+}
+
+bool parse_from_buffer_parallel(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, int format, int threads)
+{
+    if (threads <= 0)
+        threads = (int)std::thread::hardware_concurrency();
+
+    BinaryDecoder d = { (const char*)buf, len, format, threads };
+    return BinaryDataToNode(d, pclass, type);
+}
+
+bool LoadFromBinaryFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error, int format)
+{
+    MappedFile file;
+    if (!file.OpenRead(path, error))
+        return false;
+
+    const char* buf = file.data;
+    size_t left = file.size;
+    if (!BinaryDataToNode(buf, left, pclass, type, format) || left != 0)
+    {
+        error = L"Failed to load binary file '";
+        error.append(path);
+        error.append(L"': malformed or truncated data");
+        return false;
+    }
+
+    return true;
+}
+
+bool SaveToBinaryFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error, int format,
+    CompressionCodec* codec)
+{
+    if (codec || (format & binary_compressed))
+    {
+#ifdef _WIN32
+        FILE* f = _wfopen(path, L"wb");
+#else
+        FILE* f = fopen(pugi::as_utf8(path).c_str(), "wb");
+#endif
+        if (!f)
+        {
+            error = L"Failed to create file '";
+            error.append(path);
+            error.append(L"'");
+            return false;
+        }
+
+        // Compressed size is known only after compression, so data is compressed into file chunk by chunk
+        BinaryFileWriter fw(f);
+        BinaryEncoder e = { fw, format };
+        EncodeNode(e, pclass, type, codec);
+
+        bool ok = fw.Flush();
+        if (fclose(f) != 0 || !ok)
+        {
+            error = L"Failed to write file '";
+            error.append(path);
+            error.append(L"'");
+            return false;
+        }
+
+        return true;
+    }
+
+    MappedFile file;
+    if (!file.Create(path, getEncodedSize64(pclass, type, format), error))
+        return false;
+
+    BinaryMemoryWriter w(file.data, file.size);
+    NodeToBinaryData(w, pclass, type, format);
+
+    // Instance must not change between sizing and encoding
+    if (w.overflow || w.Size() != file.size)
+    {
+        error = L"Encoded size of instance has changed while writing file '";
+        error.append(path);
+        error.append(L"'");
+        return false;
+    }
+
+    return true;
+}
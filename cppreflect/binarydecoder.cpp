@@ -0,0 +1,580 @@
+#include "binarydecoder.h"
+#include "binaryplan.h"                     //BinaryPlan
+#include <string.h>                         //memcpy
+#include <stdint.h>                         //SIZE_MAX
+#include <algorithm>                        //min
+#include <stdexcept>                        //length_error
+
+BinaryPushDecoder::BinaryPushDecoder()
+{
+}
+
+BinaryPushDecoder::BinaryPushDecoder(void* pclass, ClassTypeInfo& type, int _format, const BinaryDecodeOptions& _options)
+{
+    Reset(pclass, type, _format, _options);
+}
+
+BinaryPushDecoder::~BinaryPushDecoder()
+{
+}
+
+void BinaryPushDecoder::Reset(void* pclass, ClassTypeInfo& type, int _format, const BinaryDecodeOptions& _options)
+{
+    format = _format;
+    options = _options;
+    limits.reset(new BinaryDecodeLimits{ options });
+    stack.clear();
+    done = 0;
+    lenHave = 0;
+    inVariable = false;
+    packStage = 0;
+    dictionary.clear();
+    dictStage = (format & binary_dictionary) ? 0 : 2;
+
+    headerStage = 3;
+    if (format & binary_schema)
+    {
+        // Only data of same schema version can be decoded incrementally
+        fingerprint = GetSchemaPlan(type).fingerprint;
+        headerStage = 0;
+    }
+
+    Frame f = {};
+    f.plan = &GetBinaryPlan(type);
+    f.obj = (char*)pclass;
+    stack.push_back(f);
+
+    // Tagged format needs whole class instance to be measured, compressed data needs decompression - decode them
+    // using BinaryDataToNode instead.
+    status = (format & (binary_tagged | binary_compressed)) ? decode_error : decode_need_more;
+}
+
+//
+//  Copies size bytes into dest, continuing from where previous chunk ended. Returns false if chunk ended first.
+//
+bool BinaryPushDecoder::Fill(void* dest, size_t size)
+{
+    size_t n = std::min(size - done, left);
+    if (n)
+        memcpy((char*)dest + done, in, n);
+
+    in += n;
+    left -= n;
+    done += n;
+
+    if (done < size)
+        return false;
+
+    done = 0;
+    return true;
+}
+
+//
+//  Charges storage about to be allocated against options, see ChargeBinaryData / ChargeBinaryArray.
+//
+bool BinaryPushDecoder::ChargeData(size_t bytes)
+{
+    BinaryDecoder d = { nullptr, 0, format, 0, nullptr, limits.get() };
+    return ChargeBinaryData(d, bytes);
+}
+
+bool BinaryPushDecoder::ChargeArray(size_t count, size_t size)
+{
+    BinaryDecoder d = { nullptr, 0, format, 0, nullptr, limits.get() };
+    return ChargeBinaryArray(d, count, size);
+}
+
+BinaryPushDecoder::StepResult BinaryPushDecoder::ReadLength(size_t& l)
+{
+    if ((format & binary_portable) && !(format & binary_varint))
+    {
+        if (!Fill(lenBuf, sizeof(uint64_t)))
+            return step_more;
+
+        uint64_t v;
+        memcpy(&v, lenBuf, sizeof(v));
+        v = LittleEndian64(v);
+        if (v > SIZE_MAX)
+            return step_error;
+
+        l = (size_t)v;
+        return step_done;
+    }
+
+    if (!(format & binary_varint))
+    {
+        if (!Fill(lenBuf, sizeof(size_t)))
+            return step_more;
+
+        memcpy(&l, lenBuf, sizeof(size_t));
+        return step_done;
+    }
+
+    uint64_t v;
+    StepResult r = ReadVarint(v);
+    if (r != step_done)
+        return r;
+
+    if (v > SIZE_MAX)
+        return step_error;
+
+    l = (size_t)v;
+    return step_done;
+}
+
+BinaryPushDecoder::StepResult BinaryPushDecoder::ReadVarint(uint64_t& v)
+{
+    while (left)
+    {
+        unsigned char b = (unsigned char)*in++;
+        left--;
+        lenBuf[lenHave++] = b;
+
+        if (b & 0x80)
+        {
+            if (lenHave == 10)
+                return step_error;
+            continue;
+        }
+
+        v = 0;
+        for (size_t i = 0; i < lenHave; i++)
+            v |= (uint64_t)(lenBuf[i] & 0x7f) << (7 * i);
+
+        if (lenHave == 10 && b > 1)
+            return step_error;
+
+        lenHave = 0;
+        return step_done;
+    }
+
+    return step_more;
+}
+
+BinaryPushDecoder::StepResult BinaryPushDecoder::ReadVariable(int elemKind, BasicTypeInfo* type, char* p)
+{
+    if (elemKind == binelem_string && (format & binary_dictionary))
+    {
+        uint64_t i;
+        StepResult r = ReadVarint(i);
+        if (r != step_done)
+            return r;
+
+        if (i >= dictionary.size() || !ChargeData(dictionary[(size_t)i].length()))
+            return step_error;
+
+        *(std::string*)p = dictionary[(size_t)i];
+        return step_done;
+    }
+
+    if (!inVariable)
+    {
+        StepResult r = ReadLength(variableLength);
+        if (r != step_done)
+            return r;
+
+        // UTF-8 byte gives at most one character
+        size_t unit = (elemKind == binelem_wstring && (format & binary_portable)) ? sizeof(wchar_t) : 1;
+        if (variableLength > SIZE_MAX / unit || !ChargeData(variableLength * unit))
+            return step_error;
+
+        switch (elemKind)
+        {
+            case binelem_string:
+                ((std::string*)p)->resize(variableLength);
+                break;
+
+            case binelem_wstring:
+                if (format & binary_portable)
+                {
+                    // UTF-8 is collected first, converted when complete
+                    scratch.resize(variableLength);
+                    break;
+                }
+
+                if (variableLength % sizeof(wchar_t) != 0)
+                    return step_error;
+
+                ((std::wstring*)p)->resize(variableLength / sizeof(wchar_t));
+                break;
+
+            default:
+                type->SetRawSize(p, variableLength);
+                if (type->GetRawSize(p) != variableLength)
+                    return step_error;
+                break;
+        }
+
+        inVariable = true;
+    }
+
+    void* dest;
+    switch (elemKind)
+    {
+        case binelem_string:    dest = &(*(std::string*)p)[0];      break;
+        case binelem_wstring:   dest = &(*(std::wstring*)p)[0];     break;
+        default:                dest = type->GetRawPtr(p);          break;
+    }
+
+    bool convert = elemKind == binelem_wstring && (format & binary_portable);
+    if (convert)
+        dest = &scratch[0];
+
+    if (!Fill(dest, variableLength))
+        return step_more;
+
+    inVariable = false;
+    if (convert && !Utf8ToWString(scratch.data(), scratch.size(), *(std::wstring*)p))
+        return step_error;
+
+    return step_done;
+}
+
+BinaryPushDecoder::StepResult BinaryPushDecoder::ReadArray(Frame& f, const BinaryOp& op, char* p)
+{
+    if (!f.inArray)
+    {
+        size_t count;
+        StepResult r = ReadLength(count);
+        if (r != step_done)
+            return r;
+
+        if (!ChargeArray(count, op.size))
+            return step_error;
+
+        op.type->SetArraySize(p, count);
+        f.count = count;
+        f.index = 0;
+        f.elem = count ? (char*)op.type->ArrayElement(p, 0) : nullptr;
+        f.tableLeft = count && HasOffsetTable(format, op) ? OffsetTableBlocks(count) : 0;
+        f.inArray = true;
+    }
+
+    // Offset table is not needed for sequential decoding
+    for (; f.tableLeft; f.tableLeft--)
+    {
+        size_t l;
+        StepResult r = ReadLength(l);
+        if (r != step_done)
+            return r;
+    }
+
+    switch (op.elemKind)
+    {
+        case binelem_pod:
+            if (IsPackedElement(format, op.size))
+            {
+                StepResult r = f.count ? ReadPacked(f, op) : step_done;
+                if (r != step_done)
+                    return r;
+                break;
+            }
+
+            if (!Fill(f.elem, f.count * op.size))
+                return step_more;
+
+            if (NeedByteSwap(format) && op.unit > 1)
+                SwapBytes(f.elem, f.elem, f.count * op.size / op.unit, op.unit);
+            break;
+
+        case binelem_class:
+            if (f.index < f.count)
+            {
+                Frame sub = {};
+                sub.plan = &GetBinaryPlan(*op.elemClass);
+                sub.obj = f.elem + f.index * op.size;
+                f.index++;
+
+                if (format & binary_columnar)
+                {
+                    // All elements at once
+                    sub.columns = f.count;
+                    sub.stride = op.size;
+                    f.index = f.count;
+                }
+
+                stack.push_back(sub);
+                return step_push;
+            }
+            break;
+
+        default:
+            for (; f.index < f.count; f.index++)
+            {
+                StepResult r = ReadVariable(op.elemKind, op.elemType, f.elem + f.index * op.size);
+                if (r != step_done)
+                    return r;
+            }
+            break;
+    }
+
+    f.inArray = false;
+    return step_done;
+}
+
+BinaryPushDecoder::StepResult BinaryPushDecoder::ReadPacked(Frame& f, const BinaryOp& op)
+{
+    if (packStage == 0)
+    {
+        if (!Fill(lenBuf, 1))
+            return step_more;
+
+        if (lenBuf[0] > 1)
+            return step_error;
+
+        packRaw = lenBuf[0] == 0;
+        packStage = 1;
+    }
+
+    if (packStage == 1)
+    {
+        if (packRaw)
+        {
+            if (!Fill(f.elem, f.count * op.size))
+                return step_more;
+
+            if (NeedByteSwap(format) && op.unit > 1)
+                SwapBytes(f.elem, f.elem, f.count * op.size / op.unit, op.unit);
+
+            packStage = 0;
+            return step_done;
+        }
+
+        if (!Fill(lenBuf, op.size))
+            return step_more;
+
+        packPrev = 0;
+        memcpy(&packPrev, lenBuf, op.size);
+        packPrev = LittleEndian64(packPrev);
+        UnpackBlock(nullptr, 0, 1, 0, f.elem, op.size, packPrev);
+        f.index = 1;
+        packStage = 2;
+    }
+
+    while (f.index < f.count)
+    {
+        if (packStage == 2)
+        {
+            if (!Fill(lenBuf, 1))
+                return step_more;
+
+            packWidth = lenBuf[0];
+            if (packWidth > op.size * 8)
+                return step_error;
+
+            packBlock = std::min(binaryPackedBlock, f.count - f.index);
+            scratch.resize(PackedBlockSize(packBlock, packWidth));
+            packStage = 3;
+        }
+
+        if (!Fill(&scratch[0], scratch.size()))
+            return step_more;
+
+        UnpackBlock(scratch.data(), scratch.size(), packBlock, packWidth, f.elem + f.index * op.size, op.size, packPrev);
+        f.index += packBlock;
+        packStage = 2;
+    }
+
+    packStage = 0;
+    return step_done;
+}
+
+BinaryPushDecoder::StepResult BinaryPushDecoder::ReadSchemaHeader()
+{
+    if (headerStage == 0)
+    {
+        if (!Fill(lenBuf, sizeof(uint64_t)))
+            return step_more;
+
+        uint64_t f;
+        memcpy(&f, lenBuf, sizeof(f));
+        if (format & binary_portable)
+            f = LittleEndian64(f);
+
+        if (f != fingerprint)
+            return step_error;
+
+        headerStage = 1;
+    }
+
+    if (headerStage == 1)
+    {
+        StepResult r = ReadLength(schemaLeft);
+        if (r != step_done)
+            return r;
+
+        headerStage = 2;
+    }
+
+    size_t n = std::min(schemaLeft, left);
+    in += n;
+    left -= n;
+    schemaLeft -= n;
+
+    if (schemaLeft)
+        return step_more;
+
+    headerStage = 3;
+    return step_done;
+}
+
+//
+//  Receives string dictionary (binary_dictionary), entries are copied, as chunks do not outlive Feed().
+//
+BinaryPushDecoder::StepResult BinaryPushDecoder::ReadDictionary()
+{
+    if (dictStage == 0)
+    {
+        StepResult r = ReadLength(dictLeft);
+        if (r != step_done)
+            return r;
+
+        if (!ChargeArray(dictLeft, sizeof(std::string)))
+            return step_error;
+
+        dictStage = 1;
+    }
+
+    for (; dictLeft; dictLeft--)
+    {
+        if (!inVariable)
+        {
+            StepResult r = ReadLength(variableLength);
+            if (r != step_done)
+                return r;
+
+            if (!ChargeData(variableLength))
+                return step_error;
+
+            dictionary.emplace_back(variableLength, '\0');
+            inVariable = true;
+        }
+
+        std::string& s = dictionary.back();
+        if (!Fill(&s[0], s.length()))
+            return step_more;
+
+        inVariable = false;
+    }
+
+    dictStage = 2;
+    return step_done;
+}
+
+//
+//  Decodes as much as current chunk allows.
+//
+BinaryPushDecoder::StepResult BinaryPushDecoder::Run()
+{
+    if (dictStage != 2)
+    {
+        StepResult r = ReadDictionary();
+        if (r != step_done)
+            return r;
+    }
+
+    if (headerStage != 3)
+    {
+        StepResult r = ReadSchemaHeader();
+        if (r != step_done)
+            return r;
+    }
+
+    while (stack.size())
+    {
+        Frame& f = stack.back();
+        const std::vector<BinaryOp>& ops = f.columns ? f.plan->columnOps : GetPlanOps(*f.plan, format);
+
+        if (f.op == ops.size())
+        {
+            // Class instance done, continue with parent
+            stack.pop_back();
+            continue;
+        }
+
+        const BinaryOp& op = ops[f.op];
+        char* p = f.obj + f.row * f.stride + op.offset;
+        StepResult r = step_done;
+
+        switch (op.kind)
+        {
+            case binop_copy:
+                if (!Fill(p, op.size))
+                    r = step_more;
+                else if (NeedByteSwap(format) && op.unit > 1)
+                    SwapBytes(p, p, op.size / op.unit, op.unit);
+                break;
+
+            case binop_string:
+                r = ReadVariable(binelem_string, op.type, p);
+                break;
+
+            case binop_wstring:
+                r = ReadVariable(binelem_wstring, op.type, p);
+                break;
+
+            case binop_blob:
+                r = ReadVariable(binelem_blob, op.type, p);
+                break;
+
+            case binop_array:
+                r = ReadArray(f, op, p);
+                break;
+
+            default:
+                // Nested classes are inlined into plan ops, so binop_class is never executed
+                r = step_error;
+                break;
+        }
+
+        if (r == step_push)
+            continue;
+
+        if (r != step_done)
+            return r;
+
+        // Next value of column
+        if (f.columns && ++f.row < f.columns)
+            continue;
+
+        f.row = 0;
+        f.op++;
+    }
+
+    return step_done;
+}
+
+EDecodeStatus BinaryPushDecoder::Feed(const void* data, size_t size, size_t* consumed)
+{
+    if (consumed)
+        *consumed = 0;
+
+    if (status != decode_need_more)
+        return status;
+
+    in = (const char*)data;
+    left = size;
+
+    StepResult r;
+    try {
+        r = Run();
+    } catch (std::bad_alloc&) {
+        // Either out of memory or incorrectly decoded buffer
+        r = step_error;
+    } catch (std::length_error&) {
+        // Incorrectly decoded length exceeding max_size()
+        r = step_error;
+    }
+
+    switch (r)
+    {
+        case step_done:     status = decode_done;       break;
+        case step_more:     status = decode_need_more;  break;
+        default:            status = decode_error;      break;
+    }
+
+    if (consumed)
+        *consumed = size - left;
+
+    return status;
+}
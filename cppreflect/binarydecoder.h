@@ -0,0 +1,140 @@
+#pragma once
+#include "cppreflect.h"
+
+class BinaryPlan;
+struct BinaryOp;
+struct BinaryDecodeLimits;
+
+//
+//  Result of incremental decoding.
+//
+enum EDecodeStatus
+{
+    decode_done,            // Class instance is fully decoded
+    decode_need_more,       // Chunk was consumed, more data is needed
+    decode_error            // Malformed data
+};
+
+//
+//  Push style binary decoder - accepts encoded data in chunks of any size (as it arrives from pipe or socket),
+//  position within type tree is kept between calls, so data does not need to be buffered.
+//  Tagged format (binary_tagged) and compressed data (binary_compressed) are not supported.
+//
+//  Data arriving from network is untrusted - decoded strings, blobs and arrays are charged against options before
+//  they are allocated, so hostile length prefix fails decoding. options.maxDepth is not used, nesting is kept in
+//  heap allocated frames, not on call stack.
+//
+//  Usage:
+//
+//      BinaryPushDecoder decoder(&ppl, People::GetType());
+//      while ((n = read(fd, buf, sizeof(buf))) > 0)
+//          if (decoder.Feed(buf, n) != decode_need_more)
+//              break;
+//
+class BinaryPushDecoder
+{
+public:
+    BinaryPushDecoder();
+    BinaryPushDecoder(void* pclass, ClassTypeInfo& type, int format = binary_native,
+        const BinaryDecodeOptions& options = BinaryDecodeOptions());
+    ~BinaryPushDecoder();
+
+    //
+    //  Starts decoding of new class instance.
+    //
+    void Reset(void* pclass, ClassTypeInfo& type, int format = binary_native,
+        const BinaryDecodeOptions& options = BinaryDecodeOptions());
+
+    //
+    //  Decodes next chunk of data. Data is consumed up to end of chunk or end of encoded class, whichever comes first,
+    //  amount of consumed bytes is returned in *consumed (rest of chunk belongs to next message).
+    //
+    EDecodeStatus Feed(const void* data, size_t size, size_t* consumed = nullptr);
+
+    EDecodeStatus GetStatus() const
+    {
+        return status;
+    }
+
+protected:
+    //
+    //  Class instance being decoded.
+    //
+    struct Frame
+    {
+        BinaryPlan* plan;
+        char* obj;
+        size_t op;                          // Current operation
+        bool inArray;                       // Array length is decoded, decoding elements
+        size_t count;                       // Array element count
+        size_t index;                       // Current array element
+        char* elem;                         // First array element
+        size_t tableLeft;                   // Offset table entries left to read (binary_offsets)
+        size_t columns;                     // binary_columnar: amount of class instances decoded column by column,
+        size_t stride;                      // starting at obj, stride bytes apart (0 - single instance)
+        size_t row;                         // Instance within current column
+    };
+
+    enum StepResult
+    {
+        step_done,
+        step_more,
+        step_error,
+        step_push                           // New frame was pushed
+    };
+
+    StepResult Run();
+    StepResult ReadDictionary();
+    StepResult ReadSchemaHeader();
+    StepResult ReadArray(Frame& f, const BinaryOp& op, char* p);
+    StepResult ReadPacked(Frame& f, const BinaryOp& op);
+    StepResult ReadVariable(int elemKind, BasicTypeInfo* type, char* p);
+    StepResult ReadLength(size_t& l);
+    StepResult ReadVarint(uint64_t& v);
+    bool Fill(void* dest, size_t size);
+    bool ChargeData(size_t bytes);
+    bool ChargeArray(size_t count, size_t size);
+
+    std::vector<Frame> stack;
+    int format = binary_native;
+    EDecodeStatus status = decode_error;
+
+    // Decoding limits and storage charged against them so far
+    BinaryDecodeOptions options;
+    std::unique_ptr<BinaryDecodeLimits> limits;
+
+    // Current chunk
+    const char* in = nullptr;
+    size_t left = 0;
+
+    // Bytes of current value already decoded
+    size_t done = 0;
+
+    // Partially received length
+    unsigned char lenBuf[16];
+    size_t lenHave = 0;
+
+    // binary_dictionary: 0 - entry count, 1 - entries, 2 - dictionary done
+    int dictStage = 2;
+    size_t dictLeft = 0;                    // Entries left to read
+    std::vector<std::string> dictionary;
+
+    // binary_schema: 0 - reading fingerprint, 1 - schema length, 2 - skipping schema, 3 - header done
+    int headerStage = 3;
+    uint64_t fingerprint = 0;
+    size_t schemaLeft = 0;
+
+    // Variable sized value (string, blob) length is decoded, receiving contents.
+    bool inVariable = false;
+    size_t variableLength = 0;
+
+    // binary_packed array: 0 - mode, 1 - raw elements / first element, 2 - block bit width, 3 - block data
+    int packStage = 0;
+    bool packRaw = false;
+    size_t packWidth = 0;
+    size_t packBlock = 0;                   // Values in current block
+    uint64_t packPrev = 0;                  // Last decoded element
+
+    // UTF-8 of std::wstring (binary_portable) / packed block (binary_packed) being received
+    std::string scratch;
+};
@@ -0,0 +1,76 @@
+#include "binaryplan.h"                     //StringDictionary
+
+static inline void AddDictionaryString(StringDictionary& dict, const std::string& s)
+{
+    auto it = dict.index.emplace(std::string_view(s), dict.strings.size());
+    if (it.second)
+        dict.strings.push_back(it.first->first);
+}
+
+void CollectDictionary(const char* pclass, BinaryPlan& plan, StringDictionary& dict)
+{
+    for (const BinaryOp& op : plan.ops)
+    {
+        const char* p = pclass + op.offset;
+
+        if (op.kind == binop_string)
+        {
+            AddDictionaryString(dict, *(const std::string*)p);
+            continue;
+        }
+
+        if (op.kind != binop_array || (op.elemKind != binelem_string && op.elemKind != binelem_class))
+            continue;
+
+        size_t count = op.type->ArraySize((void*)p);
+        if (count == 0)
+            continue;
+
+        const char* pelem = (const char*)op.type->ArrayElement((void*)p, 0);
+        const char* pend = pelem + count * op.size;
+
+        if (op.elemKind == binelem_string)
+        {
+            for (; pelem != pend; pelem += op.size)
+                AddDictionaryString(dict, *(const std::string*)pelem);
+            continue;
+        }
+
+        BinaryPlan& elemPlan = GetBinaryPlan(*op.elemClass);
+        for (; pelem != pend; pelem += op.size)
+            CollectDictionary(pelem, elemPlan, dict);
+    }
+}
+
+void DictionaryToBinaryData(BinaryEncoder& e, const StringDictionary& dict)
+{
+    lengthToBinaryData(e, dict.strings.size());
+
+    for (std::string_view s : dict.strings)
+    {
+        lengthToBinaryData(e, s.length());
+        e.w.Write(s.data(), s.length());
+    }
+}
+
+bool BinaryDataToDictionary(BinaryDecoder& d, StringDictionary& dict)
+{
+    // Each entry takes at least one byte
+    size_t count;
+    if (!BinaryDataToLength(d, count) || count > d.left || !ChargeBinaryArray(d, count, sizeof(std::string_view)))
+        return false;
+
+    dict.strings.resize(count);
+    for (std::string_view& s : dict.strings)
+    {
+        size_t l;
+        if (!BinaryDataToLength(d, l) || d.left < l)
+            return false;
+
+        s = std::string_view(d.buf, l);
+        d.buf += l;
+        d.left -= l;
+    }
+
+    return true;
+}
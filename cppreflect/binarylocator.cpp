@@ -0,0 +1,220 @@
+#include "binarylocator.h"
+#include "binaryplan.h"                     //BinaryPlan
+#include <ctype.h>                          //isdigit
+#include <stdlib.h>                         //strtoull
+
+bool BinaryLocator::Parse(void* _buf, size_t len, ClassTypeInfo& type, int format)
+{
+    cache.clear();
+    elements.clear();
+
+    // Fields of malformed buffer are not located
+    buf = view.Parse(_buf, len, type, format) ? (char*)_buf : nullptr;
+    return buf != nullptr;
+}
+
+//
+//  Splits next path component into field name and element index (SIZE_MAX if component has no index).
+//
+static bool NextPathComponent(const char*& p, std::string& name, size_t& index)
+{
+    const char* end = p + strcspn(p, ".[");
+    name.assign(p, end - p);
+    index = SIZE_MAX;
+    p = end;
+
+    if (name.empty())
+        return false;
+
+    if (*p == '[')
+    {
+        if (!isdigit((unsigned char)p[1]))
+            return false;
+
+        char* e;
+        index = (size_t)strtoull(p + 1, &e, 10);
+        if (*e != ']')
+            return false;
+        p = e + 1;
+    }
+
+    if (*p == '.')
+        return *++p != 0;
+
+    return *p == 0;
+}
+
+//
+//  Gets start of each element of class array field (and end of last one), elements are walked once per array.
+//
+const std::vector<const char*>* BinaryLocator::GetElements(const std::string& key, const BinaryView& v, int field)
+{
+    auto it = elements.find(key);
+    if (it != elements.end())
+        return &it->second;
+
+    const BinaryView::Entry& e = v.fields[field];
+    const BinaryOp& op = GetBinaryPlan(*v.type).fieldOps[field];
+    std::vector<const char*> starts(e.count + 1);
+    const char* p = e.p;
+    size_t left = e.size;
+    BinaryView elem;
+
+    for (size_t i = 0; i < e.count; i++)
+    {
+        size_t consumed;
+        starts[i] = p;
+        if (!v.ParseNested(elem, p, left, *op.elemClass, &consumed))
+            return nullptr;
+
+        p += consumed;
+        left -= consumed;
+    }
+
+    starts[e.count] = p;
+    return &elements.emplace(key, std::move(starts)).first->second;
+}
+
+bool BinaryLocator::Locate(const char* path, Location& loc)
+{
+    if (!buf)
+        return false;
+
+    BinaryView v = view;
+    std::string name;
+    size_t index;
+
+    for (const char* p = path; ; )
+    {
+        const char* start = p;
+        if (!NextPathComponent(p, name, index))
+            return false;
+
+        int field = v.type->GetFieldIndex(name.c_str());
+        if (field < 0)
+            return false;
+
+        const BinaryOp& op = GetBinaryPlan(*v.type).fieldOps[field];
+        const BinaryView::Entry& e = v.fields[field];
+        bool last = *p == 0;
+
+        if (index == SIZE_MAX)
+        {
+            if (op.kind == binop_class && !last)
+            {
+                BinaryView nested;
+                if (!e.p || !v.ParseNested(nested, e.p, e.size, *op.elemClass, nullptr))
+                    return false;
+
+                v = nested;
+                continue;
+            }
+
+            // Field of tagged data may be missing
+            if (op.kind != binop_copy || !last || !e.p)
+                return false;
+
+            loc = { (size_t)(e.p - buf), op.size, op.unit };
+            return true;
+        }
+
+        if (op.kind != binop_array || index >= e.count)
+            return false;
+
+        if (op.elemKind == binelem_pod)
+        {
+            if (!last || e.packed)
+                return false;
+
+            loc = { (size_t)(e.p + index * op.size - buf), op.size, op.unit };
+            return true;
+        }
+
+        if (op.elemKind != binelem_class || last)
+            return false;
+
+        if (v.IsColumnar())
+        {
+            // Column of element field, nested classes are not addressable in columnar data
+            size_t elemIndex;
+            if (!NextPathComponent(p, name, elemIndex) || *p || elemIndex != SIZE_MAX)
+                return false;
+
+            BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+            int elemField = op.elemClass->GetFieldIndex(name.c_str());
+            if (elemField < 0 || plan.fieldOps[elemField].kind != binop_copy)
+                return false;
+
+            const BinaryOp& column = plan.fieldOps[elemField];
+            const char* data;
+            if (!v.FindColumn(field, elemField, column.size, data))
+                return false;
+
+            loc = { (size_t)(data + index * column.size - buf), column.size, column.unit };
+            return true;
+        }
+
+        // Element starts are cached by array path, path prefix identifies array in buffer
+        std::string key(path, start + name.length() - path);
+        const std::vector<const char*>* starts = GetElements(key, v, field);
+        BinaryView elem;
+        if (!starts || !v.ParseNested(elem, (*starts)[index], (*starts)[index + 1] - (*starts)[index], *op.elemClass, nullptr))
+            return false;
+
+        v = elem;
+    }
+}
+
+const BinaryLocator::Location* BinaryLocator::Lookup(const char* path)
+{
+    auto it = cache.find(path);
+    if (it != cache.end())
+        return &it->second;
+
+    Location loc;
+    if (!Locate(path, loc))
+        return nullptr;
+
+    return &cache.emplace(path, loc).first->second;
+}
+
+bool BinaryLocator::Find(const char* path, size_t& offset, size_t& size)
+{
+    const Location* loc = Lookup(path);
+    if (!loc)
+        return false;
+
+    offset = loc->offset;
+    size = loc->size;
+    return true;
+}
+
+bool BinaryLocator::Set(const char* path, const void* value, size_t size)
+{
+    const Location* loc = Lookup(path);
+    if (!loc || loc->size != size)
+        return false;
+
+    char* p = buf + loc->offset;
+    if (view.NeedSwap() && loc->unit > 1)
+        SwapBytes(p, value, size / loc->unit, loc->unit);
+    else
+        memcpy(p, value, size);
+
+    return true;
+}
+
+bool BinaryLocator::Get(const char* path, void* value, size_t size)
+{
+    const Location* loc = Lookup(path);
+    if (!loc || loc->size != size)
+        return false;
+
+    const char* p = buf + loc->offset;
+    if (view.NeedSwap() && loc->unit > 1)
+        SwapBytes(value, p, size / loc->unit, loc->unit);
+    else
+        memcpy(value, p, size);
+
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "binaryview.h"
+#include <unordered_map>
+#include <type_traits>                      //is_trivially_copyable
+
+//
+//  Locates fixed size fields (int, bool, enum...) inside encoded buffer, so they can be read or overwritten in
+//  place without decoding and encoding whole instance again. Field is addressed by path of field names separated
+//  by '.', array element is addressed by index in brackets - for example "people[3].age" or "ids[0]". Located
+//  fields are cached, so repeated access to the same field costs single lookup.
+//
+//  Overwriting fixed size value does not change encoded layout, so locator stays valid after Set(). Compressed
+//  data, packed primitive arrays and data of other schema version cannot be patched in place. Columnar arrays
+//  (binary_columnar) are supported for fixed size fields of array element itself.
+//
+//  Usage:
+//
+//      BinaryLocator loc;
+//      if (loc.Parse(&buf[0], buf.size(), People::GetType()))
+//          loc.Set("people[3].age", 42);
+//
+class BinaryLocator
+{
+public:
+    //
+    //  Parses encoded class instance, returns false if buffer is malformed. Buffer must outlive locator.
+    //
+    bool Parse(void* buf, size_t len, ClassTypeInfo& type, int format = binary_native);
+
+    //
+    //  Gets byte offset and size of fixed size field in buffer, returns false if path does not resolve to fixed
+    //  size field present in buffer.
+    //
+    bool Find(const char* path, size_t& offset, size_t& size);
+
+    //
+    //  Overwrites fixed size field value in buffer, size must match field size.
+    //
+    bool Set(const char* path, const void* value, size_t size);
+
+    template <class T>
+    bool Set(const char* path, const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only fixed size values can be patched");
+        return Set(path, &value, sizeof(T));
+    }
+
+    //
+    //  Reads fixed size field value from buffer, size must match field size.
+    //
+    bool Get(const char* path, void* value, size_t size);
+
+    template <class T>
+    bool Get(const char* path, T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only fixed size values can be read");
+        return Get(path, &value, sizeof(T));
+    }
+
+protected:
+    struct Location
+    {
+        size_t offset;
+        size_t size;
+        size_t unit;                        // Scalar size, for byte swapping
+    };
+
+    bool Locate(const char* path, Location& loc);
+    const Location* Lookup(const char* path);
+    const std::vector<const char*>* GetElements(const std::string& key, const BinaryView& v, int field);
+
+    char* buf = nullptr;
+    BinaryView view;
+    std::unordered_map<std::string, Location> cache;
+
+    // Start of each element of class arrays (and end of last one), by array path
+    std::unordered_map<std::string, std::vector<const char*>> elements;
+};
@@ -0,0 +1,343 @@
+#include "binaryplan.h"                     //BinaryEncoder, BinaryDecoder
+#include <algorithm>                        //min
+#include <utility>                          //index_sequence
+
+static inline size_t BitWidth(uint64_t v)
+{
+    if (!v)
+        return 0;
+
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return (size_t)i + 1;
+#else
+    return (size_t)(64 - __builtin_clzll(v));
+#endif
+}
+
+static inline uint64_t LoadLE64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return LittleEndian64(v);
+}
+
+static inline void StoreLE64(char* p, uint64_t v)
+{
+    v = LittleEndian64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+template <class T>
+static inline T LoadValue(const char* p)
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+//
+//  Difference of two values (modulo 2^bits of T), zigzag encoded, so small negative deltas give small values too.
+//
+template <class T>
+static inline uint64_t ZigzagDelta(T value, T prev)
+{
+    T d = (T)(value - prev);
+    T sign = (T)(0 - (T)(d >> (sizeof(T) * 8 - 1)));
+    return (uint64_t)(T)((T)(d << 1) ^ sign);
+}
+
+template <class T>
+static inline T UnzigzagDelta(uint64_t v)
+{
+    return (T)((T)(v >> 1) ^ (T)(0 - (T)(v & 1)));
+}
+
+//
+//  Packs count values of width bits in little-endian bit order, returns amount of bytes written.
+//
+static size_t PackBits(const uint64_t* v, size_t count, size_t width, char* out)
+{
+    char* o = out;
+    uint64_t acc = 0;
+    size_t bits = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        acc |= v[i] << bits;
+        bits += width;
+
+        if (bits >= 64)
+        {
+            StoreLE64(o, acc);
+            o += 8;
+            bits -= 64;
+            acc = bits ? v[i] >> (width - bits) : 0;
+        }
+    }
+
+    for (; bits; bits = bits > 8 ? bits - 8 : 0)
+    {
+        *o++ = (char)acc;
+        acc >>= 8;
+    }
+
+    return (size_t)(o - out);
+}
+
+template <class T>
+static void PackedValuesToBinaryData(BinaryEncoder& e, const char* p, size_t count, size_t unit)
+{
+    // Measure first - bit width of each block decides whether packing pays off
+    size_t raw = 1 + count * sizeof(T);
+    size_t packed = unit == sizeof(T) ? 1 + sizeof(T) : raw;
+    T first = LoadValue<T>(p);
+    T prev = first;
+
+    for (size_t i = 1; i < count && packed < raw; i += binaryPackedBlock)
+    {
+        size_t n = std::min(binaryPackedBlock, count - i);
+        uint64_t bits = 0;
+
+        for (const char* pv = p + i * sizeof(T), *pend = pv + n * sizeof(T); pv != pend; pv += sizeof(T))
+        {
+            T v = LoadValue<T>(pv);
+            bits |= ZigzagDelta(v, prev);
+            prev = v;
+        }
+
+        packed += 1 + PackedBlockSize(n, BitWidth(bits));
+    }
+
+    if (packed >= raw)
+    {
+        char mode = 0;
+        e.w.Write(&mode, 1);
+
+        if (NeedByteSwap(e.format) && unit > 1)
+            SwappedToBinaryData(e.w, p, count * sizeof(T) / unit, unit);
+        else
+            e.w.Write(p, count * sizeof(T));
+        return;
+    }
+
+    char mode = 1;
+    e.w.Write(&mode, 1);
+    uint64_t base = LittleEndian64((uint64_t)first);
+    e.w.Write(&base, sizeof(T));
+
+    uint64_t deltas[binaryPackedBlock];
+    char out[1 + binaryPackedBlock * 8];
+    prev = first;
+
+    for (size_t i = 1; i < count; i += binaryPackedBlock)
+    {
+        size_t n = std::min(binaryPackedBlock, count - i);
+        uint64_t bits = 0;
+
+        for (size_t j = 0; j < n; j++)
+        {
+            T v = LoadValue<T>(p + (i + j) * sizeof(T));
+            deltas[j] = ZigzagDelta(v, prev);
+            bits |= deltas[j];
+            prev = v;
+        }
+
+        size_t width = BitWidth(bits);
+        out[0] = (char)width;
+        e.w.Write(out, 1 + PackBits(deltas, n, width, out + 1));
+    }
+}
+
+void PackedToBinaryData(BinaryEncoder& e, const char* p, size_t count, size_t size, size_t unit)
+{
+    switch (size)
+    {
+        case 2: PackedValuesToBinaryData<uint16_t>(e, p, count, unit);   break;
+        case 4: PackedValuesToBinaryData<uint32_t>(e, p, count, unit);   break;
+        case 8: PackedValuesToBinaryData<uint64_t>(e, p, count, unit);   break;
+    }
+}
+
+//
+//  Unpacks value J of group of 8 values of W bits. Bit position is compile time constant, so it takes just load,
+//  shift and mask.
+//
+template <class T, size_t W, size_t J>
+static inline T UnpackLane(const char* group)
+{
+    const size_t byte = J * W / 8, shift = J * W % 8;
+    const uint64_t mask = W == 64 ? ~(uint64_t)0 : (((uint64_t)1 << W) - 1);
+
+    uint64_t w = LoadLE64(group + byte) >> shift;
+    if (shift + W > 64)
+        w |= (uint64_t)(unsigned char)group[byte + 8] << (64 - shift);
+
+    return UnzigzagDelta<T>(w & mask);
+}
+
+//
+//  Unpacks groups of 8 values of W bits (group takes exactly W bytes) into zigzag decoded deltas. Each group is
+//  straight line code without branches, so compiler can vectorize it. Reads up to 9 bytes past last group, data
+//  must be padded.
+//
+template <class T, size_t W, size_t... J>
+static void UnpackGroups(const char* data, size_t groups, T* out, std::index_sequence<J...>)
+{
+    for (size_t g = 0; g < groups; g++, data += W, out += 8)
+    {
+        T lanes[] = { UnpackLane<T, W, J>(data)... };
+        memcpy(out, lanes, sizeof(lanes));
+    }
+}
+
+template <class T, size_t W>
+static void UnpackGroups(const char* data, size_t groups, T* out)
+{
+    UnpackGroups<T, W>(data, groups, out, std::make_index_sequence<8>());
+}
+
+template <class T>
+using UnpackGroupsFn = void (*)(const char* data, size_t groups, T* out);
+
+template <class T, size_t... W>
+static const UnpackGroupsFn<T>* GetUnpackKernels(std::index_sequence<W...>)
+{
+    static const UnpackGroupsFn<T> kernels[] = { &UnpackGroups<T, W>... };
+    return kernels;
+}
+
+template <class T>
+static void UnpackValues(const char* data, size_t size, size_t count, size_t width, char* dest, uint64_t& prev64)
+{
+    // Block is copied into padded buffer, so kernel does not need to handle end of block
+    char padded[binaryPackedBlock * sizeof(T) + 16];
+    size_t groups = (count + 7) / 8;
+    if (size)
+        memcpy(padded, data, size);
+    memset(padded + size, 0, groups * width + 9 - size);
+
+    T deltas[binaryPackedBlock];
+    GetUnpackKernels<T>(std::make_index_sequence<sizeof(T) * 8 + 1>())[width](padded, groups, deltas);
+
+    // Prefix sum is the only serial part
+    T prev = (T)prev64;
+    for (size_t i = 0; i < count; i++, dest += sizeof(T))
+    {
+        prev = (T)(prev + deltas[i]);
+        memcpy(dest, &prev, sizeof(T));
+    }
+
+    prev64 = prev;
+}
+
+void UnpackBlock(const char* data, size_t size, size_t count, size_t width, char* dest, size_t elemSize, uint64_t& prev)
+{
+    switch (elemSize)
+    {
+        case 2: UnpackValues<uint16_t>(data, size, count, width, dest, prev);  break;
+        case 4: UnpackValues<uint32_t>(data, size, count, width, dest, prev);  break;
+        case 8: UnpackValues<uint64_t>(data, size, count, width, dest, prev);  break;
+    }
+}
+
+//
+//  Reads mode byte and first element of packed array (mode 1).
+//
+static bool BinaryDataToPackedHeader(BinaryDecoder& d, size_t size, unsigned char& mode, uint64_t& first)
+{
+    if (!ReadBinaryData(d, &mode, 1) || mode > 1)
+        return false;
+
+    first = 0;
+    if (mode == 1)
+    {
+        if (!ReadBinaryData(d, &first, size))
+            return false;
+
+        first = LittleEndian64(first);
+    }
+
+    return true;
+}
+
+bool BinaryDataToPacked(BinaryDecoder& d, char* p, size_t count, size_t size, size_t unit)
+{
+    unsigned char mode;
+    uint64_t prev;
+    if (!count)
+        return true;
+
+    if (!BinaryDataToPackedHeader(d, size, mode, prev))
+        return false;
+
+    if (mode == 0)
+    {
+        if (count > d.left / size || !ReadBinaryData(d, p, count * size))
+            return false;
+
+        if (NeedByteSwap(d.format) && unit > 1)
+            SwapBytes(p, p, count * size / unit, unit);
+        return true;
+    }
+
+    // First element is stored as is, zero width block just repeats it
+    UnpackBlock(nullptr, 0, 1, 0, p, size, prev);
+
+    for (size_t i = 1; i < count; i += binaryPackedBlock)
+    {
+        size_t n = std::min(binaryPackedBlock, count - i);
+        unsigned char width;
+        if (!ReadBinaryData(d, &width, 1) || width > size * 8)
+            return false;
+
+        size_t blockSize = PackedBlockSize(n, width);
+        if (d.left < blockSize)
+            return false;
+
+        UnpackBlock(d.buf, blockSize, n, width, p + i * size, size, prev);
+        d.buf += blockSize;
+        d.left -= blockSize;
+    }
+
+    return true;
+}
+
+bool SkipPacked(BinaryDecoder& d, size_t count, size_t size)
+{
+    unsigned char mode;
+    uint64_t first;
+    if (!count)
+        return true;
+
+    if (!BinaryDataToPackedHeader(d, size, mode, first))
+        return false;
+
+    if (mode == 0)
+    {
+        if (count > d.left / size)
+            return false;
+
+        d.buf += count * size;
+        d.left -= count * size;
+        return true;
+    }
+
+    for (size_t i = 1; i < count; i += binaryPackedBlock)
+    {
+        size_t n = std::min(binaryPackedBlock, count - i);
+        unsigned char width;
+        if (!ReadBinaryData(d, &width, 1) || width > size * 8)
+            return false;
+
+        size_t blockSize = PackedBlockSize(n, width);
+        if (d.left < blockSize)
+            return false;
+
+        d.buf += blockSize;
+        d.left -= blockSize;
+    }
+
+    return true;
+}
@@ -0,0 +1,493 @@
+#include "binarypatch.h"
+#include "binaryplan.h"                     //BinaryPlan
+#include <stdexcept>                        //length_error
+#include <algorithm>                        //min
+#include <stddef.h>                         //ptrdiff_t
+
+//
+//  Patch format, all lengths and numbers are varints:
+//
+//      object patch:   change count, changes
+//      change:         tag (field index * 4 + patch kind), patch of kind
+//      patch_value:    new field value, encoded as by serialize_to_buffer
+//      patch_object:   object patch of nested class
+//      patch_array:    hunk count, hunks
+//      hunk:           count of unchanged elements since previous hunk, removed count, inserted count, count of
+//                      elements changed in place (first min(removed, inserted) elements), changed elements (index in
+//                      hunk, new value or object patch of class element), values of remaining inserted elements
+//
+//  Values are encoded in portable format, so patch can be applied on host of other byte order.
+//
+enum PatchKind
+{
+    patch_value,
+    patch_object,
+    patch_array,
+};
+
+static const int patchFormat = binary_varint | binary_portable;
+
+//
+//  Gets operation for single array element.
+//
+static BinaryOp GetElementOp(const BinaryOp& array)
+{
+    BinaryOp op = array;
+    op.offset = 0;
+
+    switch (array.elemKind)
+    {
+        case binelem_pod:       op.kind = binop_copy; break;
+        case binelem_string:    op.kind = binop_string; break;
+        case binelem_wstring:   op.kind = binop_wstring; break;
+        case binelem_blob:      op.kind = binop_blob; op.type = array.elemType; break;
+        case binelem_class:     op.kind = binop_class; break;
+    }
+
+    return op;
+}
+
+static bool IsEqualClass(const char* a, const char* b, BinaryPlan& plan);
+
+static bool IsEqualValue(const char* a, const char* b, const BinaryOp& op)
+{
+    switch (op.kind)
+    {
+        case binop_copy:
+            return memcmp(a, b, op.size) == 0;
+
+        case binop_string:
+            return *(const std::string*)a == *(const std::string*)b;
+
+        case binop_wstring:
+            return *(const std::wstring*)a == *(const std::wstring*)b;
+
+        case binop_blob:
+        {
+            size_t size = op.type->GetRawSize((void*)a);
+            return size == op.type->GetRawSize((void*)b) &&
+                (size == 0 || memcmp(op.type->GetRawPtr((void*)a), op.type->GetRawPtr((void*)b), size) == 0);
+        }
+
+        case binop_array:
+        {
+            size_t size = op.type->ArraySize((void*)a);
+            if (size != op.type->ArraySize((void*)b))
+                return false;
+
+            if (size == 0)
+                return true;
+
+            const char* pa = (const char*)op.type->ArrayElement((void*)a, 0);
+            const char* pb = (const char*)op.type->ArrayElement((void*)b, 0);
+            if (op.elemKind == binelem_pod)
+                return memcmp(pa, pb, size * op.size) == 0;
+
+            BinaryOp elemOp = GetElementOp(op);
+            for (size_t i = 0; i < size; i++, pa += op.size, pb += op.size)
+                if (!IsEqualValue(pa, pb, elemOp))
+                    return false;
+
+            return true;
+        }
+
+        case binop_class:
+            return IsEqualClass(a, b, GetBinaryPlan(*op.elemClass));
+    }
+
+    return false;
+}
+
+static bool IsEqualClass(const char* a, const char* b, BinaryPlan& plan)
+{
+    for (const BinaryOp& op : plan.fieldOps)
+        if (!IsEqualValue(a + op.offset, b + op.offset, op))
+            return false;
+
+    return true;
+}
+
+static size_t ClassToPatch(std::string& patch, const char* a, const char* b, BinaryPlan& plan);
+
+//
+//  Gets object patch of class instance, returns false if instances are equal.
+//
+static bool ObjectToPatch(std::string& object, const char* a, const char* b, BinaryPlan& plan)
+{
+    std::string changes;
+    size_t count = ClassToPatch(changes, a, b, plan);
+    if (count == 0)
+        return false;
+
+    BinaryBufferWriter w(object);
+    BinaryEncoder e = { w, patchFormat };
+    lengthToBinaryData(e, count);
+    w.Write(changes.data(), changes.size());
+    w.Finish();
+    return true;
+}
+
+//
+//  Run of removed and inserted elements - elements [pos, pos + removed) of a are replaced with elements
+//  [bpos, bpos + inserted) of b.
+//
+struct ArrayHunk
+{
+    size_t pos;
+    size_t removed;
+    size_t bpos;
+    size_t inserted;
+};
+
+// Maximum number of removed and inserted elements searched for by FindArrayHunks, more changed arrays are encoded
+// as single hunk.
+static const ptrdiff_t maxArrayEdits = 128;
+
+//
+//  Finds shortest edit script turning elements of a into elements of b (Myers algorithm), returns false if it
+//  has more than maxArrayEdits edits.
+//
+static bool FindArrayHunks(const char* pa, size_t na, const char* pb, size_t nb, const BinaryOp& elemOp,
+    std::vector<ArrayHunk>& hunks)
+{
+    ptrdiff_t n = (ptrdiff_t)na, m = (ptrdiff_t)nb;
+    ptrdiff_t max = std::min(n + m, maxArrayEdits);
+    ptrdiff_t off = max + 1;
+    size_t stride = elemOp.size;
+
+    // Furthest x on each diagonal k = x - y, after each edit count d
+    std::vector<ptrdiff_t> v(2 * max + 3, 0);
+    std::vector<std::vector<ptrdiff_t>> trace;
+    ptrdiff_t edits = -1;
+
+    for (ptrdiff_t d = 0; d <= max && edits < 0; d++)
+    {
+        for (ptrdiff_t k = -d; k <= d; k += 2)
+        {
+            ptrdiff_t x = (k == -d || (k != d && v[off + k - 1] < v[off + k + 1])) ? v[off + k + 1] : v[off + k - 1] + 1;
+            ptrdiff_t y = x - k;
+            while (x < n && y < m && IsEqualValue(pa + x * stride, pb + y * stride, elemOp))
+                x++, y++;
+
+            v[off + k] = x;
+            if (x >= n && y >= m)
+            {
+                edits = d;
+                break;
+            }
+        }
+
+        trace.push_back(v);
+    }
+
+    if (edits < 0)
+        return false;
+
+    // Walks edits back, each edit is single removed or inserted element
+    std::vector<char> script;
+    ptrdiff_t x = n, y = m;
+    for (ptrdiff_t d = edits; d > 0; d--)
+    {
+        const std::vector<ptrdiff_t>& vp = trace[d - 1];
+        ptrdiff_t k = x - y;
+        ptrdiff_t pk = (k == -d || (k != d && vp[off + k - 1] < vp[off + k + 1])) ? k + 1 : k - 1;
+        ptrdiff_t px = vp[off + pk];
+        ptrdiff_t py = px - pk;
+
+        for (; x > px && y > py; x--, y--)
+            script.push_back('=');
+
+        script.push_back(x == px ? '+' : '-');
+        x = px;
+        y = py;
+    }
+
+    // Adjacent edits are joined into hunks
+    size_t ia = 0, ib = 0;
+    bool open = false;
+    for (auto it = script.rbegin(); it != script.rend(); ++it)
+    {
+        if (*it == '=')
+        {
+            ia++, ib++;
+            open = false;
+            continue;
+        }
+
+        if (!open)
+        {
+            hunks.push_back({ ia + (size_t)x, 0, ib + (size_t)y, 0 });
+            open = true;
+        }
+
+        if (*it == '-')
+            ia++, hunks.back().removed++;
+        else
+            ib++, hunks.back().inserted++;
+    }
+
+    return true;
+}
+
+//
+//  Encodes array change as list of hunks. Removed and inserted elements at same position are encoded as changes
+//  in place, class elements by object patch.
+//
+static void ArrayToPatch(BinaryEncoder& e, const char* a, const char* b, const BinaryOp& op)
+{
+    size_t na = op.type->ArraySize((void*)a);
+    size_t nb = op.type->ArraySize((void*)b);
+    const char* pa = na ? (const char*)op.type->ArrayElement((void*)a, 0) : nullptr;
+    const char* pb = nb ? (const char*)op.type->ArrayElement((void*)b, 0) : nullptr;
+    BinaryOp elemOp = GetElementOp(op);
+
+    std::vector<ArrayHunk> hunks;
+    if (!FindArrayHunks(pa, na, pb, nb, elemOp, hunks))
+    {
+        // Too many edits, elements between common prefix and common suffix are replaced
+        size_t prefix = 0;
+        while (prefix < na && prefix < nb && IsEqualValue(pa + prefix * op.size, pb + prefix * op.size, elemOp))
+            prefix++;
+
+        size_t suffix = 0;
+        while (suffix < na - prefix && suffix < nb - prefix &&
+            IsEqualValue(pa + (na - 1 - suffix) * op.size, pb + (nb - 1 - suffix) * op.size, elemOp))
+            suffix++;
+
+        hunks.assign(1, { prefix, na - prefix - suffix, prefix, nb - prefix - suffix });
+    }
+
+    lengthToBinaryData(e, hunks.size());
+    size_t end = 0;
+
+    for (const ArrayHunk& h : hunks)
+    {
+        size_t common = std::min(h.removed, h.inserted);
+        const char* ha = pa + h.pos * op.size;
+        const char* hb = pb + h.bpos * op.size;
+
+        // Elements changed in place
+        std::string changes;
+        BinaryBufferWriter w(changes);
+        BinaryEncoder c = { w, patchFormat };
+        size_t changed = 0;
+
+        for (size_t i = 0; i < common; i++)
+        {
+            const char* ea = ha + i * op.size;
+            const char* eb = hb + i * op.size;
+            if (op.elemKind == binelem_class)
+            {
+                std::string object;
+                if (!ObjectToPatch(object, ea, eb, GetBinaryPlan(*op.elemClass)))
+                    continue;
+
+                lengthToBinaryData(c, i);
+                w.Write(object.data(), object.size());
+            }
+            else
+            {
+                if (IsEqualValue(ea, eb, elemOp))
+                    continue;
+
+                lengthToBinaryData(c, i);
+                ValueToBinaryData(c, eb, elemOp);
+            }
+            changed++;
+        }
+        w.Finish();
+
+        lengthToBinaryData(e, h.pos - end);
+        lengthToBinaryData(e, h.removed);
+        lengthToBinaryData(e, h.inserted);
+        lengthToBinaryData(e, changed);
+        e.w.Write(changes.data(), changes.size());
+
+        for (size_t i = common; i < h.inserted; i++)
+            ValueToBinaryData(e, hb + i * op.size, elemOp);
+
+        end = h.pos + h.removed;
+    }
+}
+
+//
+//  Writes changes of class instance (without change count) into patch, returns number of changes.
+//
+static size_t ClassToPatch(std::string& patch, const char* a, const char* b, BinaryPlan& plan)
+{
+    BinaryBufferWriter w(patch);
+    BinaryEncoder e = { w, patchFormat };
+    size_t count = 0;
+
+    for (size_t i = 0; i < plan.fieldOps.size(); i++)
+    {
+        const BinaryOp& op = plan.fieldOps[i];
+        const char* pa = a + op.offset;
+        const char* pb = b + op.offset;
+
+        switch (op.kind)
+        {
+            case binop_class:
+            {
+                std::string object;
+                if (!ObjectToPatch(object, pa, pb, GetBinaryPlan(*op.elemClass)))
+                    continue;
+
+                lengthToBinaryData(e, i * 4 + patch_object);
+                w.Write(object.data(), object.size());
+                break;
+            }
+
+            case binop_array:
+                if (IsEqualValue(pa, pb, op))
+                    continue;
+
+                lengthToBinaryData(e, i * 4 + patch_array);
+                ArrayToPatch(e, pa, pb, op);
+                break;
+
+            default:
+                if (IsEqualValue(pa, pb, op))
+                    continue;
+
+                lengthToBinaryData(e, i * 4 + patch_value);
+                ValueToBinaryData(e, pb, op);
+                break;
+        }
+        count++;
+    }
+
+    w.Finish();
+    return count;
+}
+
+std::string Diff(const void* a, const void* b, ClassTypeInfo& type)
+{
+    std::string patch;
+    ObjectToPatch(patch, (const char*)a, (const char*)b, GetBinaryPlan(type));
+    return patch;
+}
+
+static bool PatchToClass(BinaryDecoder& d, char* pclass, BinaryPlan& plan);
+
+static bool PatchToArray(BinaryDecoder& d, char* p, const BinaryOp& op)
+{
+    size_t hunks;
+    if (!BinaryDataToLength(d, hunks) || hunks > d.left)
+        return false;
+
+    BinaryOp elemOp = GetElementOp(op);
+    bool empty = op.elemKind == binelem_class && GetBinaryPlan(*op.elemClass).ops.empty();
+    size_t pos = 0;                         // Position in patched array
+
+    for (size_t h = 0; h < hunks; h++)
+    {
+        size_t size = op.type->ArraySize(p);
+        size_t gap, removed, inserted, changed;
+        if (!BinaryDataToLength(d, gap) || !BinaryDataToLength(d, removed) || !BinaryDataToLength(d, inserted) ||
+            !BinaryDataToLength(d, changed))
+            return false;
+
+        // Each change and inserted element takes at least one byte (unless element class has no fields)
+        size_t common = std::min(removed, inserted);
+        if (gap > size - pos || removed > size - pos - gap || changed > common || changed > d.left ||
+            (!empty && inserted - common > d.left))
+            return false;
+
+        pos += gap;
+        size_t last = 0;
+
+        for (size_t i = 0; i < changed; i++)
+        {
+            size_t index;
+            if (!BinaryDataToLength(d, index) || index >= common || (i && index <= last))
+                return false;
+
+            last = index;
+            char* pelem = (char*)op.type->ArrayElement(p, pos + index);
+            bool ok = op.elemKind == binelem_class ?
+                PatchToClass(d, pelem, GetBinaryPlan(*op.elemClass)) : BinaryDataToValue(d, pelem, elemOp);
+            if (!ok)
+                return false;
+        }
+
+        if (removed > inserted)
+            op.type->EraseArrayElements(p, pos + common, removed - inserted);
+
+        if (inserted > removed)
+        {
+            op.type->InsertArrayElements(p, pos + common, inserted - removed);
+            for (size_t i = common; i < inserted; i++)
+                if (!BinaryDataToValue(d, (char*)op.type->ArrayElement(p, pos + i), elemOp))
+                    return false;
+        }
+
+        pos += inserted;
+    }
+
+    return true;
+}
+
+static bool PatchToClass(BinaryDecoder& d, char* pclass, BinaryPlan& plan)
+{
+    size_t count;
+    if (!BinaryDataToLength(d, count) || count > d.left)
+        return false;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t tag;
+        if (!BinaryDataToLength(d, tag))
+            return false;
+
+        size_t field = tag / 4;
+        if (field >= plan.fieldOps.size())
+            return false;
+
+        const BinaryOp& op = plan.fieldOps[field];
+        char* p = pclass + op.offset;
+        bool ok;
+
+        switch (tag % 4)
+        {
+            case patch_value:
+                ok = op.kind != binop_class && op.kind != binop_array && BinaryDataToValue(d, p, op);
+                break;
+
+            case patch_object:
+                ok = op.kind == binop_class && PatchToClass(d, p, GetBinaryPlan(*op.elemClass));
+                break;
+
+            case patch_array:
+                ok = op.kind == binop_array && PatchToArray(d, p, op);
+                break;
+
+            default:
+                ok = false;
+                break;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+bool ApplyPatch(void* pclass, ClassTypeInfo& type, const void* patch, size_t len)
+{
+    // Equal instances
+    if (len == 0)
+        return true;
+
+    try {
+        BinaryDecoder d = { (const char*)patch, len, patchFormat };
+        return PatchToClass(d, (char*)pclass, GetBinaryPlan(type)) && d.left == 0;
+    } catch (std::bad_alloc&) {
+        // Either out of memory or incorrectly decoded patch
+        return false;
+    } catch (std::length_error&) {
+        // Incorrectly decoded length exceeding max_size()
+        return false;
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "cppreflect.h"
+
+//
+//  Computes compact binary patch, which turns instance a into instance b (both of type). Patch addresses fields by
+//  ClassTypeInfo::fields index and contains new values of changed primitive fields, patches of changed nested
+//  classes, and for changed arrays elements removed, inserted and changed in place. Equal instances give empty
+//  patch, so patch size scales with amount of changes rather than with instance size.
+//
+//  Usage:
+//
+//      std::string patch = Diff(&sent, &state, State::GetType());
+//      if (patch.size())
+//          Send(patch);
+//      ...
+//      ApplyPatch(&replica, State::GetType(), patch.data(), patch.size());
+//
+std::string Diff(const void* a, const void* b, ClassTypeInfo& type);
+
+//
+//  Applies patch produced by Diff() to instance equal to Diff() instance a. Returns false if patch is malformed or
+//  does not fit instance, instance may be partially patched then.
+//
+bool ApplyPatch(void* pclass, ClassTypeInfo& type, const void* patch, size_t len);
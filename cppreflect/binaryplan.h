@@ -0,0 +1,575 @@
+#pragma once
+#include "cppreflect.h"
+#include <vector>
+#include <functional>                   //function
+#include <map>
+#include <mutex>                        //mutex, once_flag
+#include <string_view>                  //string_view
+#include <unordered_map>                //unordered_map
+#include <atomic>                       //atomic
+#include <string.h>                     //memcpy
+#include <stdint.h>                     //SIZE_MAX
+#ifdef _MSC_VER
+#include <intrin.h>                     //_BitScanForward64
+#endif
+
+//
+//  Kind of single binary encoding / decoding step.
+//
+enum BinaryOpKind
+{
+    // Fixed size run of memory, copied as is. Adjacent fixed size fields (also from nested classes) are merged into one run.
+    binop_copy,
+
+    // std::string, length prefixed.
+    binop_string,
+
+    // std::wstring, length prefixed.
+    binop_wstring,
+
+    // Any other variable sized type, length prefixed, accessed via GetRawSize / GetRawPtr / SetRawSize.
+    binop_blob,
+
+    // Array (vector<>), element count prefixed. Element is described by elemKind.
+    binop_array,
+
+    // Nested class (elemClass), only in BinaryPlan::fieldOps - ops list has nested class fields inlined.
+    binop_class,
+};
+
+//
+//  Kind of array element.
+//
+enum BinaryElemKind
+{
+    binelem_pod,        // Fixed size primitive, whole array is copied by one memcpy
+    binelem_string,     // std::string
+    binelem_wstring,    // std::wstring
+    binelem_blob,       // Other variable sized type, GetRawSize / GetRawPtr / SetRawSize
+    binelem_class       // Reflectable class, encoded using element class plan
+};
+
+//
+//  Single step of compiled plan.
+//
+struct BinaryOp
+{
+    BinaryOpKind    kind;
+    BinaryElemKind  elemKind;           // binop_array only
+    size_t          offset;             // Offset from the beginning of top level class instance
+    size_t          size;               // binop_copy: run length, binop_array: element stride (sizeof element)
+    BasicTypeInfo*  type;               // Field type (binop_blob, binop_array)
+    BasicTypeInfo*  elemType;           // binop_array: element type
+    ClassTypeInfo*  elemClass;          // binop_class: field class, binop_array with binelem_class: element class
+    size_t          unit;               // binop_copy, binelem_pod: scalar size for byte swapping (1 - not swapped)
+};
+
+//
+//  Flat list of operations needed to encode / decode one class type. Nested (non-array) classes are inlined,
+//  array element classes are referenced by elemClass and use their own plan.
+//
+class BinarySchemaMapping;
+
+class BinaryPlan
+{
+public:
+    std::vector<BinaryOp> ops;
+
+    // Same as ops, but copy runs are merged only when of same scalar size - used to byte swap portable format
+    // (binary_portable) on big-endian host.
+    std::vector<BinaryOp> swapOps;
+
+    // Same as ops, but copy runs are not merged at all - one column per fixed size field, used to encode arrays
+    // of this class column by column (binary_columnar).
+    std::vector<BinaryOp> columnOps;
+
+    //
+    // One operation per ClassTypeInfo::fields entry (same index), nested classes are not inlined. Used where data
+    // needs to be addressed by field.
+    //
+    std::vector<BinaryOp> fieldOps;
+
+    // All fields are fixed size, so every instance has the same encoded size.
+    bool fixed = false;
+
+    // Schema description embedded into binary_schema data and its hash, built on first use by GetSchemaPlan().
+    std::string schema;
+    uint64_t fingerprint = 0;
+    std::once_flag schemaOnce;
+
+    // Mappings from other schema versions (by fingerprint) to this class.
+    std::mutex mappingsLock;
+    std::map<uint64_t, std::shared_ptr<BinarySchemaMapping>> mappings;
+
+    void Compile(ClassTypeInfo& type);
+
+protected:
+    void Compile(ClassTypeInfo& type, size_t base);
+    static void AddCopy(std::vector<BinaryOp>& list, size_t offset, size_t size, size_t unit);
+    static BinaryOp MakeFieldOp(FieldInfo& fi, size_t base);
+};
+
+//
+//  Gets compiled binary plan of class, compiles it on first use. Thread safe.
+//
+BinaryPlan& GetBinaryPlan(ClassTypeInfo& type);
+
+//
+//  Calls f(i) for each i in [0, count) using up to threads threads (calling thread included). Indexes are handed out
+//  dynamically, so uneven work is balanced. Exception thrown by f is rethrown in calling thread. Work is done by
+//  calling thread alone when decode resource is set (see DecodeResourceScope).
+//
+void ParallelFor(size_t count, int threads, const std::function<void(size_t i)>& f);
+
+//
+//  Distinct std::string values of encoded class instance (binary_dictionary), string is referenced by its index.
+//
+class StringDictionary
+{
+public:
+    // Entries in index order, pointing into encoded object (encoding) or encoded buffer (decoding).
+    std::vector<std::string_view> strings;
+
+    // Encoding only: entry index by string.
+    std::unordered_map<std::string_view, size_t> index;
+};
+
+//
+//  Binary encoding state.
+//
+struct BinaryEncoder
+{
+    BinaryWriter& w;
+    int format;
+    int threads = 0;                    // More than 1 - arrays of classes are encoded in parallel
+    const StringDictionary* dict = nullptr;     // binary_dictionary: strings are written as references
+};
+
+//
+//  Decoding limits (BinaryDecodeOptions) and storage charged against them so far, shared by sub decoders and
+//  parallel decoding threads.
+//
+struct BinaryDecodeLimits
+{
+    const BinaryDecodeOptions& options;
+    std::atomic<size_t> bytes{ 0 };
+};
+
+//
+//  Binary decoding state.
+//
+struct BinaryDecoder
+{
+    const char* buf;
+    size_t left;
+    int format;
+    int threads = 0;                    // More than 1 - arrays with offset table are decoded in parallel
+    const StringDictionary* dict = nullptr;     // binary_dictionary: strings are read as references
+    BinaryDecodeLimits* limits = nullptr;       // Decoding limits, nullptr - unlimited
+    size_t depth = 0;                   // Class nesting depth (tracked only with limits)
+};
+
+//
+//  Charges storage about to be allocated against decoding limits, returns false if limit would be exceeded.
+//
+inline bool ChargeBinaryData(BinaryDecoder& d, size_t bytes)
+{
+    if (!d.limits)
+        return true;
+
+    size_t max = d.limits->options.maxBytes;
+    return bytes <= max && d.limits->bytes.fetch_add(bytes) <= max - bytes;
+}
+
+inline bool ChargeBinaryArray(BinaryDecoder& d, size_t count, size_t size)
+{
+    if (!d.limits)
+        return true;
+
+    return count <= d.limits->options.maxArrayCount && count <= SIZE_MAX / size && ChargeBinaryData(d, count * size);
+}
+
+//
+//  Enters nested class instance (class field or array element), Allowed() is false if decoding limits
+//  do not allow deeper nesting.
+//
+class BinaryNestingScope
+{
+public:
+    BinaryNestingScope(BinaryDecoder& d): d(d)
+    {
+        if (d.limits)
+            d.depth++;
+    }
+
+    ~BinaryNestingScope()
+    {
+        if (d.limits)
+            d.depth--;
+    }
+
+    bool Allowed() const
+    {
+        return !d.limits || d.depth <= d.limits->options.maxDepth;
+    }
+
+protected:
+    BinaryDecoder& d;
+};
+
+// Array elements per offset table entry (binary_offsets).
+const size_t binaryOffsetBlock = 64;
+
+inline size_t OffsetTableBlocks(size_t count)
+{
+    return (count + binaryOffsetBlock - 1) / binaryOffsetBlock;
+}
+
+//
+//  true if array elements are preceded by offset table - binary_offsets format, array of variable sized classes.
+//
+inline bool HasOffsetTable(int format, const BinaryOp& op)
+{
+    return (format & binary_offsets) && !(format & binary_columnar) && op.elemKind == binelem_class &&
+        !GetBinaryPlan(*op.elemClass).fixed;
+}
+
+//
+//  Reads offset table of array with count elements. Sizes of element blocks are stored into blocks (if non-null),
+//  total receives encoded size of all elements, which is verified to fit into remaining buffer.
+//
+bool BinaryDataToOffsetTable(BinaryDecoder& d, size_t count, std::vector<size_t>* blocks, size_t& total);
+
+inline void VarintToBinaryData(BinaryWriter& w, uint64_t v)
+{
+    char tmp[10];
+    size_t n = 0;
+
+    for (; v >= 0x80; v >>= 7)
+        tmp[n++] = (char)(v | 0x80);
+
+    tmp[n++] = (char)v;
+    w.Write(tmp, n);
+}
+
+//
+//  true if fixed size values must be byte swapped - portable format on big-endian host.
+//
+inline bool NeedByteSwap(int format)
+{
+#ifdef CPPREFLECT_BIG_ENDIAN
+    return (format & binary_portable) != 0;
+#else
+    (void)format;
+    return false;
+#endif
+}
+
+inline uint64_t LittleEndian64(uint64_t v)
+{
+#ifdef CPPREFLECT_BIG_ENDIAN
+    return __builtin_bswap64(v);
+#else
+    return v;
+#endif
+}
+
+//
+//  Gets plan operations to run for given format.
+//
+inline const std::vector<BinaryOp>& GetPlanOps(BinaryPlan& plan, int format)
+{
+    return NeedByteSwap(format) ? plan.swapOps : plan.ops;
+}
+
+//
+//  Reverses byte order of count scalars of unit (2, 4 or 8) bytes, dest may be same as src.
+//
+void SwapBytes(void* dest, const void* src, size_t count, size_t unit);
+
+//
+//  Writes count scalars of unit bytes in swapped byte order.
+//
+void SwappedToBinaryData(BinaryWriter& w, const void* p, size_t count, size_t unit);
+
+inline void lengthToBinaryData(BinaryEncoder& e, size_t t)
+{
+    if (e.format & binary_varint)
+    {
+        VarintToBinaryData(e.w, t);
+    }
+    else if (e.format & binary_portable)
+    {
+        uint64_t v = LittleEndian64(t);
+        e.w.Write(&v, sizeof(v));
+    }
+    else
+    {
+        e.w.Write(&t, sizeof(size_t));
+    }
+}
+
+//
+//  Encodes std::wstring - length prefixed wchar_t data, or UTF-8 in portable format.
+//
+void WStringToBinaryData(BinaryEncoder& e, const std::wstring& s);
+
+inline bool ReadBinaryData(BinaryDecoder& d, void* p, size_t size)
+{
+    if (d.left < size)
+        return false;
+
+    if (size)
+        memcpy(p, d.buf, size);
+    d.buf += size;
+    d.left -= size;
+    return true;
+}
+
+inline int CountTrailingZeros(uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+//
+//  Decodes LEB128 varint. Values up to 8 bytes long are decoded from one 64-bit load without per byte branching.
+//
+bool BinaryDataToVarint(BinaryDecoder& d, uint64_t& v);
+
+inline bool BinaryDataToLength(BinaryDecoder& d, size_t& t)
+{
+    if ((d.format & binary_portable) && !(d.format & binary_varint))
+    {
+        uint64_t v;
+        if (!ReadBinaryData(d, &v, sizeof(v)))
+            return false;
+
+        v = LittleEndian64(v);
+        if (v > SIZE_MAX)
+            return false;
+
+        t = (size_t)v;
+        return true;
+    }
+
+    if (!(d.format & binary_varint))
+        return ReadBinaryData(d, &t, sizeof(size_t));
+
+    // Most of lengths are below 128 - single byte.
+    if (d.left && !(*d.buf & 0x80))
+    {
+        t = (unsigned char)*d.buf;
+        d.buf++;
+        d.left--;
+        return true;
+    }
+
+    uint64_t v;
+    if (!BinaryDataToVarint(d, v) || v > SIZE_MAX)
+        return false;
+
+    t = (size_t)v;
+    return true;
+}
+
+//
+//  Decodes std::wstring, see WStringToBinaryData.
+//
+bool BinaryDataToWString(BinaryDecoder& d, std::wstring& s);
+
+//
+//  Encodes std::string - length prefixed, or dictionary index (binary_dictionary).
+//
+inline void StringToBinaryData(BinaryEncoder& e, const std::string& s)
+{
+    if (e.dict)
+    {
+        VarintToBinaryData(e.w, e.dict->index.find(s)->second);
+        return;
+    }
+
+    lengthToBinaryData(e, s.length());
+    e.w.Write(s.data(), s.length());
+}
+
+//
+//  Decodes std::string without copying - view points into buffer, or into its dictionary.
+//
+inline bool BinaryDataToStringView(BinaryDecoder& d, std::string_view& s)
+{
+    if (d.dict)
+    {
+        uint64_t i;
+        if (!BinaryDataToVarint(d, i) || i >= d.dict->strings.size())
+            return false;
+
+        s = d.dict->strings[(size_t)i];
+        return true;
+    }
+
+    size_t l;
+    if (!BinaryDataToLength(d, l) || d.left < l)
+        return false;
+
+    s = std::string_view(d.buf, l);
+    d.buf += l;
+    d.left -= l;
+    return true;
+}
+
+//
+//  Collects std::string values of class instance into dictionary, in order of first occurrence.
+//
+void CollectDictionary(const char* pclass, BinaryPlan& plan, StringDictionary& dict);
+
+//
+//  Dictionary layout: entry count, length prefixed entries. Decoded entries point into buffer.
+//
+void DictionaryToBinaryData(BinaryEncoder& e, const StringDictionary& dict);
+bool BinaryDataToDictionary(BinaryDecoder& d, StringDictionary& dict);
+
+//
+//  Converts UTF-8 to std::wstring, returns false if data is not valid UTF-8.
+//
+bool Utf8ToWString(const char* p, size_t size, std::wstring& s);
+
+//
+//  Validates UTF-8, gets length of its std::wstring conversion.
+//
+bool Utf8ToWStringLength(const char* p, size_t size, size_t& length);
+
+//
+//  true if primitive array elements of size bytes are delta / bit-packed (binary_packed format).
+//
+inline bool IsPackedElement(int format, size_t size)
+{
+    return (format & binary_packed) && (size == 2 || size == 4 || size == 8);
+}
+
+// Values per bit-packed block (binary_packed).
+const size_t binaryPackedBlock = 128;
+
+//
+//  binary_packed: encodes count (> 0) elements of size bytes. Layout is mode byte, then either raw elements (mode 0,
+//  byte swapped by unit in portable format), or (mode 1) first element as little-endian size bytes, followed by blocks
+//  of up to binaryPackedBlock zigzag encoded deltas: bit width byte, values packed in little-endian bit order.
+//  Only scalar elements (unit == size) are delta packed, and only when it's smaller than raw elements.
+//
+void PackedToBinaryData(BinaryEncoder& e, const char* p, size_t count, size_t size, size_t unit);
+
+//
+//  Decodes packed array of count elements into p / skips it. Skipping validates whole structure, so it's used to
+//  check data before array is allocated.
+//
+bool BinaryDataToPacked(BinaryDecoder& d, char* p, size_t count, size_t size, size_t unit);
+bool SkipPacked(BinaryDecoder& d, size_t count, size_t size);
+
+//
+//  Gets encoded size of packed block of count values of given bit width.
+//
+inline size_t PackedBlockSize(size_t count, size_t width)
+{
+    return (count * width + 7) / 8;
+}
+
+//
+//  Unpacks block of count deltas of width bits from data, and restores elements of elemSize bytes from them into
+//  dest. prev is last restored element (updated).
+//
+void UnpackBlock(const char* data, size_t size, size_t count, size_t width, char* dest, size_t elemSize, uint64_t& prev);
+
+//
+//  Skips encoded class instance / single value without decoding it. Returns false if data is malformed.
+//
+bool SkipBinaryData(BinaryDecoder& d, BinaryPlan& plan);
+bool SkipBinaryValue(BinaryDecoder& d, const BinaryOp& op);
+
+//
+//  Skips count elements of binop_array (element count is already decoded).
+//
+bool SkipBinaryElements(BinaryDecoder& d, const BinaryOp& op, size_t count);
+
+//
+//  Skips column of count values of plan column operation (binary_columnar) / all columns of class array.
+//
+bool SkipBinaryColumn(BinaryDecoder& d, const BinaryOp& op, size_t count);
+bool SkipBinaryColumns(BinaryDecoder& d, BinaryPlan& plan, size_t count);
+
+//
+//  Decodes class instance using its plan / single plan operation.
+//
+bool BinaryDataToPlan(BinaryDecoder& d, char* pclass, BinaryPlan& plan);
+bool BinaryDataToValue(BinaryDecoder& d, char* p, const BinaryOp& op);
+
+//
+//  Encodes single plan operation.
+//
+void ValueToBinaryData(BinaryEncoder& e, const char* p, const BinaryOp& op);
+
+//
+//  Wire type of field in tagged format (binary_tagged).
+//
+enum TaggedWireType
+{
+    wire_fixed1,            // Fixed size value of 1, 2, 4 or 8 bytes
+    wire_fixed2,
+    wire_fixed4,
+    wire_fixed8,
+    wire_bytes,             // Length prefixed: string, blob or fixed size value of other size
+    wire_object,            // Length prefixed tagged class instance
+    wire_array,             // Length prefixed: element count, elements (class elements are wire_object)
+};
+
+//
+//  Tagged format: class instance is encoded as length prefixed list of fields, each field starts with varint tag
+//  (field index << 3 | wire type).
+//
+void TaggedToBinaryData(BinaryEncoder& e, const char* pclass, BinaryPlan& plan);
+bool BinaryDataToTagged(BinaryDecoder& d, char* pclass, BinaryPlan& plan);
+
+//
+//  Decodes tagged field value (after tag) of wire type matching op.
+//
+bool BinaryDataToTaggedField(BinaryDecoder& f, char* pclass, const BinaryOp& op, int wire);
+
+//
+//  Gets wire type used to encode field in tagged format.
+//
+TaggedWireType GetTaggedWireType(const BinaryOp& op);
+
+//
+//  Reads field tag.
+//
+bool BinaryDataToTag(BinaryDecoder& d, size_t& field, int& wire);
+
+//
+//  Skips tagged field value (after tag) in O(1).
+//
+bool SkipTaggedValue(BinaryDecoder& d, int wire);
+
+//
+//  Gets binary plan of class with schema description built.
+//
+BinaryPlan& GetSchemaPlan(ClassTypeInfo& type);
+
+//
+//  Writes schema header (binary_schema): uint64 fingerprint, length prefixed schema description.
+//
+void SchemaToBinaryData(BinaryEncoder& e, ClassTypeInfo& type);
+
+//
+//  Decodes class instance prefixed with schema header. Data of same schema is decoded directly, data of other schema
+//  version is decoded field by field by name - unknown fields are skipped, missing fields keep their values.
+//
+bool BinaryDataToSchemaNode(BinaryDecoder& d, char* pclass, ClassTypeInfo& type);
+
+//
+//  Skips schema header, returns false if data schema differs from type.
+//
+bool SkipSchemaHeader(BinaryDecoder& d, ClassTypeInfo& type);
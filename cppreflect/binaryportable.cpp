@@ -0,0 +1,345 @@
+#include "binaryplan.h"                     //BinaryDecoder, BinaryEncoder
+#include <algorithm>                        //min
+#if defined(__SSSE3__)
+#include <tmmintrin.h>                      //_mm_shuffle_epi8
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>                       //vrev16q_u8
+#endif
+
+static inline uint16_t ByteSwap16(uint16_t v)
+{
+#ifdef _MSC_VER
+    return _byteswap_ushort(v);
+#else
+    return __builtin_bswap16(v);
+#endif
+}
+
+static inline uint32_t ByteSwap32(uint32_t v)
+{
+#ifdef _MSC_VER
+    return _byteswap_ulong(v);
+#else
+    return __builtin_bswap32(v);
+#endif
+}
+
+static inline uint64_t ByteSwap64(uint64_t v)
+{
+#ifdef _MSC_VER
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+template <class T, T (*Swap)(T)>
+static inline void SwapScalars(unsigned char* d, const unsigned char* s, size_t i, size_t n)
+{
+    for (; i < n; i += sizeof(T))
+    {
+        T v;
+        memcpy(&v, s + i, sizeof(T));
+        v = Swap(v);
+        memcpy(d + i, &v, sizeof(T));
+    }
+}
+
+void SwapBytes(void* dest, const void* src, size_t count, size_t unit)
+{
+    const unsigned char* s = (const unsigned char*)src;
+    unsigned char* d = (unsigned char*)dest;
+    size_t n = count * unit;
+    size_t i = 0;
+
+    // 16 bytes at a time, each block is loaded before it's stored, so swapping in place works.
+#if defined(__SSSE3__)
+    __m128i mask =
+        unit == 2 ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14) :
+        unit == 4 ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+                    _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(s + i);
+        v = unit == 2 ? vrev16q_u8(v) : unit == 4 ? vrev32q_u8(v) : vrev64q_u8(v);
+        vst1q_u8(d + i, v);
+    }
+#endif
+
+    // Tail, or whole array when SIMD is not available (compilers vectorize these loops as well)
+    switch (unit)
+    {
+        case 2: SwapScalars<uint16_t, ByteSwap16>(d, s, i, n);  break;
+        case 4: SwapScalars<uint32_t, ByteSwap32>(d, s, i, n);  break;
+        case 8: SwapScalars<uint64_t, ByteSwap64>(d, s, i, n);  break;
+        default:
+            if (d != s)
+                memmove(d + i, s + i, n - i);
+            break;
+    }
+}
+
+void SwappedToBinaryData(BinaryWriter& w, const void* p, size_t count, size_t unit)
+{
+    const char* src = (const char*)p;
+    char tmp[1024];
+    size_t size = count * unit;
+
+    // Large arrays are swapped directly into output
+    if (size > sizeof(tmp))
+    {
+        char* out = w.Reserve(size);
+        if (out)
+        {
+            SwapBytes(out, src, count, unit);
+            return;
+        }
+    }
+
+    while (count)
+    {
+        size_t n = std::min(count, sizeof(tmp) / unit);
+        SwapBytes(tmp, src, n, unit);
+        w.Write(tmp, n * unit);
+        src += n * unit;
+        count -= n;
+    }
+}
+
+//
+//  Gets next code point of wchar_t string (UTF-16 or UTF-32 depending on platform), invalid ones are replaced
+//  with U+FFFD.
+//
+static inline uint32_t NextCodePoint(const wchar_t*& p, const wchar_t* end)
+{
+    uint32_t c = (uint32_t)*p++;
+
+    if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF && p != end && (uint32_t)*p >= 0xDC00 && (uint32_t)*p <= 0xDFFF)
+        c = 0x10000 + ((c - 0xD800) << 10) + ((uint32_t)*p++ - 0xDC00);
+
+    if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF)
+        c = 0xFFFD;
+
+    return c;
+}
+
+static inline size_t Utf8Length(uint32_t c)
+{
+    return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
+static inline char* PutUtf8(char* o, uint32_t c)
+{
+    if (c < 0x80)
+    {
+        *o++ = (char)c;
+    }
+    else if (c < 0x800)
+    {
+        *o++ = (char)(0xC0 | (c >> 6));
+        *o++ = (char)(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000)
+    {
+        *o++ = (char)(0xE0 | (c >> 12));
+        *o++ = (char)(0x80 | ((c >> 6) & 0x3F));
+        *o++ = (char)(0x80 | (c & 0x3F));
+    }
+    else
+    {
+        *o++ = (char)(0xF0 | (c >> 18));
+        *o++ = (char)(0x80 | ((c >> 12) & 0x3F));
+        *o++ = (char)(0x80 | ((c >> 6) & 0x3F));
+        *o++ = (char)(0x80 | (c & 0x3F));
+    }
+
+    return o;
+}
+
+void WStringToBinaryData(BinaryEncoder& e, const std::wstring& s)
+{
+    if (!(e.format & binary_portable))
+    {
+        lengthToBinaryData(e, s.length() * sizeof(wchar_t));
+        e.w.Write(s.data(), s.length() * sizeof(wchar_t));
+        return;
+    }
+
+    const wchar_t* begin = s.data();
+    const wchar_t* end = begin + s.length();
+    size_t size = 0;
+
+    for (const wchar_t* p = begin; p != end; )
+        size += Utf8Length(NextCodePoint(p, end));
+
+    lengthToBinaryData(e, size);
+
+    char tmp[256];
+    char* o = tmp;
+    for (const wchar_t* p = begin; p != end; )
+    {
+        o = PutUtf8(o, NextCodePoint(p, end));
+
+        if (o > tmp + sizeof(tmp) - 4)
+        {
+            e.w.Write(tmp, (size_t)(o - tmp));
+            o = tmp;
+        }
+    }
+
+    e.w.Write(tmp, (size_t)(o - tmp));
+}
+
+// Bytes checked at once by ASCII fast path.
+static const size_t utf8AsciiBlock = 32;
+
+//
+//  Decodes next UTF-8 sequence, returns false if it's malformed, overlong or not a valid code point.
+//
+static inline bool NextUtf8(const unsigned char*& p, const unsigned char* end, uint32_t& c)
+{
+    c = *p++;
+    if (c < 0x80)
+        return true;
+
+    size_t n;
+    uint32_t min;
+
+    if ((c & 0xE0) == 0xC0)         { n = 1; min = 0x80;    c &= 0x1F; }
+    else if ((c & 0xF0) == 0xE0)    { n = 2; min = 0x800;   c &= 0x0F; }
+    else if ((c & 0xF8) == 0xF0)    { n = 3; min = 0x10000; c &= 0x07; }
+    else
+        return false;
+
+    if ((size_t)(end - p) < n)
+        return false;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+            return false;
+
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+
+    p += n;
+    return c >= min && c <= 0x10FFFF && !(c >= 0xD800 && c <= 0xDFFF);
+}
+
+//
+//  Checks if fixed size block is ASCII only. Loop has constant trip count and no early exit, so compiler turns it
+//  into vector or + sign mask test.
+//
+static inline bool IsAsciiBlock(const unsigned char* p)
+{
+    unsigned char bits = 0;
+    for (size_t i = 0; i < utf8AsciiBlock; i++)
+        bits |= p[i];
+
+    return bits < 0x80;
+}
+
+bool Utf8ToWStringLength(const char* utf8, size_t size, size_t& length)
+{
+    const unsigned char* p = (const unsigned char*)utf8;
+    const unsigned char* end = p + size;
+    uint32_t c;
+    length = 0;
+
+    while (p != end)
+    {
+        // Long ASCII runs are checked block at a time
+        if ((size_t)(end - p) >= utf8AsciiBlock && IsAsciiBlock(p))
+        {
+            p += utf8AsciiBlock;
+            length += utf8AsciiBlock;
+            continue;
+        }
+
+        // Shorter ASCII runs are checked 8 bytes at a time
+        uint64_t x;
+        if ((size_t)(end - p) >= sizeof(x))
+        {
+            memcpy(&x, p, sizeof(x));
+            if ((x & 0x8080808080808080ull) == 0)
+            {
+                p += sizeof(x);
+                length += sizeof(x);
+                continue;
+            }
+        }
+
+        if (!NextUtf8(p, end, c))
+            return false;
+
+        length += (sizeof(wchar_t) == 2 && c >= 0x10000) ? 2 : 1;
+    }
+
+    return true;
+}
+
+bool Utf8ToWString(const char* utf8, size_t size, std::wstring& s)
+{
+    const unsigned char* begin = (const unsigned char*)utf8;
+    const unsigned char* end = begin + size;
+    size_t length;
+    uint32_t c;
+
+    if (!Utf8ToWStringLength(utf8, size, length))
+        return false;
+
+    s.resize(length);
+    wchar_t* o = length ? &s[0] : nullptr;
+
+    for (const unsigned char* p = begin; p != end; )
+    {
+        NextUtf8(p, end, c);
+
+        if (sizeof(wchar_t) == 2 && c >= 0x10000)
+        {
+            c -= 0x10000;
+            *o++ = (wchar_t)(0xD800 + (c >> 10));
+            *o++ = (wchar_t)(0xDC00 + (c & 0x3FF));
+        }
+        else
+        {
+            *o++ = (wchar_t)c;
+        }
+    }
+
+    return true;
+}
+
+bool BinaryDataToWString(BinaryDecoder& d, std::wstring& s)
+{
+    size_t l;
+    if (!BinaryDataToLength(d, l) || d.left < l)
+        return false;
+
+    // UTF-8 byte gives at most one character
+    if (!ChargeBinaryData(d, (d.format & binary_portable) ? l * sizeof(wchar_t) : l))
+        return false;
+
+    if (d.format & binary_portable)
+    {
+        if (!Utf8ToWString(d.buf, l, s))
+            return false;
+
+        d.buf += l;
+        d.left -= l;
+        return true;
+    }
+
+    if (l % sizeof(wchar_t) != 0)
+        return false;
+
+    s.resize(l / sizeof(wchar_t));
+    return ReadBinaryData(d, &s[0], l);
+}
@@ -0,0 +1,301 @@
+#include "binaryprojection.h"
+#include "binaryplan.h"                     //BinaryPlan
+#include "compression.h"                    //DecompressChunks
+#include <stdexcept>                        //length_error
+
+typedef BinaryProjection::Selection Selection;
+
+bool BinaryProjection::Select(const char* path)
+{
+    // Resolve whole path first, so failed selection does not change projection
+    std::vector<size_t> indexes;
+    ClassTypeInfo* cls = type;
+
+    for (const char* p = path; ; )
+    {
+        const char* end = strchr(p, '.');
+        std::string name = end ? std::string(p, end - p) : std::string(p);
+
+        if (!cls)
+            return false;               // Field of primitive type cannot have sub-fields
+
+        int i = cls->GetFieldIndex(name.c_str());
+        if (i < 0)
+            return false;
+
+        indexes.push_back((size_t)i);
+        FieldInfo& fi = cls->fields[i];
+        BasicTypeInfo* t = fi.arrayElementType ? fi.arrayElementType : fi.fieldType.get();
+        cls = dynamic_cast<ClassTypeInfo*>(t);
+
+        if (!end)
+            break;
+        p = end + 1;
+    }
+
+    Selection* s = &root;
+    cls = type;
+
+    for (size_t i : indexes)
+    {
+        if (s->all)
+            return true;
+
+        s->fields.resize(cls->fields.size());
+        if (!s->fields[i])
+            s->fields[i].reset(new Selection());
+
+        s = s->fields[i].get();
+        FieldInfo& fi = cls->fields[i];
+        cls = dynamic_cast<ClassTypeInfo*>(fi.arrayElementType ? fi.arrayElementType : fi.fieldType.get());
+    }
+
+    s->all = true;
+    s->fields.clear();
+    return true;
+}
+
+static inline const Selection* GetFieldSelection(const Selection& sel, size_t i)
+{
+    return i < sel.fields.size() ? sel.fields[i].get() : nullptr;
+}
+
+static bool ProjectedToClass(BinaryDecoder& d, char* pclass, ClassTypeInfo& type, const Selection& sel);
+
+//
+//  Collects selection of each column of class (BinaryPlan::columnOps, nested classes inlined), nullptr - column is
+//  not selected.
+//
+static void CollectColumns(ClassTypeInfo& type, const Selection* sel, std::vector<const Selection*>& columns)
+{
+    for (size_t i = 0; i < type.fields.size(); i++)
+    {
+        FieldInfo& fi = type.fields[i];
+        const Selection* f = (!sel || sel->all) ? sel : GetFieldSelection(*sel, i);
+        ClassTypeInfo* cls = fi.arrayElementType ? nullptr : dynamic_cast<ClassTypeInfo*>(fi.fieldType.get());
+
+        if (cls)
+            CollectColumns(*cls, f, columns);
+        else
+            columns.push_back(f);
+    }
+}
+
+static bool ProjectedToArray(BinaryDecoder& d, char* p, const BinaryOp& op, const Selection& sel);
+
+//
+//  Decodes selected columns of count class instances (binary_columnar).
+//
+static bool ProjectedColumns(BinaryDecoder& d, char* p, size_t count, size_t stride, ClassTypeInfo& type, const Selection& sel)
+{
+    BinaryPlan& plan = GetBinaryPlan(type);
+    std::vector<const Selection*> columns;
+    CollectColumns(type, &sel, columns);
+    char* pend = p + count * stride;
+
+    for (size_t i = 0; i < plan.columnOps.size(); i++)
+    {
+        const BinaryOp& op = plan.columnOps[i];
+        const Selection* f = columns[i];
+
+        if (!f)
+        {
+            if (!SkipBinaryColumn(d, op, count))
+                return false;
+            continue;
+        }
+
+        for (char* pelem = p; pelem != pend; pelem += stride)
+            if (!(f->all ? BinaryDataToValue(d, pelem + op.offset, op) : ProjectedToArray(d, pelem + op.offset, op, *f)))
+                return false;
+    }
+
+    return true;
+}
+
+//
+//  Decodes array of classes, with some of element fields selected.
+//
+static bool ProjectedToArray(BinaryDecoder& d, char* p, const BinaryOp& op, const Selection& sel)
+{
+    size_t count;
+    if (!BinaryDataToLength(d, count))
+        return false;
+
+    // Each element takes at least one byte
+    BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+    if (!plan.ops.empty() && count > d.left)
+        return false;
+
+    bool table = count && HasOffsetTable(d.format, op);
+    size_t total = 0;
+    if (table && !BinaryDataToOffsetTable(d, count, nullptr, total))
+        return false;
+
+    op.type->SetArraySize(p, count);
+    if (count == 0)
+        return true;
+
+    char* pelem = (char*)op.type->ArrayElement(p, 0);
+    if (d.format & binary_columnar)
+        return ProjectedColumns(d, pelem, count, op.size, *op.elemClass, sel);
+
+    size_t left = d.left;
+    for (size_t i = 0; i < count; i++, pelem += op.size)
+        if (!ProjectedToClass(d, pelem, *op.elemClass, sel))
+            return false;
+
+    return !table || left - d.left == total;
+}
+
+static bool ProjectedToClass(BinaryDecoder& d, char* pclass, ClassTypeInfo& type, const Selection& sel)
+{
+    BinaryPlan& plan = GetBinaryPlan(type);
+    if (sel.all)
+        return BinaryDataToPlan(d, pclass, plan);
+
+    for (size_t i = 0; i < plan.fieldOps.size(); i++)
+    {
+        const BinaryOp& op = plan.fieldOps[i];
+        const Selection* f = GetFieldSelection(sel, i);
+        char* p = pclass + op.offset;
+        bool ok;
+
+        if (!f)
+            ok = SkipBinaryValue(d, op);
+        else if (f->all)
+            ok = BinaryDataToValue(d, p, op);
+        else if (op.kind == binop_class)
+            ok = ProjectedToClass(d, p, *op.elemClass, *f);
+        else
+            ok = ProjectedToArray(d, p, op, *f);
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+//
+//  Splits length prefixed value from d into sub decoder.
+//
+static inline bool ProjectedSubDecoder(BinaryDecoder& d, BinaryDecoder& sub)
+{
+    size_t l;
+    if (!BinaryDataToLength(d, l) || d.left < l)
+        return false;
+
+    sub = d;
+    sub.left = l;
+    d.buf += l;
+    d.left -= l;
+    return true;
+}
+
+static bool ProjectedTagged(BinaryDecoder& d, char* pclass, ClassTypeInfo& type, const Selection& sel);
+
+static bool ProjectedTaggedArray(BinaryDecoder& d, char* p, const BinaryOp& op, const Selection& sel)
+{
+    BinaryDecoder a = d;
+    if (!ProjectedSubDecoder(d, a))
+        return false;
+
+    // Each element takes at least one byte (its length)
+    size_t count;
+    if (!BinaryDataToLength(a, count) || count > a.left)
+        return false;
+
+    op.type->SetArraySize(p, count);
+    for (size_t i = 0; i < count; i++)
+        if (!ProjectedTagged(a, (char*)op.type->ArrayElement(p, i), *op.elemClass, sel))
+            return false;
+
+    return a.left == 0;
+}
+
+static bool ProjectedTagged(BinaryDecoder& d, char* pclass, ClassTypeInfo& type, const Selection& sel)
+{
+    BinaryPlan& plan = GetBinaryPlan(type);
+    if (sel.all)
+        return BinaryDataToTagged(d, pclass, plan);
+
+    BinaryDecoder f = d;
+    if (!ProjectedSubDecoder(d, f))
+        return false;
+
+    while (f.left)
+    {
+        size_t field;
+        int wire;
+        if (!BinaryDataToTag(f, field, wire))
+            return false;
+
+        // Unknown, other type or not selected field
+        const Selection* fs = nullptr;
+        if (field < plan.fieldOps.size() && GetTaggedWireType(plan.fieldOps[field]) == wire)
+            fs = GetFieldSelection(sel, field);
+
+        bool ok;
+        if (!fs)
+            ok = SkipTaggedValue(f, wire);
+        else if (fs->all)
+            ok = BinaryDataToTaggedField(f, pclass, plan.fieldOps[field], wire);
+        else
+        {
+            const BinaryOp& op = plan.fieldOps[field];
+            if (wire == wire_object)
+                ok = ProjectedTagged(f, pclass + op.offset, *op.elemClass, *fs);
+            else
+                ok = ProjectedTaggedArray(f, pclass + op.offset, op, *fs);
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+static bool ProjectedToNode(BinaryDecoder& d, char* pclass, const BinaryProjection& projection)
+{
+    ClassTypeInfo& type = projection.GetType();
+    StringDictionary dict;
+
+    if (d.format & binary_dictionary)
+    {
+        if (!BinaryDataToDictionary(d, dict))
+            return false;
+        d.dict = &dict;
+    }
+
+    if (d.format & binary_tagged)
+        return ProjectedTagged(d, pclass, type, projection.GetSelection());
+
+    if ((d.format & binary_schema) && !SkipSchemaHeader(d, type))
+        return false;
+
+    return ProjectedToClass(d, pclass, type, projection.GetSelection());
+}
+
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, const BinaryProjection& projection, int format)
+{
+    try {
+        BinaryDecoder d = { (const char*)buf, len, format };
+        if (!(format & binary_compressed))
+            return ProjectedToNode(d, (char*)pclass, projection);
+
+        std::string data;
+        if (!DecompressChunks(d.buf, d.left, [&](const char* p, size_t size) { data.append(p, size); return true; }))
+            return false;
+
+        BinaryDecoder dd = { data.data(), data.size(), format & ~binary_compressed };
+        return ProjectedToNode(dd, (char*)pclass, projection);
+    } catch (std::bad_alloc&) {
+        // Either out of memory or incorrectly decoded buffer
+        return false;
+    } catch (std::length_error&) {
+        // Incorrectly decoded length exceeding max_size()
+        return false;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "cppreflect.h"
+#include <memory>                           //unique_ptr
+
+//
+//  Set of fields to decode from binary buffer. Field is selected by path of field names separated by '.', path may
+//  go through nested classes and arrays of classes - for example "people.age" selects age of each element of people
+//  array. Selecting class or array field selects it whole.
+//
+//  Usage:
+//
+//      BinaryProjection proj(People::GetType());
+//      proj.Select("people.age");
+//      proj.Select("people.gender");
+//      parse_from_buffer(buf, len, &ppl, proj);
+//
+class BinaryProjection
+{
+public:
+    explicit BinaryProjection(ClassTypeInfo& type): type(&type)
+    {
+    }
+
+    //
+    //  Selects field, returns false if path does not resolve to field of type.
+    //
+    bool Select(const char* path);
+
+    ClassTypeInfo& GetType() const
+    {
+        return *type;
+    }
+
+    //
+    //  Selected fields of class instance.
+    //
+    struct Selection
+    {
+        bool all = false;                                   // Whole instance (or field) is selected
+        std::vector<std::unique_ptr<Selection>> fields;     // By ClassTypeInfo::fields index, nullptr - not selected
+    };
+
+    const Selection& GetSelection() const
+    {
+        return root;
+    }
+
+protected:
+    ClassTypeInfo* type;
+    Selection root;
+};
+
+//
+//  Decodes only fields selected by projection. Other fields are skipped by their length prefixes without being
+//  decoded and keep their values, arrays of classes on selected paths are resized to decoded element count.
+//  binary_schema data is supported only if it has the same schema as projection type.
+//
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, const BinaryProjection& projection, int format = binary_native);
@@ -0,0 +1,718 @@
+#include "binaryplan.h"                     //BinaryPlan
+#include <string.h>                         //strlen
+
+//
+//  Wire type of value in schema description.
+//
+enum SchemaKind
+{
+    schema_fixed,           // Fixed size value, followed by size and type name
+    schema_string,
+    schema_wstring,
+    schema_blob,            // Followed by type name
+    schema_class,           // Nested class, followed by class index
+    schema_array,           // Array, followed by element kind (and size / class index)
+    schema_kind_count
+};
+
+//
+//  Value description, decoded from schema.
+//
+struct SchemaValue
+{
+    int kind;
+    int elemKind;           // schema_array: element kind
+    size_t size;            // schema_fixed: value size, array of schema_fixed: element size
+    size_t cls;             // schema_class or array of schema_class: class index
+    std::string typeName;   // schema_fixed, schema_blob (or array of them): value type
+};
+
+struct SchemaField
+{
+    std::string name;
+    SchemaValue value;
+};
+
+struct SchemaClass
+{
+    std::vector<SchemaField> fields;
+    bool fixed;             // Instance encoded size is constant (no offset table for arrays)
+    bool empty;             // Instance is encoded using 0 bytes
+    int state;              // Validation state: 0 - not visited, 1 - being visited, 2 - done
+};
+
+//
+//  Maps field of other schema to field of local class.
+//
+struct SchemaFieldMap
+{
+    const SchemaValue* value;
+    const BinaryOp* op;     // Local field, nullptr if field is skipped
+    size_t sub;             // Class or class array: mapping of element class
+};
+
+//
+//  Mapping of data encoded using other schema version to local classes.
+//
+class BinarySchemaMapping
+{
+public:
+    // Schema description mapping was built from, fingerprint alone does not identify schema.
+    std::string schema;
+    std::vector<SchemaClass> classes;
+
+    // Mapping per (schema class, local class) pair, first one is top level class.
+    std::vector<std::vector<SchemaFieldMap>> maps;
+    std::map<std::pair<size_t, ClassTypeInfo*>, size_t> mapIndex;
+};
+
+// Maximum amount of schema versions remembered per class
+static const size_t maxSchemaMappings = 64;
+
+//
+//  Gets name identifying value type in schema, so that value of same size but other type (int and float, enum
+//  and int) is not decoded as local field. Compiler specific "enum " / "class " prefix is removed.
+//
+static std::string GetSchemaTypeName(BasicTypeInfo* type)
+{
+    std::string name = type->name();
+    for (const char* prefix : { "enum ", "class ", "struct " })
+    {
+        size_t l = strlen(prefix);
+        if (name.compare(0, l, prefix) == 0)
+            return name.substr(l);
+    }
+
+    return name;
+}
+
+static void ValueToSchema(BinaryWriter& w, int kind, size_t size, BasicTypeInfo* type, ClassTypeInfo* cls,
+    std::map<ClassTypeInfo*, size_t>& index)
+{
+    char k = (char)kind;
+    w.Write(&k, 1);
+
+    if (kind == schema_fixed)
+        VarintToBinaryData(w, size);
+    else if (kind == schema_class)
+        VarintToBinaryData(w, index[cls]);
+
+    if (kind == schema_fixed || kind == schema_blob)
+    {
+        std::string name = GetSchemaTypeName(type);
+        VarintToBinaryData(w, name.length());
+        w.Write(name.data(), name.length());
+    }
+}
+
+static int OpSchemaKind(BinaryOpKind kind)
+{
+    switch (kind)
+    {
+        case binop_copy:    return schema_fixed;
+        case binop_string:  return schema_string;
+        case binop_wstring: return schema_wstring;
+        case binop_class:   return schema_class;
+        case binop_array:   return schema_array;
+        default:            return schema_blob;
+    }
+}
+
+static int ElemSchemaKind(BinaryElemKind kind)
+{
+    switch (kind)
+    {
+        case binelem_pod:       return schema_fixed;
+        case binelem_string:    return schema_string;
+        case binelem_wstring:   return schema_wstring;
+        case binelem_class:     return schema_class;
+        default:                return schema_blob;
+    }
+}
+
+//
+//  Lists classes reachable from type, type itself gets index 0.
+//
+static void CollectSchemaClasses(ClassTypeInfo& type, std::vector<ClassTypeInfo*>& classes, std::map<ClassTypeInfo*, size_t>& index)
+{
+    if (index.count(&type))
+        return;
+
+    index[&type] = classes.size();
+    classes.push_back(&type);
+
+    for (const BinaryOp& op : GetBinaryPlan(type).fieldOps)
+        if (op.elemClass)
+            CollectSchemaClasses(*op.elemClass, classes, index);
+}
+
+//
+//  Schema description (all integers are varints):
+//
+//      class count, for each class: field count, for each field: name length, name, value kind, kind specific data
+//      (fixed value: size, class: class index, array: element kind and its data), type name length and type name
+//      of fixed and blob values
+//
+static void BuildSchema(ClassTypeInfo& type, BinaryPlan& plan)
+{
+    std::vector<ClassTypeInfo*> classes;
+    std::map<ClassTypeInfo*, size_t> index;
+    CollectSchemaClasses(type, classes, index);
+
+    BinaryBufferWriter w(plan.schema);
+    VarintToBinaryData(w, classes.size());
+
+    for (ClassTypeInfo* cls : classes)
+    {
+        BinaryPlan& clsPlan = GetBinaryPlan(*cls);
+        VarintToBinaryData(w, cls->fields.size());
+
+        for (size_t i = 0; i < cls->fields.size(); i++)
+        {
+            const std::string& name = cls->fields[i].name;
+            const BinaryOp& op = clsPlan.fieldOps[i];
+            VarintToBinaryData(w, name.length());
+            w.Write(name.data(), name.length());
+
+            int kind = OpSchemaKind(op.kind);
+            if (kind == schema_array)
+            {
+                char k = (char)kind;
+                w.Write(&k, 1);
+                ValueToSchema(w, ElemSchemaKind(op.elemKind), op.size, op.elemType, op.elemClass, index);
+            }
+            else
+            {
+                ValueToSchema(w, kind, op.size, op.type, op.elemClass, index);
+            }
+        }
+    }
+
+    w.Finish();
+
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    for (char c : plan.schema)
+        h = (h ^ (unsigned char)c) * 1099511628211ull;
+    plan.fingerprint = h;
+}
+
+BinaryPlan& GetSchemaPlan(ClassTypeInfo& type)
+{
+    BinaryPlan& plan = GetBinaryPlan(type);
+    std::call_once(plan.schemaOnce, [&]() { BuildSchema(type, plan); });
+    return plan;
+}
+
+uint64_t GetSchemaFingerprint(ClassTypeInfo& type)
+{
+    return GetSchemaPlan(type).fingerprint;
+}
+
+void SchemaToBinaryData(BinaryEncoder& e, ClassTypeInfo& type)
+{
+    BinaryPlan& plan = GetSchemaPlan(type);
+    uint64_t fingerprint = (e.format & binary_portable) ? LittleEndian64(plan.fingerprint) : plan.fingerprint;
+    e.w.Write(&fingerprint, sizeof(fingerprint));
+    lengthToBinaryData(e, plan.schema.size());
+    e.w.Write(plan.schema.data(), plan.schema.size());
+}
+
+static bool BinaryDataToSchemaSize(BinaryDecoder& d, size_t& v)
+{
+    uint64_t v64;
+    if (!BinaryDataToVarint(d, v64) || v64 > SIZE_MAX)
+        return false;
+
+    v = (size_t)v64;
+    return true;
+}
+
+static bool BinaryDataToSchemaValue(BinaryDecoder& d, SchemaValue& v, bool elem)
+{
+    if (!d.left)
+        return false;
+
+    int kind = (unsigned char)*d.buf;
+    d.buf++;
+    d.left--;
+
+    if (kind >= schema_kind_count || (elem && kind == schema_array))
+        return false;
+
+    if (kind == schema_array)
+    {
+        SchemaValue ev;
+        if (!BinaryDataToSchemaValue(d, ev, true))
+            return false;
+
+        v = ev;
+        v.elemKind = ev.kind;
+        v.kind = schema_array;
+        return true;
+    }
+
+    v.kind = kind;
+    v.elemKind = 0;
+    v.size = 0;
+    v.cls = 0;
+    v.typeName.clear();
+
+    if (kind == schema_fixed && (!BinaryDataToSchemaSize(d, v.size) || v.size == 0))
+        return false;
+
+    if (kind == schema_class)
+        return BinaryDataToSchemaSize(d, v.cls);
+
+    if (kind == schema_fixed || kind == schema_blob)
+    {
+        size_t l;
+        if (!BinaryDataToSchemaSize(d, l) || l > d.left)
+            return false;
+
+        v.typeName.assign(d.buf, l);
+        d.buf += l;
+        d.left -= l;
+    }
+
+    return true;
+}
+
+//
+//  Computes fixed / empty flags of class, returns false if schema has nested classes including themselves.
+//
+static bool ValidateSchemaClass(std::vector<SchemaClass>& classes, size_t i)
+{
+    SchemaClass& c = classes[i];
+    if (c.state == 1)
+        return false;
+
+    if (c.state == 2)
+        return true;
+
+    c.state = 1;
+    c.fixed = true;
+    c.empty = true;
+
+    for (SchemaField& f : c.fields)
+    {
+        const SchemaValue& v = f.value;
+        bool hasClass = v.kind == schema_class || (v.kind == schema_array && v.elemKind == schema_class);
+        if (hasClass && v.cls >= classes.size())
+            return false;
+
+        if (v.kind == schema_class)
+        {
+            if (!ValidateSchemaClass(classes, v.cls))
+                return false;
+
+            c.fixed = c.fixed && classes[v.cls].fixed;
+            c.empty = c.empty && classes[v.cls].empty;
+            continue;
+        }
+
+        c.empty = false;
+        if (v.kind != schema_fixed)
+            c.fixed = false;
+    }
+
+    c.state = 2;
+    return true;
+}
+
+static bool ParseSchema(const char* schema, size_t size, std::vector<SchemaClass>& classes)
+{
+    BinaryDecoder d = { schema, size, binary_varint };
+    size_t count;
+
+    // Each class / field takes at least one byte
+    if (!BinaryDataToSchemaSize(d, count) || count == 0 || count > d.left)
+        return false;
+
+    classes.resize(count);
+    for (SchemaClass& c : classes)
+    {
+        size_t fields;
+        if (!BinaryDataToSchemaSize(d, fields) || fields > d.left)
+            return false;
+
+        c.state = 0;
+        c.fields.resize(fields);
+        for (SchemaField& f : c.fields)
+        {
+            size_t l;
+            if (!BinaryDataToSchemaSize(d, l) || l > d.left)
+                return false;
+
+            f.name.assign(d.buf, l);
+            d.buf += l;
+            d.left -= l;
+
+            if (!BinaryDataToSchemaValue(d, f.value, false))
+                return false;
+        }
+    }
+
+    if (d.left != 0)
+        return false;
+
+    for (size_t i = 0; i < classes.size(); i++)
+        if (!ValidateSchemaClass(classes, i))
+            return false;
+
+    return true;
+}
+
+//
+//  true if local field can be decoded from value of other schema. Fixed size and blob values must be of same type,
+//  value of other type is never reinterpreted.
+//
+static bool IsSchemaCompatible(const SchemaValue& v, const BinaryOp& op)
+{
+    int kind = OpSchemaKind(op.kind);
+    if (kind != v.kind)
+        return false;
+
+    BasicTypeInfo* type = op.type;
+    if (kind == schema_array)
+    {
+        kind = ElemSchemaKind(op.elemKind);
+        if (kind != v.elemKind)
+            return false;
+
+        type = op.elemType;
+    }
+
+    if (kind == schema_fixed && v.size != op.size)
+        return false;
+
+    return (kind != schema_fixed && kind != schema_blob) || v.typeName == GetSchemaTypeName(type);
+}
+
+static size_t BuildSchemaMap(BinarySchemaMapping& m, size_t cls, ClassTypeInfo& type)
+{
+    auto it = m.mapIndex.find(std::make_pair(cls, &type));
+    if (it != m.mapIndex.end())
+        return it->second;
+
+    size_t mi = m.maps.size();
+    m.mapIndex[std::make_pair(cls, &type)] = mi;
+    m.maps.emplace_back();
+
+    BinaryPlan& plan = GetBinaryPlan(type);
+    std::vector<SchemaFieldMap> fields;
+
+    for (const SchemaField& f : m.classes[cls].fields)
+    {
+        SchemaFieldMap fm = { &f.value, nullptr, 0 };
+        int i = type.GetFieldIndex(f.name.c_str());
+
+        if (i >= 0 && IsSchemaCompatible(f.value, plan.fieldOps[i]))
+        {
+            fm.op = &plan.fieldOps[i];
+            if (f.value.kind == schema_class || f.value.elemKind == schema_class)
+                fm.sub = BuildSchemaMap(m, f.value.cls, *fm.op->elemClass);
+        }
+
+        fields.push_back(fm);
+    }
+
+    m.maps[mi] = std::move(fields);
+    return mi;
+}
+
+//
+//  Gets mapping of other schema to type, cached per fingerprint. Returns nullptr if schema is malformed.
+//
+static std::shared_ptr<BinarySchemaMapping> GetSchemaMapping(BinaryPlan& plan, ClassTypeInfo& type, uint64_t fingerprint,
+    const char* schema, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(plan.mappingsLock);
+        auto it = plan.mappings.find(fingerprint);
+        if (it != plan.mappings.end() && it->second->schema == std::string_view(schema, size))
+            return it->second;
+    }
+
+    // Fingerprint is only checked for consistency - schemas with colliding fingerprints are told apart by
+    // comparing schema description, mapping of other schema is never returned from cache.
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ (unsigned char)schema[i]) * 1099511628211ull;
+
+    auto m = std::make_shared<BinarySchemaMapping>();
+    if (h != fingerprint || !ParseSchema(schema, size, m->classes))
+        return nullptr;
+
+    m->schema.assign(schema, size);
+    BuildSchemaMap(*m, 0, type);
+
+    // Colliding schema is not cached, first one keeps its entry
+    std::lock_guard<std::mutex> lock(plan.mappingsLock);
+    if (plan.mappings.size() < maxSchemaMappings)
+        plan.mappings.emplace(fingerprint, m);
+
+    return m;
+}
+
+static inline bool SkipSchemaBytes(BinaryDecoder& d, size_t size)
+{
+    if (d.left < size)
+        return false;
+
+    d.buf += size;
+    d.left -= size;
+    return true;
+}
+
+static bool SkipSchemaClass(BinaryDecoder& d, const std::vector<SchemaClass>& classes, size_t cls);
+static bool SkipSchemaColumns(BinaryDecoder& d, const std::vector<SchemaClass>& classes, size_t cls, size_t count);
+
+static bool SkipSchemaValue(BinaryDecoder& d, const std::vector<SchemaClass>& classes, const SchemaValue& v)
+{
+    size_t l;
+    std::string_view s;
+
+    switch (v.kind)
+    {
+        case schema_fixed:
+            return SkipSchemaBytes(d, v.size);
+
+        case schema_class:
+            return SkipSchemaClass(d, classes, v.cls);
+
+        case schema_array:
+            break;
+
+        case schema_string:
+            return d.dict ? BinaryDataToStringView(d, s) : BinaryDataToLength(d, l) && SkipSchemaBytes(d, l);
+
+        default:
+            return BinaryDataToLength(d, l) && SkipSchemaBytes(d, l);
+    }
+
+    size_t count;
+    if (!BinaryDataToLength(d, count))
+        return false;
+
+    switch (v.elemKind)
+    {
+        case schema_fixed:
+            if (IsPackedElement(d.format, v.size))
+                return SkipPacked(d, count, v.size);
+
+            return count <= d.left / v.size && SkipSchemaBytes(d, count * v.size);
+
+        case schema_class:
+        {
+            const SchemaClass& c = classes[v.cls];
+            if (c.empty || count == 0)
+                return true;
+
+            if (d.format & binary_columnar)
+                return SkipSchemaColumns(d, classes, v.cls, count);
+
+            if ((d.format & binary_offsets) && !c.fixed)
+                return BinaryDataToOffsetTable(d, count, nullptr, l) && SkipSchemaBytes(d, l);
+
+            for (size_t i = 0; i < count; i++)
+                if (!SkipSchemaClass(d, classes, v.cls))
+                    return false;
+            return true;
+        }
+
+        case schema_string:
+            if (!d.dict)
+                break;
+
+            for (size_t i = 0; i < count; i++)
+                if (!BinaryDataToStringView(d, s))
+                    return false;
+            return true;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        if (!BinaryDataToLength(d, l) || !SkipSchemaBytes(d, l))
+            return false;
+
+    return true;
+}
+
+static bool SkipSchemaClass(BinaryDecoder& d, const std::vector<SchemaClass>& classes, size_t cls)
+{
+    for (const SchemaField& f : classes[cls].fields)
+        if (!SkipSchemaValue(d, classes, f.value))
+            return false;
+
+    return true;
+}
+
+//
+//  Skips column of count values (binary_columnar), nested class value is one column per its field.
+//
+static bool SkipSchemaColumn(BinaryDecoder& d, const std::vector<SchemaClass>& classes, const SchemaValue& v, size_t count)
+{
+    if (v.kind == schema_class)
+        return SkipSchemaColumns(d, classes, v.cls, count);
+
+    if (v.kind == schema_fixed)
+        return count <= d.left / v.size && SkipSchemaBytes(d, count * v.size);
+
+    for (size_t i = 0; i < count; i++)
+        if (!SkipSchemaValue(d, classes, v))
+            return false;
+
+    return true;
+}
+
+static bool SkipSchemaColumns(BinaryDecoder& d, const std::vector<SchemaClass>& classes, size_t cls, size_t count)
+{
+    for (const SchemaField& f : classes[cls].fields)
+        if (!SkipSchemaColumn(d, classes, f.value, count))
+            return false;
+
+    return true;
+}
+
+static bool SchemaDataToClass(BinaryDecoder& d, char* pclass, const BinarySchemaMapping& m, size_t mi);
+static bool SchemaDataToClassArray(BinaryDecoder& d, char* p, const BinarySchemaMapping& m, const SchemaFieldMap& fm);
+
+//
+//  Decodes columns of count class instances (stride bytes apart) encoded using other schema (binary_columnar).
+//
+static bool SchemaColumnsToClasses(BinaryDecoder& d, char* p, size_t stride, size_t count, const BinarySchemaMapping& m, size_t mi)
+{
+    for (const SchemaFieldMap& fm : m.maps[mi])
+    {
+        const SchemaValue& v = *fm.value;
+
+        if (!fm.op)
+        {
+            if (!SkipSchemaColumn(d, m.classes, v, count))
+                return false;
+            continue;
+        }
+
+        if (v.kind == schema_class)
+        {
+            BinaryNestingScope nested(d);
+            if (!nested.Allowed() || !SchemaColumnsToClasses(d, p + fm.op->offset, stride, count, m, fm.sub))
+                return false;
+            continue;
+        }
+
+        bool classArray = v.kind == schema_array && v.elemKind == schema_class;
+        for (size_t i = 0; i < count; i++)
+        {
+            char* pfield = p + i * stride + fm.op->offset;
+            if (!(classArray ? SchemaDataToClassArray(d, pfield, m, fm) : BinaryDataToValue(d, pfield, *fm.op)))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool SchemaDataToClassArray(BinaryDecoder& d, char* p, const BinarySchemaMapping& m, const SchemaFieldMap& fm)
+{
+    size_t count, total;
+    if (!BinaryDataToLength(d, count))
+        return false;
+
+    const SchemaClass& c = m.classes[fm.value->cls];
+    if (!c.empty && count > d.left)
+        return false;
+
+    // Offset table is not needed for sequential decoding
+    bool columnar = (d.format & binary_columnar) != 0;
+    if (count && (d.format & binary_offsets) && !columnar && !c.fixed && !BinaryDataToOffsetTable(d, count, nullptr, total))
+        return false;
+
+    const BinaryOp& op = *fm.op;
+    BinaryNestingScope nested(d);
+    if (!nested.Allowed() || !ChargeBinaryArray(d, count, op.size))
+        return false;
+
+    op.type->SetArraySize(p, count);
+    if (count == 0)
+        return true;
+
+    char* pelem = (char*)op.type->ArrayElement(p, 0);
+    if (columnar)
+        return SchemaColumnsToClasses(d, pelem, op.size, count, m, fm.sub);
+
+    for (size_t i = 0; i < count; i++, pelem += op.size)
+        if (!SchemaDataToClass(d, pelem, m, fm.sub))
+            return false;
+
+    return true;
+}
+
+static bool SchemaDataToClass(BinaryDecoder& d, char* pclass, const BinarySchemaMapping& m, size_t mi)
+{
+    for (const SchemaFieldMap& fm : m.maps[mi])
+    {
+        const SchemaValue& v = *fm.value;
+        bool ok;
+
+        if (!fm.op)
+            ok = SkipSchemaValue(d, m.classes, v);
+        else if (v.kind == schema_class)
+        {
+            BinaryNestingScope nested(d);
+            ok = nested.Allowed() && SchemaDataToClass(d, pclass + fm.op->offset, m, fm.sub);
+        }
+        else if (v.kind == schema_array && v.elemKind == schema_class)
+            ok = SchemaDataToClassArray(d, pclass + fm.op->offset, m, fm);
+        else
+            ok = BinaryDataToValue(d, pclass + fm.op->offset, *fm.op);
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+//
+//  Reads schema header, schema receives embedded schema description.
+//
+static bool BinaryDataToSchemaHeader(BinaryDecoder& d, uint64_t& fingerprint, const char*& schema, size_t& size)
+{
+    if (!ReadBinaryData(d, &fingerprint, sizeof(fingerprint)) || !BinaryDataToLength(d, size) || d.left < size)
+        return false;
+
+    if (d.format & binary_portable)
+        fingerprint = LittleEndian64(fingerprint);
+
+    schema = d.buf;
+    d.buf += size;
+    d.left -= size;
+    return true;
+}
+
+bool BinaryDataToSchemaNode(BinaryDecoder& d, char* pclass, ClassTypeInfo& type)
+{
+    BinaryPlan& plan = GetSchemaPlan(type);
+    uint64_t fingerprint;
+    const char* schema;
+    size_t size;
+
+    if (!BinaryDataToSchemaHeader(d, fingerprint, schema, size))
+        return false;
+
+    if (fingerprint == plan.fingerprint)
+        return BinaryDataToPlan(d, pclass, plan);
+
+    std::shared_ptr<BinarySchemaMapping> m = GetSchemaMapping(plan, type, fingerprint, schema, size);
+    return m && SchemaDataToClass(d, pclass, *m, 0);
+}
+
+bool SkipSchemaHeader(BinaryDecoder& d, ClassTypeInfo& type)
+{
+    uint64_t fingerprint;
+    const char* schema;
+    size_t size;
+
+    return BinaryDataToSchemaHeader(d, fingerprint, schema, size) && fingerprint == GetSchemaPlan(type).fingerprint;
+}
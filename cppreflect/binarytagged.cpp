@@ -0,0 +1,292 @@
+#include "binaryplan.h"                     //BinaryPlan
+
+//
+//  Content sizes of length prefixed values (objects, arrays, dictionary references), in encoding order. Sizes are
+//  collected by counting pass over whole instance, so each value is encoded twice regardless of nesting depth.
+//
+struct TaggedLengths
+{
+    std::vector<size_t> sizes;
+    size_t next = 0;                        // Index of next size used by writing pass
+    bool counting = true;
+};
+
+//
+//  Writes content produced by encode(e) prefixed with its length. Counting pass records content size, writing pass
+//  uses recorded size.
+//
+template <class F>
+static void LengthPrefixedToBinaryData(BinaryEncoder& e, TaggedLengths& lengths, F encode)
+{
+    if (!lengths.counting)
+    {
+        lengthToBinaryData(e, lengths.sizes[lengths.next++]);
+        encode(e);
+        return;
+    }
+
+    size_t i = lengths.sizes.size();
+    lengths.sizes.push_back(0);
+    size_t start = e.w.Size();
+    encode(e);
+    lengths.sizes[i] = e.w.Size() - start;
+
+    // Prefix is counted after content, total is the same
+    lengthToBinaryData(e, lengths.sizes[i]);
+}
+
+static inline void TagToBinaryData(BinaryEncoder& e, size_t field, int wire)
+{
+    VarintToBinaryData(e.w, ((uint64_t)field << 3) | (uint64_t)wire);
+}
+
+TaggedWireType GetTaggedWireType(const BinaryOp& op)
+{
+    switch (op.kind)
+    {
+        case binop_copy:
+            switch (op.size)
+            {
+                case 1:     return wire_fixed1;
+                case 2:     return wire_fixed2;
+                case 4:     return wire_fixed4;
+                case 8:     return wire_fixed8;
+                default:    return wire_bytes;
+            }
+
+        case binop_class:
+            return wire_object;
+
+        case binop_array:
+            return wire_array;
+
+        default:
+            return wire_bytes;
+    }
+}
+
+static void TaggedObjectToBinaryData(BinaryEncoder& e, const char* pclass, BinaryPlan& plan, TaggedLengths& lengths);
+
+static void TaggedFieldsToBinaryData(BinaryEncoder& e, const char* pclass, BinaryPlan& plan, TaggedLengths& lengths)
+{
+    for (size_t i = 0; i < plan.fieldOps.size(); i++)
+    {
+        const BinaryOp& op = plan.fieldOps[i];
+        const char* p = pclass + op.offset;
+        TaggedWireType wire = GetTaggedWireType(op);
+        TagToBinaryData(e, i, wire);
+
+        switch (wire)
+        {
+            case wire_object:
+                TaggedObjectToBinaryData(e, p, GetBinaryPlan(*op.elemClass), lengths);
+                break;
+
+            case wire_array:
+                LengthPrefixedToBinaryData(e, lengths, [&](BinaryEncoder& ae)
+                {
+                    if (op.elemKind != binelem_class)
+                    {
+                        ValueToBinaryData(ae, p, op);
+                        return;
+                    }
+
+                    size_t count = op.type->ArraySize((void*)p);
+                    lengthToBinaryData(ae, count);
+
+                    BinaryPlan& elemPlan = GetBinaryPlan(*op.elemClass);
+                    for (size_t j = 0; j < count; j++)
+                        TaggedObjectToBinaryData(ae, (const char*)op.type->ArrayElement((void*)p, j), elemPlan, lengths);
+                });
+                break;
+
+            case wire_bytes:
+                // Fixed size value of unusual size
+                if (op.kind == binop_copy)
+                    lengthToBinaryData(e, op.size);
+
+                // Dictionary reference is not length prefixed on its own
+                if (op.kind == binop_string && e.dict)
+                {
+                    LengthPrefixedToBinaryData(e, lengths, [&](BinaryEncoder& se) { ValueToBinaryData(se, p, op); });
+                    break;
+                }
+
+                ValueToBinaryData(e, p, op);
+                break;
+
+            default:
+                ValueToBinaryData(e, p, op);
+                break;
+        }
+    }
+}
+
+static void TaggedObjectToBinaryData(BinaryEncoder& e, const char* pclass, BinaryPlan& plan, TaggedLengths& lengths)
+{
+    LengthPrefixedToBinaryData(e, lengths, [&](BinaryEncoder& fe) { TaggedFieldsToBinaryData(fe, pclass, plan, lengths); });
+}
+
+void TaggedToBinaryData(BinaryEncoder& e, const char* pclass, BinaryPlan& plan)
+{
+    TaggedLengths lengths;
+    BinaryCountWriter cw;
+    BinaryEncoder ce = { cw, e.format, 0, e.dict };
+    TaggedObjectToBinaryData(ce, pclass, plan, lengths);
+
+    lengths.counting = false;
+    TaggedObjectToBinaryData(e, pclass, plan, lengths);
+}
+
+bool BinaryDataToTag(BinaryDecoder& d, size_t& field, int& wire)
+{
+    uint64_t tag;
+    if (!BinaryDataToVarint(d, tag) || (tag >> 3) > SIZE_MAX)
+        return false;
+
+    field = (size_t)(tag >> 3);
+    wire = (int)(tag & 7);
+    return true;
+}
+
+//
+//  Splits length prefixed value from d into sub decoder.
+//
+static inline bool BinaryDataToSubDecoder(BinaryDecoder& d, BinaryDecoder& sub)
+{
+    size_t l;
+    if (!BinaryDataToLength(d, l) || d.left < l)
+        return false;
+
+    sub.buf = d.buf;
+    sub.left = l;
+    sub.format = d.format;
+    sub.dict = d.dict;
+    sub.limits = d.limits;
+    sub.depth = d.depth;
+    d.buf += l;
+    d.left -= l;
+    return true;
+}
+
+bool SkipTaggedValue(BinaryDecoder& d, int wire)
+{
+    size_t size;
+
+    switch (wire)
+    {
+        case wire_fixed1:   size = 1;   break;
+        case wire_fixed2:   size = 2;   break;
+        case wire_fixed4:   size = 4;   break;
+        case wire_fixed8:   size = 8;   break;
+
+        case wire_bytes:
+        case wire_object:
+        case wire_array:
+        {
+            BinaryDecoder sub = { nullptr, 0, 0 };
+            return BinaryDataToSubDecoder(d, sub);
+        }
+
+        default:
+            return false;
+    }
+
+    if (d.left < size)
+        return false;
+
+    d.buf += size;
+    d.left -= size;
+    return true;
+}
+
+static bool BinaryDataToTaggedArray(BinaryDecoder& d, char* p, const BinaryOp& op)
+{
+    BinaryDecoder a = { nullptr, 0, 0 };
+    if (!BinaryDataToSubDecoder(d, a))
+        return false;
+
+    if (op.elemKind != binelem_class)
+        return BinaryDataToValue(a, p, op) && a.left == 0;
+
+    // Each element takes at least one byte (its length)
+    size_t count;
+    if (!BinaryDataToLength(a, count) || count > a.left)
+        return false;
+
+    BinaryNestingScope nested(a);
+    if (!nested.Allowed() || !ChargeBinaryArray(a, count, op.size))
+        return false;
+
+    op.type->SetArraySize(p, count);
+    BinaryPlan& elemPlan = GetBinaryPlan(*op.elemClass);
+
+    for (size_t i = 0; i < count; i++)
+        if (!BinaryDataToTagged(a, (char*)op.type->ArrayElement(p, i), elemPlan))
+            return false;
+
+    return a.left == 0;
+}
+
+bool BinaryDataToTaggedField(BinaryDecoder& f, char* pclass, const BinaryOp& op, int wire)
+{
+    char* p = pclass + op.offset;
+
+    switch (wire)
+    {
+        case wire_object:
+        {
+            BinaryNestingScope nested(f);
+            return nested.Allowed() && BinaryDataToTagged(f, p, GetBinaryPlan(*op.elemClass));
+        }
+
+        case wire_array:
+            return BinaryDataToTaggedArray(f, p, op);
+
+        case wire_bytes:
+            if (op.kind == binop_copy)
+            {
+                size_t l;
+                return BinaryDataToLength(f, l) && l == op.size && ReadBinaryData(f, p, l);
+            }
+
+            if (op.kind == binop_string && f.dict)
+            {
+                BinaryDecoder s = { nullptr, 0, 0 };
+                return BinaryDataToSubDecoder(f, s) && BinaryDataToValue(s, p, op) && s.left == 0;
+            }
+
+            return BinaryDataToValue(f, p, op);
+
+        default:
+            return BinaryDataToValue(f, p, op);
+    }
+}
+
+bool BinaryDataToTagged(BinaryDecoder& d, char* pclass, BinaryPlan& plan)
+{
+    BinaryDecoder f = { nullptr, 0, 0 };
+    if (!BinaryDataToSubDecoder(d, f))
+        return false;
+
+    while (f.left)
+    {
+        size_t field;
+        int wire;
+        if (!BinaryDataToTag(f, field, wire))
+            return false;
+
+        // Unknown field or field of different type
+        if (field >= plan.fieldOps.size() || GetTaggedWireType(plan.fieldOps[field]) != wire)
+        {
+            if (!SkipTaggedValue(f, wire))
+                return false;
+            continue;
+        }
+
+        if (!BinaryDataToTaggedField(f, pclass, plan.fieldOps[field], wire))
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,299 @@
+#include "binaryplan.h"                     //BinaryPlan
+
+// Formats supported by validation pass and unchecked decoding.
+static const int uncheckedFormats = binary_varint | binary_portable | binary_offsets;
+
+static inline void AddAllocation(BinaryBudget& b, size_t bytes)
+{
+    if (bytes)
+    {
+        b.allocations++;
+        b.bytes += bytes;
+    }
+}
+
+static inline bool SkipValidated(BinaryDecoder& d, size_t size)
+{
+    if (d.left < size)
+        return false;
+
+    d.buf += size;
+    d.left -= size;
+    return true;
+}
+
+//
+//  Validates length prefixed string, wstring or blob.
+//
+static bool ValidateVariable(BinaryDecoder& d, int elemKind, BinaryBudget& b)
+{
+    size_t l;
+    if (!BinaryDataToLength(d, l) || d.left < l)
+        return false;
+
+    if (elemKind == binelem_wstring)
+    {
+        // Portable std::wstring is UTF-8
+        size_t length = l / sizeof(wchar_t);
+        if (d.format & binary_portable)
+        {
+            if (!Utf8ToWStringLength(d.buf, l, length))
+                return false;
+        }
+        else if (l % sizeof(wchar_t) != 0)
+        {
+            return false;
+        }
+
+        AddAllocation(b, length * sizeof(wchar_t));
+    }
+    else
+    {
+        AddAllocation(b, l);
+    }
+
+    return SkipValidated(d, l);
+}
+
+static bool ValidatePlan(BinaryDecoder& d, BinaryPlan& plan, BinaryBudget& b);
+
+static bool ValidateArray(BinaryDecoder& d, const BinaryOp& op, BinaryBudget& b)
+{
+    size_t count;
+    if (!BinaryDataToLength(d, count))
+        return false;
+
+    if (count == 0)
+        return true;
+
+    // Fixed size elements are validated by single comparison
+    if (op.elemKind == binelem_pod)
+    {
+        if (count > d.left / op.size)
+            return false;
+
+        AddAllocation(b, count * op.size);
+        return SkipValidated(d, count * op.size);
+    }
+
+    if (op.elemKind != binelem_class)
+    {
+        // Each element takes at least one byte
+        if (count > d.left)
+            return false;
+
+        AddAllocation(b, count * op.size);
+        for (size_t i = 0; i < count; i++)
+            if (!ValidateVariable(d, op.elemKind, b))
+                return false;
+        return true;
+    }
+
+    BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+    if ((!plan.ops.empty() && count > d.left) || count > SIZE_MAX / op.size)
+        return false;
+
+    AddAllocation(b, count * op.size);
+
+    bool table = HasOffsetTable(d.format, op);
+    size_t total = 0;
+    if (table && !BinaryDataToOffsetTable(d, count, nullptr, total))
+        return false;
+
+    size_t left = d.left;
+    for (size_t i = 0; i < count; i++)
+        if (!ValidatePlan(d, plan, b))
+            return false;
+
+    return !table || left - d.left == total;
+}
+
+static bool ValidatePlan(BinaryDecoder& d, BinaryPlan& plan, BinaryBudget& b)
+{
+    for (const BinaryOp& op : plan.ops)
+    {
+        bool ok;
+
+        switch (op.kind)
+        {
+            case binop_copy:    ok = SkipValidated(d, op.size); break;
+            case binop_string:  ok = ValidateVariable(d, binelem_string, b); break;
+            case binop_wstring: ok = ValidateVariable(d, binelem_wstring, b); break;
+            case binop_blob:    ok = ValidateVariable(d, binelem_blob, b); break;
+            case binop_array:   ok = ValidateArray(d, op, b); break;
+            case binop_class:   ok = ValidatePlan(d, GetBinaryPlan(*op.elemClass), b); break;
+            default:            ok = false; break;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+bool ValidateBinaryData(const void* buf, size_t len, ClassTypeInfo& type, int format, BinaryBudget* budget)
+{
+    if (format & ~uncheckedFormats)
+        return false;
+
+    BinaryBudget b;
+    BinaryDecoder d = { (const char*)buf, len, format };
+    if (!ValidatePlan(d, GetBinaryPlan(type), b))
+        return false;
+
+    b.size = len - d.left;
+    if (budget)
+        *budget = b;
+
+    return true;
+}
+
+//
+//  Unchecked decoding - buffer was validated, so lengths are trusted and values are copied without bounds checks.
+//
+static inline size_t UncheckedLength(const char*& p, int format)
+{
+    if (format & binary_varint)
+    {
+        size_t r = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            unsigned char b = (unsigned char)*p++;
+            r |= (size_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return r;
+        }
+    }
+
+    if (format & binary_portable)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return (size_t)LittleEndian64(v);
+    }
+
+    size_t l;
+    memcpy(&l, p, sizeof(l));
+    p += sizeof(l);
+    return l;
+}
+
+static inline bool UncheckedToVariable(const char*& p, char* pfield, int elemKind, BasicTypeInfo* type, int format)
+{
+    size_t l = UncheckedLength(p, format);
+    const char* data = p;
+    p += l;
+
+    switch (elemKind)
+    {
+        case binelem_string:
+            ((std::string*)pfield)->assign(data, l);
+            return true;
+
+        case binelem_wstring:
+        {
+            std::wstring& s = *(std::wstring*)pfield;
+            if (format & binary_portable)
+                return Utf8ToWString(data, l, s);
+
+            s.resize(l / sizeof(wchar_t));
+            if (l)
+                memcpy(&s[0], data, l);
+            return true;
+        }
+
+        default:
+            type->SetRawSize(pfield, l);
+            if (type->GetRawSize(pfield) != l)
+                return false;
+
+            if (l)
+                memcpy(type->GetRawPtr(pfield), data, l);
+            return true;
+    }
+}
+
+static bool UncheckedToPlan(const char*& p, char* pclass, BinaryPlan& plan, int format);
+
+static bool UncheckedToArray(const char*& p, char* pfield, const BinaryOp& op, int format)
+{
+    size_t count = UncheckedLength(p, format);
+    op.type->SetArraySize(pfield, count);
+    if (count == 0)
+        return true;
+
+    char* pelem = (char*)op.type->ArrayElement(pfield, 0);
+    char* pend = pelem + count * op.size;
+
+    switch (op.elemKind)
+    {
+        case binelem_pod:
+            memcpy(pelem, p, count * op.size);
+            if (NeedByteSwap(format) && op.unit > 1)
+                SwapBytes(pelem, pelem, count * op.size / op.unit, op.unit);
+
+            p += count * op.size;
+            return true;
+
+        case binelem_class:
+        {
+            // Offset table is not needed for sequential decoding
+            if (HasOffsetTable(format, op))
+                for (size_t i = OffsetTableBlocks(count); i; i--)
+                    UncheckedLength(p, format);
+
+            BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+            for (; pelem != pend; pelem += op.size)
+                if (!UncheckedToPlan(p, pelem, plan, format))
+                    return false;
+            return true;
+        }
+
+        default:
+            for (; pelem != pend; pelem += op.size)
+                if (!UncheckedToVariable(p, pelem, op.elemKind, op.elemType, format))
+                    return false;
+            return true;
+    }
+}
+
+static bool UncheckedToPlan(const char*& p, char* pclass, BinaryPlan& plan, int format)
+{
+    for (const BinaryOp& op : GetPlanOps(plan, format))
+    {
+        char* pfield = pclass + op.offset;
+        bool ok = true;
+
+        switch (op.kind)
+        {
+            case binop_copy:
+                memcpy(pfield, p, op.size);
+                if (NeedByteSwap(format) && op.unit > 1)
+                    SwapBytes(pfield, pfield, op.size / op.unit, op.unit);
+                p += op.size;
+                break;
+
+            case binop_string:  ok = UncheckedToVariable(p, pfield, binelem_string, op.type, format); break;
+            case binop_wstring: ok = UncheckedToVariable(p, pfield, binelem_wstring, op.type, format); break;
+            case binop_blob:    ok = UncheckedToVariable(p, pfield, binelem_blob, op.type, format); break;
+            case binop_array:   ok = UncheckedToArray(p, pfield, op, format); break;
+            case binop_class:   ok = UncheckedToPlan(p, pfield, GetBinaryPlan(*op.elemClass), format); break;
+        }
+
+        if (!ok)
+            return false;
+    }
+
+    return true;
+}
+
+bool parse_from_buffer_unchecked(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, int format)
+{
+    if (format & ~uncheckedFormats)
+        return parse_from_buffer(buf, len, pclass, type, format);
+
+    const char* p = (const char*)buf;
+    return UncheckedToPlan(p, (char*)pclass, GetBinaryPlan(type), format) && (size_t)(p - (const char*)buf) <= len;
+}
@@ -0,0 +1,425 @@
+#include "binaryview.h"
+#include "binaryplan.h"                     //BinaryPlan
+
+bool BinaryView::Parse(const void* buf, size_t len, ClassTypeInfo& _type, int _format, size_t* consumed)
+{
+    type = &_type;
+    format = _format & ~binary_schema;
+    fields.resize(GetBinaryPlan(_type).fieldOps.size());
+    dict.reset();
+
+    BinaryDecoder d = { (const char*)buf, len, format };
+
+    // Compressed data cannot be viewed in place
+    if (format & binary_compressed)
+        return false;
+
+    if (format & binary_dictionary)
+    {
+        auto strings = std::make_shared<StringDictionary>();
+        if (!BinaryDataToDictionary(d, *strings))
+            return false;
+
+        dict = strings;
+        d.dict = strings.get();
+    }
+
+    // Data of other schema version cannot be viewed in place
+    if (!(format & binary_tagged) && (_format & binary_schema) && !SkipSchemaHeader(d, _type))
+        return false;
+
+    if (!ParseInstance(d, _type))
+        return false;
+
+    if (consumed)
+        *consumed = len - d.left;
+
+    return true;
+}
+
+bool BinaryView::ParseNested(BinaryView& v, const char* p, size_t len, ClassTypeInfo& _type, size_t* consumed) const
+{
+    v.format = format;
+    v.dict = dict;
+
+    BinaryDecoder d = { p, len, format, 0, dict.get() };
+    if (!v.ParseInstance(d, _type))
+        return false;
+
+    if (consumed)
+        *consumed = len - d.left;
+
+    return true;
+}
+
+bool BinaryView::ParseInstance(BinaryDecoder& d, ClassTypeInfo& _type)
+{
+    type = &_type;
+    BinaryPlan& plan = GetBinaryPlan(_type);
+    fields.resize(plan.fieldOps.size());
+
+    if (format & binary_tagged)
+        return ParseTagged(d, plan);
+
+    return ParsePlain(d, plan);
+}
+
+//
+//  Records location of each field of positional class instance.
+//
+bool BinaryView::ParsePlain(BinaryDecoder& d, BinaryPlan& plan)
+{
+    for (size_t i = 0; i < plan.fieldOps.size(); i++)
+    {
+        const BinaryOp& op = plan.fieldOps[i];
+        Entry& e = fields[i];
+        e.count = 0;
+        e.packed = false;
+
+        switch (op.kind)
+        {
+            case binop_copy:
+            case binop_class:
+                e.p = d.buf;
+                if (!SkipBinaryValue(d, op))
+                    return false;
+                e.size = (size_t)(d.buf - e.p);
+                break;
+
+            case binop_array:
+                if (!BinaryDataToLength(d, e.count))
+                    return false;
+
+                if (e.count && HasOffsetTable(format, op))
+                {
+                    // Entry covers elements only, elements must end exactly where offset table says
+                    if (!BinaryDataToOffsetTable(d, e.count, nullptr, e.size))
+                        return false;
+
+                    e.p = d.buf;
+                    size_t left = d.left;
+                    BinaryPlan& elemPlan = GetBinaryPlan(*op.elemClass);
+                    for (size_t j = 0; j < e.count; j++)
+                        if (!SkipBinaryData(d, elemPlan))
+                            return false;
+
+                    if (left - d.left != e.size)
+                        return false;
+                    break;
+                }
+
+                e.p = d.buf;
+                if (!SkipBinaryElements(d, op, e.count))
+                    return false;
+                e.size = (size_t)(d.buf - e.p);
+                CheckPacked(e, op);
+                break;
+
+            case binop_string:
+            {
+                std::string_view s;
+                if (!BinaryDataToStringView(d, s))
+                    return false;
+
+                e.p = s.data();
+                e.size = s.length();
+                break;
+            }
+
+            default:
+                if (!BinaryDataToLength(d, e.size) || d.left < e.size)
+                    return false;
+
+                if (op.kind == binop_wstring && !(format & binary_portable) && e.size % sizeof(wchar_t) != 0)
+                    return false;
+
+                e.p = d.buf;
+                d.buf += e.size;
+                d.left -= e.size;
+                break;
+        }
+    }
+
+    return true;
+}
+
+//
+//  Records location of each field of tagged class instance, fields not present in data are left empty.
+//
+bool BinaryView::ParseTagged(BinaryDecoder& d, BinaryPlan& plan)
+{
+    size_t l;
+    if (!BinaryDataToLength(d, l) || d.left < l)
+        return false;
+
+    BinaryDecoder f = { d.buf, l, format, 0, d.dict };
+    d.buf += l;
+    d.left -= l;
+
+    Entry empty = { nullptr, 0, 0, false };
+    fields.assign(plan.fieldOps.size(), empty);
+
+    while (f.left)
+    {
+        size_t field;
+        int wire;
+        if (!BinaryDataToTag(f, field, wire))
+            return false;
+
+        if (field >= plan.fieldOps.size() || GetTaggedWireType(plan.fieldOps[field]) != wire)
+        {
+            if (!SkipTaggedValue(f, wire))
+                return false;
+            continue;
+        }
+
+        const BinaryOp& op = plan.fieldOps[field];
+        Entry& e = fields[field];
+        e.p = f.buf;
+
+        switch (wire)
+        {
+            case wire_object:
+                // Entry includes length, so nested instance can be parsed again
+                if (!SkipTaggedValue(f, wire))
+                    return false;
+                e.size = (size_t)(f.buf - e.p);
+                break;
+
+            case wire_array:
+            {
+                if (!BinaryDataToLength(f, l) || f.left < l)
+                    return false;
+
+                BinaryDecoder a = { f.buf, l, format, 0, d.dict };
+                f.buf += l;
+                f.left -= l;
+
+                if (!BinaryDataToLength(a, e.count))
+                    return false;
+
+                e.p = a.buf;
+                e.size = a.left;
+
+                if (op.elemKind != binelem_class)
+                {
+                    if (!SkipBinaryElements(a, op, e.count) || a.left != 0)
+                        return false;
+
+                    CheckPacked(e, op);
+                    break;
+                }
+
+                if (e.count > a.left)
+                    return false;
+
+                for (size_t i = 0; i < e.count; i++)
+                    if (!SkipTaggedValue(a, wire_object))
+                        return false;
+
+                if (a.left != 0)
+                    return false;
+                break;
+            }
+
+            case wire_bytes:
+                if (!BinaryDataToLength(f, e.size) || f.left < e.size)
+                    return false;
+
+                if ((op.kind == binop_copy && e.size != op.size) ||
+                    (op.kind == binop_wstring && !(format & binary_portable) && e.size % sizeof(wchar_t) != 0))
+                    return false;
+
+                e.p = f.buf;
+                f.buf += e.size;
+                f.left -= e.size;
+
+                if (op.kind == binop_string && d.dict)
+                {
+                    // Dictionary reference
+                    BinaryDecoder s = { e.p, e.size, format, 0, d.dict };
+                    std::string_view v;
+                    if (!BinaryDataToStringView(s, v) || s.left != 0)
+                        return false;
+
+                    e.p = v.data();
+                    e.size = v.length();
+                }
+                break;
+
+            default:
+                if (!SkipTaggedValue(f, wire))
+                    return false;
+                e.size = op.size;
+                break;
+        }
+    }
+
+    return true;
+}
+
+//
+//  Packed primitive array which was stored raw is viewed as regular array, otherwise entry is marked as packed.
+//
+void BinaryView::CheckPacked(Entry& e, const BinaryOp& op)
+{
+    if (!e.count || op.elemKind != binelem_pod || !IsPackedElement(format, op.size))
+        return;
+
+    if (*e.p == 0)
+    {
+        e.p++;
+        e.size--;
+        return;
+    }
+
+    e.packed = true;
+}
+
+bool BinaryView::GetValues(int field, void* dest, size_t size) const
+{
+    if (!IsField(field))
+        return false;
+
+    const Entry& e = fields[field];
+    const BinaryOp& op = GetBinaryPlan(*type).fieldOps[field];
+    if (op.kind != binop_array || op.elemKind != binelem_pod || op.size != size)
+        return false;
+
+    if (e.packed)
+    {
+        BinaryDecoder d = { e.p, e.size, format };
+        return BinaryDataToPacked(d, (char*)dest, e.count, size, op.unit);
+    }
+
+    if (e.count)
+        memcpy(dest, e.p, e.count * size);
+
+    if (NeedSwap() && op.unit > 1)
+        SwapBytes(dest, dest, e.count * size / op.unit, op.unit);
+
+    return true;
+}
+
+std::wstring BinaryView::GetWString(int field) const
+{
+    if (!IsField(field))
+        return std::wstring();
+
+    const Entry& e = fields[field];
+    if (format & binary_portable)
+    {
+        std::wstring s;
+        if (!Utf8ToWString(e.p, e.size, s))
+            s.clear();
+
+        return s;
+    }
+
+    std::wstring s(e.size / sizeof(wchar_t), 0);
+    if (s.length())
+        memcpy(&s[0], e.p, s.length() * sizeof(wchar_t));
+
+    return s;
+}
+
+std::vector<std::string_view> BinaryView::GetStrings(int field) const
+{
+    std::vector<std::string_view> strings;
+    if (!IsField(field))
+        return strings;
+
+    const BinaryOp& op = GetBinaryPlan(*type).fieldOps[field];
+    if (op.kind != binop_array || op.elemKind != binelem_string)
+        return strings;
+
+    const Entry& e = fields[field];
+    BinaryDecoder d = { e.p, e.size, format, 0, dict.get() };
+    strings.resize(e.count);
+
+    for (std::string_view& s : strings)
+        BinaryDataToStringView(d, s);       // Validated by Parse()
+
+    return strings;
+}
+
+BinaryView BinaryView::GetObject(int field) const
+{
+    BinaryView v;
+    if (!IsField(field))
+        return v;
+
+    const BinaryOp& op = GetBinaryPlan(*type).fieldOps[field];
+    if (op.kind == binop_class && !ParseNested(v, fields[field].p, fields[field].size, *op.elemClass, nullptr))
+        v = BinaryView();
+
+    return v;
+}
+
+std::vector<BinaryView> BinaryView::GetObjects(int field) const
+{
+    std::vector<BinaryView> views;
+    if (!IsField(field))
+        return views;
+
+    const BinaryOp& op = GetBinaryPlan(*type).fieldOps[field];
+    if (op.kind != binop_array || op.elemKind != binelem_class || IsColumnar())
+        return views;
+
+    const Entry& e = fields[field];
+    const char* p = e.p;
+    size_t left = e.size;
+    views.resize(e.count);
+
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        // Views parsed before malformed element are returned
+        size_t consumed;
+        if (!ParseNested(views[i], p, left, *op.elemClass, &consumed))
+        {
+            views.resize(i);
+            break;
+        }
+
+        p += consumed;
+        left -= consumed;
+    }
+
+    return views;
+}
+
+bool BinaryView::FindColumn(int field, int elemField, size_t size, const char*& p) const
+{
+    if (!IsField(field))
+        return false;
+
+    const BinaryOp& op = GetBinaryPlan(*type).fieldOps[field];
+    if (!IsColumnar() || op.kind != binop_array || op.elemKind != binelem_class)
+        return false;
+
+    BinaryPlan& plan = GetBinaryPlan(*op.elemClass);
+    if (elemField < 0 || (size_t)elemField >= plan.fieldOps.size())
+        return false;
+
+    const BinaryOp& column = plan.fieldOps[elemField];
+    if (column.kind != binop_copy || column.size != size)
+        return false;
+
+    // Columns before requested one are skipped
+    const Entry& e = fields[field];
+    BinaryDecoder d = { e.p, e.size, format, 0, dict.get() };
+
+    for (const BinaryOp& cop : plan.columnOps)
+    {
+        if (cop.kind == binop_copy && cop.offset == column.offset)
+        {
+            p = d.buf;
+            return true;
+        }
+
+        if (!SkipBinaryColumn(d, cop, e.count))
+            return false;
+    }
+
+    return false;
+}
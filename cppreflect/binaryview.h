@@ -0,0 +1,257 @@
+#pragma once
+#include "cppreflect.h"
+#include <string_view>
+#include <memory>                           //shared_ptr
+#include <string.h>                         //memcpy
+#include <algorithm>                        //reverse
+#include <stdint.h>                         //uintptr_t
+
+class BinaryPlan;
+class StringDictionary;
+struct BinaryDecoder;
+struct BinaryOp;
+
+//
+//  Read-only view of primitive array inside encoded buffer. Data is not aligned, so elements are accessed by value.
+//
+template <class T>
+class BinaryArrayView
+{
+public:
+    const char* data = nullptr;
+    size_t count = 0;
+    bool swap = false;                      // Elements are in other byte order (binary_portable on big-endian host)
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    T operator[](size_t i) const
+    {
+        T t;
+        memcpy(&t, data + i * sizeof(T), sizeof(T));
+        if (swap)
+            std::reverse((char*)&t, (char*)&t + sizeof(T));
+        return t;
+    }
+
+    //
+    //  Gets data as array pointer, nullptr if data happens to be misaligned for T or needs byte swapping.
+    //
+    const T* ptr() const
+    {
+        if (swap || (uintptr_t)data % alignof(T) != 0)
+            return nullptr;
+
+        return (const T*)data;
+    }
+};
+
+//
+//  Zero-copy, read-only access to encoded class instance. Parse() validates buffer and records location of each
+//  field, accessors return values or views pointing directly into source buffer - so buffer must outlive the view.
+//  Fields are addressed by ClassTypeInfo::fields index (see ClassTypeInfo::GetFieldIndex).
+//
+//  Usage:
+//
+//      BinaryView v;
+//      if (v.Parse(buf, len, Person::GetType()))
+//          std::string_view hobby = v.GetStrings(hobbiesIndex)[0];
+//
+class BinaryView
+{
+public:
+    //
+    //  Parses encoded class instance, returns false if buffer is malformed. *consumed receives encoded size.
+    //
+    bool Parse(const void* buf, size_t len, ClassTypeInfo& type, int format = binary_native, size_t* consumed = nullptr);
+
+    ClassTypeInfo* GetType() const
+    {
+        return type;
+    }
+
+    //
+    //  Gets fixed size field value (int, bool, enum...), T must match field type size.
+    //
+    template <class T>
+    T Get(int field) const
+    {
+        T t = T();
+        if (!IsField(field))
+            return t;
+
+        const Entry& e = fields[field];
+        if (e.size == sizeof(T))
+        {
+            memcpy(&t, e.p, sizeof(T));
+            if (NeedSwap())
+                std::reverse((char*)&t, (char*)&t + sizeof(T));
+        }
+
+        return t;
+    }
+
+    //
+    //  Gets raw bytes of field (string contents, fixed size value, whole primitive array).
+    //
+    std::string_view GetBytes(int field) const
+    {
+        if (!IsField(field))
+            return std::string_view();
+
+        return std::string_view(fields[field].p, fields[field].size);
+    }
+
+    //
+    //  Gets std::string field.
+    //
+    std::string_view GetString(int field) const
+    {
+        return GetBytes(field);
+    }
+
+    //
+    //  Gets std::wstring field. wchar_t data in buffer is not aligned (or is UTF-8 in portable format), so this
+    //  makes a copy. Malformed UTF-8 gives empty string.
+    //
+    std::wstring GetWString(int field) const;
+
+    //
+    //  Gets primitive array field, for example vector<int>. Array packed by binary_packed format cannot be viewed
+    //  in place - empty view is returned, use GetValues() instead.
+    //
+    template <class T>
+    BinaryArrayView<T> GetArray(int field) const
+    {
+        BinaryArrayView<T> v;
+        if (!IsField(field))
+            return v;
+
+        const Entry& e = fields[field];
+        if (e.count && !e.packed && e.size / e.count == sizeof(T))
+        {
+            v.data = e.p;
+            v.count = e.count;
+            v.swap = sizeof(T) > 1 && NeedSwap();
+        }
+
+        return v;
+    }
+
+    //
+    //  Gets copy of primitive array field values, decoding packed array if needed.
+    //
+    template <class T>
+    std::vector<T> GetValues(int field) const
+    {
+        std::vector<T> v(ArraySize(field));
+        if (v.size() && !GetValues(field, v.data(), sizeof(T)))
+            v.clear();
+
+        return v;
+    }
+
+    bool GetValues(int field, void* dest, size_t size) const;
+
+    //
+    //  Gets array element count.
+    //
+    size_t ArraySize(int field) const
+    {
+        return IsField(field) ? fields[field].count : 0;
+    }
+
+    //
+    //  Gets strings of vector<string> field.
+    //
+    std::vector<std::string_view> GetStrings(int field) const;
+
+    //
+    //  Gets nested class field.
+    //
+    BinaryView GetObject(int field) const;
+
+    //
+    //  Gets elements of vector<class> field. Elements of array encoded column by column (binary_columnar) cannot
+    //  be viewed separately - empty vector is returned, use GetColumn() instead.
+    //
+    std::vector<BinaryView> GetObjects(int field) const;
+
+    //
+    //  Gets column of vector<class> field encoded by binary_columnar format - values of fixed size field elemField
+    //  (index in element class fields) of all elements, contiguous in buffer.
+    //
+    template <class T>
+    BinaryArrayView<T> GetColumn(int field, int elemField) const
+    {
+        BinaryArrayView<T> v;
+        if (FindColumn(field, elemField, sizeof(T), v.data))
+        {
+            v.count = fields[field].count;
+            v.swap = sizeof(T) > 1 && NeedSwap();
+        }
+
+        return v;
+    }
+
+protected:
+    friend class BinaryLocator;
+
+    //
+    //  Location of field data in buffer. For variable sized fields p points to data after length prefix (or to
+    //  dictionary entry), for arrays p points to first element and size covers all elements.
+    //
+    struct Entry
+    {
+        const char* p;
+        size_t size;
+        size_t count;
+        bool packed;                        // Packed primitive array (binary_packed), p points to its mode byte
+    };
+
+    void CheckPacked(Entry& e, const BinaryOp& op);
+
+    bool IsField(int field) const
+    {
+        return field >= 0 && (size_t)field < fields.size();
+    }
+
+    bool IsColumnar() const
+    {
+        return (format & binary_columnar) && !(format & binary_tagged);
+    }
+
+    bool FindColumn(int field, int elemField, size_t size, const char*& p) const;
+
+    bool ParseInstance(BinaryDecoder& d, ClassTypeInfo& type);
+    bool ParsePlain(BinaryDecoder& d, BinaryPlan& plan);
+    bool ParseTagged(BinaryDecoder& d, BinaryPlan& plan);
+
+    //
+    //  Parses nested class instance into v, using format and dictionary of this view.
+    //
+    bool ParseNested(BinaryView& v, const char* p, size_t len, ClassTypeInfo& type, size_t* consumed) const;
+
+    bool NeedSwap() const
+    {
+#ifdef CPPREFLECT_BIG_ENDIAN
+        return (format & binary_portable) != 0;
+#else
+        return false;
+#endif
+    }
+
+    ClassTypeInfo* type = nullptr;
+    int format = binary_native;
+    std::vector<Entry> fields;
+
+    // binary_dictionary: string dictionary of top level instance, shared with nested views
+    std::shared_ptr<const StringDictionary> dict;
+};
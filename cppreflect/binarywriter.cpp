@@ -0,0 +1,332 @@
+#include "binarywriter.h"
+#include <algorithm>                          //max
+#include <ostream>                            //ostream
+#include <errno.h>                            //EINTR
+#include <limits.h>                           //INT_MAX
+#ifdef _WIN32
+#include <io.h>                               //_write
+#else
+#include <unistd.h>                           //write
+#endif
+
+// Minimal size of chained chunk
+static const size_t minChunkSize = 4096;
+
+BinaryMemoryWriter::BinaryMemoryWriter(void* buf, size_t capacity)
+{
+    begin = cur = (char*)buf;
+    end = begin + capacity;
+}
+
+void BinaryMemoryWriter::Overflow(const void* p, size_t size)
+{
+    size_t n = (size_t)(end - cur);
+    if (n)
+        memcpy(cur, p, n);
+    cur += n;
+    flushed += size - n;
+    overflow = true;
+}
+
+BinaryBufferWriter::BinaryBufferWriter(size_t sizeHint)
+{
+    if (!sizeHint)
+        return;
+
+    Chunk c;
+    c.data.reset(new char[sizeHint]);
+    c.size = 0;
+    begin = cur = c.data.get();
+    end = begin + sizeHint;
+    chunks.push_back(std::move(c));
+}
+
+BinaryBufferWriter::BinaryBufferWriter(std::string& _output) :
+    output(&_output)
+{
+    // Existing content is overwritten, rest of capacity is taken as needed, so it does not get zero filled upfront
+    output->resize(std::max(output->size(), std::min(output->capacity(), minChunkSize)));
+    begin = cur = &(*output)[0];
+    end = begin + output->size();
+}
+
+void BinaryBufferWriter::Overflow(const void* _p, size_t size)
+{
+    const char* p = (const char*)_p;
+
+    // Fill up current chunk first
+    size_t n = (size_t)(end - cur);
+    if (n)
+    {
+        memcpy(cur, p, n);
+        cur += n;
+        p += n;
+        size -= n;
+    }
+
+    NewChunk(size);
+    memcpy(cur, p, size);
+    cur += size;
+}
+
+char* BinaryBufferWriter::Reserve(size_t size)
+{
+    if ((size_t)(end - cur) < size)
+        NewChunk(size);
+
+    return BinaryWriter::Reserve(size);
+}
+
+//
+//  Closes current chunk and chains new one, with space for at least size bytes. Output string is first grown
+//  geometrically within its capacity.
+//
+void BinaryBufferWriter::NewChunk(size_t size)
+{
+    size_t used = (size_t)(cur - begin);
+    if (output && chunks.empty() && output->capacity() - used >= size)
+    {
+        size_t grow = std::max(std::max(used + size, output->size() * 2), minChunkSize);
+        output->resize(std::min(grow, output->capacity()));
+        begin = &(*output)[0];
+        cur = begin + used;
+        end = begin + output->size();
+        return;
+    }
+
+    if (chunks.size())
+        chunks.back().size = used;
+    else
+        outputUsed = used;
+
+    flushed += used;
+
+    // Each new chunk is at least as big as all data so far, so amount of chunks grows logarithmically.
+    size_t capacity = std::max(std::max(size, flushed), minChunkSize);
+    Chunk c;
+    c.data.reset(new char[capacity]);
+    c.size = 0;
+    begin = cur = c.data.get();
+    end = begin + capacity;
+    chunks.push_back(std::move(c));
+}
+
+void BinaryBufferWriter::CopyTo(void* dest) const
+{
+    char* d = (char*)dest;
+
+    if (chunks.empty())
+    {
+        if (cur != begin)
+            memcpy(d, begin, (size_t)(cur - begin));
+        return;
+    }
+
+    if (output && outputUsed)
+    {
+        memcpy(d, output->data(), outputUsed);
+        d += outputUsed;
+    }
+
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        size_t n = (i + 1 == chunks.size()) ? (size_t)(cur - begin) : chunks[i].size;
+        if (n)
+            memcpy(d, chunks[i].data.get(), n);
+        d += n;
+    }
+}
+
+size_t BinaryBufferWriter::Finish()
+{
+    size_t total = Size();
+    if (!output)
+        return total;
+
+    if (chunks.size())
+    {
+        chunks.back().size = (size_t)(cur - begin);
+        output->resize(total);
+        char* d = &(*output)[outputUsed];
+
+        for (Chunk& c : chunks)
+        {
+            memcpy(d, c.data.get(), c.size);
+            d += c.size;
+        }
+
+        chunks.clear();
+    }
+    else
+    {
+        output->resize(total);
+    }
+
+    // All data is now in output string.
+    begin = &(*output)[0];
+    cur = end = begin + total;
+    flushed = 0;
+    outputUsed = 0;
+    return total;
+}
+
+BinaryStreamWriter::BinaryStreamWriter(size_t bufferSize)
+{
+    if (bufferSize == 0)
+        bufferSize = 1;
+
+    buffer.reset(new char[bufferSize]);
+    begin = cur = buffer.get();
+    end = begin + bufferSize;
+}
+
+void BinaryStreamWriter::Out(const void* p, size_t size)
+{
+    if (failed || size == 0)
+        return;
+
+    if (!WriteOut(p, size))
+        failed = true;
+}
+
+void BinaryStreamWriter::FlushBuffer()
+{
+    size_t n = (size_t)(cur - begin);
+    Out(begin, n);
+    flushed += n;
+    cur = begin;
+}
+
+void BinaryStreamWriter::Overflow(const void* _p, size_t size)
+{
+    const char* p = (const char*)_p;
+
+    // Fill up buffer and write it out
+    size_t n = (size_t)(end - cur);
+    memcpy(cur, p, n);
+    cur += n;
+    p += n;
+    size -= n;
+    FlushBuffer();
+
+    if (size >= (size_t)(end - begin))
+    {
+        // Large block, does not make sense to copy it into buffer.
+        Out(p, size);
+        flushed += size;
+        return;
+    }
+
+    memcpy(cur, p, size);
+    cur += size;
+}
+
+bool BinaryStreamWriter::Flush()
+{
+    FlushBuffer();
+    return !failed;
+}
+
+BinaryFileWriter::BinaryFileWriter(FILE* _file, size_t bufferSize) :
+    BinaryStreamWriter(bufferSize),
+    file(_file)
+{
+}
+
+BinaryFileWriter::~BinaryFileWriter()
+{
+    FlushBuffer();
+}
+
+bool BinaryFileWriter::WriteOut(const void* p, size_t size)
+{
+    return fwrite(p, 1, size, file) == size;
+}
+
+bool BinaryFileWriter::Flush()
+{
+    FlushBuffer();
+    if (fflush(file) != 0)
+        failed = true;
+
+    return !failed;
+}
+
+BinaryFdWriter::BinaryFdWriter(int _fd, size_t bufferSize) :
+    BinaryStreamWriter(bufferSize),
+    fd(_fd)
+{
+}
+
+BinaryFdWriter::~BinaryFdWriter()
+{
+    FlushBuffer();
+}
+
+bool BinaryFdWriter::WriteOut(const void* _p, size_t size)
+{
+    const char* p = (const char*)_p;
+
+    while (size)
+    {
+#ifdef _WIN32
+        int r = _write(fd, p, (unsigned int)std::min(size, (size_t)INT_MAX));
+#else
+        ssize_t r = write(fd, p, size);
+#endif
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        p += r;
+        size -= (size_t)r;
+    }
+
+    return true;
+}
+
+BinaryOstreamWriter::BinaryOstreamWriter(std::ostream& _os, size_t bufferSize) :
+    BinaryStreamWriter(bufferSize),
+    os(_os)
+{
+}
+
+BinaryOstreamWriter::~BinaryOstreamWriter()
+{
+    FlushBuffer();
+}
+
+bool BinaryOstreamWriter::WriteOut(const void* p, size_t size)
+{
+    os.write((const char*)p, (std::streamsize)size);
+    return !os.fail();
+}
+
+bool BinaryOstreamWriter::Flush()
+{
+    FlushBuffer();
+    if (os.flush().fail())
+        failed = true;
+
+    return !failed;
+}
+
+BinaryCallbackWriter::BinaryCallbackWriter(Callback _callback, size_t bufferSize) :
+    BinaryStreamWriter(bufferSize),
+    callback(_callback)
+{
+}
+
+BinaryCallbackWriter::~BinaryCallbackWriter()
+{
+    FlushBuffer();
+}
+
+bool BinaryCallbackWriter::WriteOut(const void* p, size_t size)
+{
+    return callback(p, size);
+}
@@ -0,0 +1,238 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>                           //unique_ptr
+#include <functional>                       //function
+#include <iosfwd>                           //ostream
+#include <stdio.h>                          //FILE
+#include <string.h>                         //memcpy
+
+//
+//  Base class for binary encoding output. Encoder writes into [cur, end) window, when window is exhausted
+//  Overflow() is called - derived class decides whether to grow, chain new chunk, flush or just count bytes.
+//
+class BinaryWriter
+{
+public:
+    virtual ~BinaryWriter()
+    {
+    }
+
+    inline void Write(const void* p, size_t size)
+    {
+        if ((size_t)(end - cur) >= size)
+        {
+            if (size)
+                memcpy(cur, p, size);
+            cur += size;
+            return;
+        }
+
+        Overflow(p, size);
+    }
+
+    //
+    //  Reserves size contiguous bytes of output and advances past them, caller fills them in afterwards (used to
+    //  encode parts of output concurrently). Returns nullptr if writer cannot provide contiguous space.
+    //
+    virtual char* Reserve(size_t size)
+    {
+        if ((size_t)(end - cur) < size)
+            return nullptr;
+
+        char* p = cur;
+        cur += size;
+        return p;
+    }
+
+    //
+    // Total amount of bytes written so far.
+    //
+    size_t Size() const
+    {
+        return flushed + (size_t)(cur - begin);
+    }
+
+protected:
+    //
+    //  Called when data does not fit into current window. Must consume all size bytes.
+    //
+    virtual void Overflow(const void* p, size_t size) = 0;
+
+    char* begin = nullptr;
+    char* cur = nullptr;
+    char* end = nullptr;
+
+    // Amount of bytes which went out of current window (previous chunks, flushed or counted data).
+    size_t flushed = 0;
+};
+
+//
+//  Does not store anything, only counts bytes - used to query encoded size.
+//
+class BinaryCountWriter : public BinaryWriter
+{
+protected:
+    virtual void Overflow(const void*, size_t size)
+    {
+        flushed += size;
+    }
+};
+
+//
+//  Writes into fixed size memory buffer. If data does not fit, writes as much as fits, and continues counting,
+//  so Size() reports required buffer size (similar to snprintf).
+//
+class BinaryMemoryWriter : public BinaryWriter
+{
+public:
+    BinaryMemoryWriter(void* buf, size_t capacity);
+
+    //
+    // true if buffer was too small.
+    //
+    bool overflow = false;
+
+protected:
+    virtual void Overflow(const void* p, size_t size);
+};
+
+//
+//  Growable output buffer. Data is written into chunks, when chunk is full - new chunk (at least as big as all data
+//  written so far) is chained, so already written data is never moved and growth is amortized.
+//
+class BinaryBufferWriter : public BinaryWriter
+{
+public:
+    //
+    //  sizeHint - expected encoded size, used as first chunk size.
+    //
+    BinaryBufferWriter(size_t sizeHint = 0);
+
+    //
+    //  Writes directly into output string, its capacity (see std::string::reserve) is used as first chunk, so
+    //  when output string is reused, encoding does not allocate. String is grown within capacity only as data
+    //  is written, so unused capacity is not zero filled. Call Finish() to get all data into output.
+    //
+    BinaryBufferWriter(std::string& output);
+
+    //
+    //  Moves chained chunks into output string (if specified in constructor), returns total size.
+    //
+    size_t Finish();
+
+    //
+    //  Copies all written data into contiguous buffer, which must be at least Size() bytes.
+    //
+    void CopyTo(void* dest) const;
+
+    virtual char* Reserve(size_t size);
+
+protected:
+    virtual void Overflow(const void* p, size_t size);
+    void NewChunk(size_t size);
+
+    struct Chunk
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;                        // Used bytes
+    };
+
+    std::string* output = nullptr;
+    size_t outputUsed = 0;                  // Bytes used in output string, if writing continued in chunks
+    std::vector<Chunk> chunks;
+};
+
+//
+//  Streaming output, data is collected into bounded buffer, and when buffer is full - it's written out to destination,
+//  so whole encoded data never needs to be in memory. Blocks larger than buffer bypass it.
+//  Derived classes implement WriteOut() for specific destination.
+//
+class BinaryStreamWriter : public BinaryWriter
+{
+public:
+    BinaryStreamWriter(size_t bufferSize = 64 * 1024);
+
+    //
+    //  Writes out buffered data. Returns false if any write to destination has failed.
+    //
+    virtual bool Flush();
+
+    //
+    // true if write to destination has failed, further data is discarded.
+    //
+    bool failed = false;
+
+protected:
+    virtual void Overflow(const void* p, size_t size);
+
+    //
+    //  Writes data to destination, returns false if fails.
+    //
+    virtual bool WriteOut(const void* p, size_t size) = 0;
+
+    void FlushBuffer();
+    void Out(const void* p, size_t size);
+
+    std::unique_ptr<char[]> buffer;
+};
+
+//
+//  Writes into stdio file.
+//
+class BinaryFileWriter : public BinaryStreamWriter
+{
+public:
+    BinaryFileWriter(FILE* file, size_t bufferSize = 64 * 1024);
+    ~BinaryFileWriter();
+    virtual bool Flush();
+
+protected:
+    virtual bool WriteOut(const void* p, size_t size);
+    FILE* file;
+};
+
+//
+//  Writes into file descriptor (file, pipe, socket).
+//
+class BinaryFdWriter : public BinaryStreamWriter
+{
+public:
+    BinaryFdWriter(int fd, size_t bufferSize = 64 * 1024);
+    ~BinaryFdWriter();
+
+protected:
+    virtual bool WriteOut(const void* p, size_t size);
+    int fd;
+};
+
+//
+//  Writes into std::ostream.
+//
+class BinaryOstreamWriter : public BinaryStreamWriter
+{
+public:
+    BinaryOstreamWriter(std::ostream& os, size_t bufferSize = 64 * 1024);
+    ~BinaryOstreamWriter();
+    virtual bool Flush();
+
+protected:
+    virtual bool WriteOut(const void* p, size_t size);
+    std::ostream& os;
+};
+
+//
+//  Passes data to user callback, callback returns false to indicate error.
+//
+class BinaryCallbackWriter : public BinaryStreamWriter
+{
+public:
+    typedef std::function<bool(const void* p, size_t size)> Callback;
+
+    BinaryCallbackWriter(Callback callback, size_t bufferSize = 64 * 1024);
+    ~BinaryCallbackWriter();
+
+protected:
+    virtual bool WriteOut(const void* p, size_t size);
+    Callback callback;
+};
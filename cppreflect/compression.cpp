@@ -0,0 +1,448 @@
+#include "compression.h"
+#include "binaryplan.h"                     //CountTrailingZeros
+#include <algorithm>                        //min, max
+#include <mutex>                            //mutex
+#include <stdint.h>                         //uint32_t
+#include <string.h>                         //memcpy, memset
+
+static const int lzCodecId = 1;
+static const size_t lzMinMatch = 4;
+static const size_t lzMaxOffset = 65535;
+static const int lzHashBits = 12;
+
+static const char compressMagic[3] = { 'C', 'R', 'Z' };
+static const uint32_t storedChunkFlag = 0x80000000;
+
+static inline uint32_t Read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t LzHash(uint32_t seq)
+{
+    return (seq * 2654435761u) >> (32 - lzHashBits);
+}
+
+//
+//  Counts equal bytes of p and ref (ref before p) up to end.
+//
+static inline size_t LzMatchLength(const uint8_t* p, const uint8_t* ref, const uint8_t* end)
+{
+    const uint8_t* start = p;
+
+#ifndef CPPREFLECT_BIG_ENDIAN
+    // 8 bytes at a time, first differing byte is found from lowest set bit
+    while (end - p >= 8)
+    {
+        uint64_t a, b;
+        memcpy(&a, p, sizeof(a));
+        memcpy(&b, ref, sizeof(b));
+        if (a != b)
+            return (size_t)(p - start) + (size_t)(CountTrailingZeros(a ^ b) >> 3);
+
+        p += 8;
+        ref += 8;
+    }
+#endif
+
+    while (p < end && *p == *ref)
+    {
+        p++;
+        ref++;
+    }
+
+    return (size_t)(p - start);
+}
+
+static inline bool LzPutLength(uint8_t*& out, uint8_t* outEnd, size_t len)
+{
+    for (; len >= 255; len -= 255)
+    {
+        if (out == outEnd)
+            return false;
+        *out++ = 255;
+    }
+
+    if (out == outEnd)
+        return false;
+
+    *out++ = (uint8_t)len;
+    return true;
+}
+
+//
+//  Writes sequence: token (literal count, match length), literals, match offset. Offset 0 - last sequence, which
+//  has literals only.
+//
+static bool LzSequence(uint8_t*& out, uint8_t* outEnd, const uint8_t* literals, size_t count, size_t offset, size_t length)
+{
+    if (out == outEnd)
+        return false;
+
+    size_t match = offset ? length - lzMinMatch : 0;
+    *out++ = (uint8_t)((std::min(count, (size_t)15) << 4) | std::min(match, (size_t)15));
+
+    if (count >= 15 && !LzPutLength(out, outEnd, count - 15))
+        return false;
+
+    if ((size_t)(outEnd - out) < count)
+        return false;
+
+    if (count)
+        memcpy(out, literals, count);
+    out += count;
+
+    if (!offset)
+        return true;
+
+    if (outEnd - out < 2)
+        return false;
+
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+    return match < 15 || LzPutLength(out, outEnd, match - 15);
+}
+
+static inline bool LzGetLength(const uint8_t*& in, const uint8_t* inEnd, size_t& len, size_t limit)
+{
+    for (;;)
+    {
+        if (in == inEnd)
+            return false;
+
+        uint8_t b = *in++;
+        len += b;
+        if (len > limit)
+            return false;
+
+        if (b != 255)
+            return true;
+    }
+}
+
+class LzCodec : public CompressionCodec
+{
+public:
+    virtual int GetId()
+    {
+        return lzCodecId;
+    }
+
+    virtual size_t Compress(const char* src, size_t size, char* dest, size_t capacity)
+    {
+        if (size > UINT32_MAX)
+            return 0;
+
+        const uint8_t* in = (const uint8_t*)src;
+        const uint8_t* end = in + size;
+        const uint8_t* anchor = in;
+        const uint8_t* p = in;
+        uint8_t* out = (uint8_t*)dest;
+        uint8_t* outEnd = out + capacity;
+
+        // Last position of each 4 byte sequence hash, candidates are verified, so stale entries are harmless
+        uint32_t table[1 << lzHashBits];
+        memset(table, 0, sizeof(table));
+        size_t misses = 0;
+
+        while ((size_t)(end - p) >= lzMinMatch)
+        {
+            uint32_t seq = Read32(p);
+            uint32_t& slot = table[LzHash(seq)];
+            const uint8_t* ref = in + slot;
+            slot = (uint32_t)(p - in);
+
+            if (ref >= p || (size_t)(p - ref) > lzMaxOffset || Read32(ref) != seq)
+            {
+                // Step faster through data which does not compress
+                size_t step = 1 + (misses++ >> 6);
+                p = (size_t)(end - p) > step ? p + step : end;
+                continue;
+            }
+
+            misses = 0;
+            size_t length = lzMinMatch + LzMatchLength(p + lzMinMatch, ref + lzMinMatch, end);
+            if (!LzSequence(out, outEnd, anchor, (size_t)(p - anchor), (size_t)(p - ref), length))
+                return 0;
+
+            p += length;
+            anchor = p;
+        }
+
+        if (!LzSequence(out, outEnd, anchor, (size_t)(end - anchor), 0, 0))
+            return 0;
+
+        return (size_t)(out - (uint8_t*)dest);
+    }
+
+    //
+    //  Each input byte gives at most 255 output bytes (length extension byte), token and offset of sequence give
+    //  less than that.
+    //
+    virtual size_t GetMaxDecompressedSize(size_t size)
+    {
+        return size > (SIZE_MAX - 16) / 255 ? SIZE_MAX : size * 255 + 16;
+    }
+
+    virtual bool Decompress(const char* src, size_t size, char* dest, size_t destSize)
+    {
+        const uint8_t* in = (const uint8_t*)src;
+        const uint8_t* inEnd = in + size;
+        uint8_t* out = (uint8_t*)dest;
+        uint8_t* outBegin = out;
+        uint8_t* outEnd = out + destSize;
+
+        for (;;)
+        {
+            if (in == inEnd)
+                return false;
+
+            uint8_t token = *in++;
+            size_t count = token >> 4;
+            if (count == 15 && !LzGetLength(in, inEnd, count, destSize))
+                return false;
+
+            if (count > (size_t)(inEnd - in) || count > (size_t)(outEnd - out))
+                return false;
+
+            if (count)
+                memcpy(out, in, count);
+            in += count;
+            out += count;
+
+            // Last sequence has literals only
+            if (in == inEnd)
+                return out == outEnd;
+
+            if (inEnd - in < 2)
+                return false;
+
+            size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+            in += 2;
+
+            size_t length = token & 15;
+            if (length == 15 && !LzGetLength(in, inEnd, length, destSize))
+                return false;
+            length += lzMinMatch;
+
+            if (offset == 0 || offset > (size_t)(out - outBegin) || length > (size_t)(outEnd - out))
+                return false;
+
+            const uint8_t* ref = out - offset;
+            if (offset >= length)
+            {
+                memcpy(out, ref, length);
+            }
+            else
+            {
+                // Overlapping match repeats last offset bytes
+                for (size_t i = 0; i < length; i++)
+                    out[i] = ref[i];
+            }
+
+            out += length;
+        }
+    }
+};
+
+CompressionCodec& GetLzCodec()
+{
+    static LzCodec codec;
+    return codec;
+}
+
+static std::mutex codecsLock;
+static CompressionCodec* codecs[256];
+
+bool RegisterCompressionCodec(CompressionCodec& codec)
+{
+    int id = codec.GetId();
+    if (id < 1 || id > 255 || (id == lzCodecId && &codec != &GetLzCodec()))
+        return false;
+
+    std::lock_guard<std::mutex> lock(codecsLock);
+    if (codecs[id] && codecs[id] != &codec)
+        return false;
+
+    codecs[id] = &codec;
+    return true;
+}
+
+CompressionCodec* GetCompressionCodec(int id)
+{
+    if (id == lzCodecId)
+        return &GetLzCodec();
+
+    if (id < 1 || id > 255)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(codecsLock);
+    return codecs[id];
+}
+
+static inline void PutU32(unsigned char* p, size_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static inline uint32_t GetU32(const char* _p)
+{
+    const unsigned char* p = (const unsigned char*)_p;
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+BinaryCompressWriter::BinaryCompressWriter(BinaryWriter& _dest, CompressionCodec& _codec, size_t _chunkSize) :
+    dest(_dest),
+    codec(_codec),
+    chunkSize(std::min(std::max(_chunkSize, (size_t)1), compressMaxChunk))
+{
+    chunk.reset(new char[chunkSize]);
+    packed.reset(new char[chunkSize]);
+    begin = cur = chunk.get();
+    end = begin + chunkSize;
+
+    unsigned char header[compressHeaderSize];
+    memcpy(header, compressMagic, sizeof(compressMagic));
+    header[3] = (unsigned char)codec.GetId();
+    PutU32(header + 4, chunkSize);
+    dest.Write(header, sizeof(header));
+}
+
+void BinaryCompressWriter::CompressChunk()
+{
+    size_t size = (size_t)(cur - begin);
+    if (!size)
+        return;
+
+    // Compressed data must be smaller than original, otherwise chunk is stored as is
+    size_t n = codec.Compress(begin, size, packed.get(), size - 1);
+    unsigned char h[8];
+    PutU32(h, size);
+
+    if (n == 0 || n >= size)
+    {
+        PutU32(h + 4, size | storedChunkFlag);
+        dest.Write(h, sizeof(h));
+        dest.Write(begin, size);
+    }
+    else
+    {
+        PutU32(h + 4, n);
+        dest.Write(h, sizeof(h));
+        dest.Write(packed.get(), n);
+    }
+
+    flushed += size;
+    cur = begin;
+}
+
+void BinaryCompressWriter::Overflow(const void* _p, size_t size)
+{
+    const char* p = (const char*)_p;
+
+    while (size)
+    {
+        size_t n = std::min(size, (size_t)(end - cur));
+        memcpy(cur, p, n);
+        cur += n;
+        p += n;
+        size -= n;
+
+        if (cur == end)
+            CompressChunk();
+    }
+}
+
+void BinaryCompressWriter::Finish()
+{
+    if (finished)
+        return;
+
+    CompressChunk();
+    unsigned char h[4] = { 0, 0, 0, 0 };
+    dest.Write(h, sizeof(h));
+    finished = true;
+}
+
+bool IsCompressedStream(const void* buf, size_t len)
+{
+    return len >= compressHeaderSize && memcmp(buf, compressMagic, sizeof(compressMagic)) == 0;
+}
+
+bool DecompressChunks(const char*& buf, size_t& left, const std::function<bool(const char* p, size_t size)>& output)
+{
+    if (!IsCompressedStream(buf, left))
+        return false;
+
+    CompressionCodec* codec = GetCompressionCodec((unsigned char)buf[3]);
+    size_t maxChunk = GetU32(buf + 4);
+    if (!codec || maxChunk == 0 || maxChunk > compressMaxChunk)
+        return false;
+
+    const char* p = buf + compressHeaderSize;
+    size_t l = left - compressHeaderSize;
+
+    // Buffer grows with chunk sizes rather than being sized by header maximum, declared chunk size is checked
+    // against codec expansion limit first, so small input cannot force large allocation.
+    std::unique_ptr<char[]> chunk;
+    size_t capacity = 0;
+
+    for (;;)
+    {
+        if (l < 4)
+            return false;
+
+        size_t size = GetU32(p);
+        p += 4;
+        l -= 4;
+        if (size == 0)
+            break;
+
+        if (l < 4 || size > maxChunk)
+            return false;
+
+        uint32_t stored = GetU32(p);
+        size_t n = stored & ~storedChunkFlag;
+        p += 4;
+        l -= 4;
+        if (n > l)
+            return false;
+
+        const char* data = p;
+        if (stored & storedChunkFlag)
+        {
+            if (n != size)
+                return false;
+        }
+        else
+        {
+            if (size > codec->GetMaxDecompressedSize(n))
+                return false;
+
+            if (size > capacity)
+            {
+                chunk.reset(new char[size]);
+                capacity = size;
+            }
+
+            if (!codec->Decompress(p, n, chunk.get(), size))
+                return false;
+
+            data = chunk.get();
+        }
+
+        p += n;
+        l -= n;
+        if (!output(data, size))
+            return false;
+    }
+
+    buf = p;
+    left = l;
+    return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "binarywriter.h"                   //BinaryWriter
+#include <functional>                       //function
+#include <memory>                           //unique_ptr
+#include <stddef.h>                         //size_t
+#include <stdint.h>                         //SIZE_MAX
+
+//
+//  Block compression algorithm. Codec instance is shared (see RegisterCompressionCodec), so Compress / Decompress
+//  must be safe to call from several threads at once.
+//
+class CompressionCodec
+{
+public:
+    virtual ~CompressionCodec()
+    {
+    }
+
+    //
+    //  Codec identifier recorded in compressed data (1..255), 1 is used by built-in LZ codec.
+    //
+    virtual int GetId() = 0;
+
+    //
+    //  Compresses size bytes from src into dest. Returns compressed size, or 0 if data does not fit into capacity
+    //  (data is then stored uncompressed).
+    //
+    virtual size_t Compress(const char* src, size_t size, char* dest, size_t capacity) = 0;
+
+    //
+    //  Decompresses data into exactly destSize bytes. Returns false if data is malformed.
+    //
+    virtual bool Decompress(const char* src, size_t size, char* dest, size_t destSize) = 0;
+
+    //
+    //  Upper bound of decompressed size of size bytes of compressed data, so that chunk with larger declared size
+    //  is rejected before its buffer is allocated. By default only stream chunk size limit applies.
+    //
+    virtual size_t GetMaxDecompressedSize(size_t)
+    {
+        return SIZE_MAX;
+    }
+};
+
+//
+//  Built-in dependency-free LZ77 codec (LZ4 style byte oriented sequences, 64 KiB window). Favors speed over ratio.
+//
+CompressionCodec& GetLzCodec();
+
+//
+//  Registers codec, so compressed data using it can be decoded. Returns false if other codec with same id is
+//  already registered. Codec must stay alive while it's registered.
+//
+bool RegisterCompressionCodec(CompressionCodec& codec);
+
+//
+//  Gets registered codec by id, nullptr if not found. Built-in LZ codec is always registered.
+//
+CompressionCodec* GetCompressionCodec(int id);
+
+//
+//  Compressed stream layout (integers little-endian):
+//
+//      header:     "CRZ" magic, uint8 codec id, uint32 maximal chunk size
+//      chunks:     uint32 uncompressed size, uint32 stored size (bit 31 set - chunk stored uncompressed), data
+//      end:        uint32 0
+//
+const size_t compressHeaderSize = 8;
+
+// Upper limit of chunk size, decoder rejects streams with larger chunks.
+const size_t compressMaxChunk = 64 * 1024 * 1024;
+
+//
+//  Compresses written data in chunks of chunkSize bytes and writes them to dest as they fill, so only one chunk
+//  is held in memory. Finish() must be called after all data is written.
+//
+class BinaryCompressWriter : public BinaryWriter
+{
+public:
+    BinaryCompressWriter(BinaryWriter& dest, CompressionCodec& codec, size_t chunkSize = 64 * 1024);
+
+    //
+    //  Compresses remaining data and writes end of stream.
+    //
+    void Finish();
+
+protected:
+    virtual void Overflow(const void* p, size_t size);
+    void CompressChunk();
+
+    BinaryWriter& dest;
+    CompressionCodec& codec;
+    size_t chunkSize;
+    std::unique_ptr<char[]> chunk;
+    std::unique_ptr<char[]> packed;
+    bool finished = false;
+};
+
+//
+//  true if buffer starts with compressed stream header.
+//
+bool IsCompressedStream(const void* buf, size_t len);
+
+//
+//  Decompresses stream produced by BinaryCompressWriter, decompressed chunks are passed to output as they are
+//  decoded. buf / left are advanced past end of stream. Returns false if stream is malformed, its codec is not
+//  registered or output returned false.
+//
+bool DecompressChunks(const char*& buf, size_t& left, const std::function<bool(const char* p, size_t size)>& output);
@@ -1,7 +1,10 @@
 #include <regex>
+#include <string.h>
 #include "cppreflect.h"
 #include "pugixml/pugixml.hpp"              //pugi::xml_node
 #include <sstream>                          //wstringstream
+#include "compression.h"                    //BinaryCompressWriter
+#include "mappedfile.h"                     //MappedFile
 
 using namespace pugi;
 using namespace std;
@@ -113,6 +116,18 @@ struct xml_string_writer : xml_writer
     }
 };
 
+//  Passes xml output to binary writer.
+struct xml_binary_writer : xml_writer
+{
+    BinaryWriter& w;
+    xml_binary_writer(BinaryWriter& _w) : w(_w) {}
+
+    virtual void write( const void* data, size_t size )
+    {
+        w.Write(data, size);
+    }
+};
+
 string ToXML_UTF8( void* pclass, ClassTypeInfo& type )
 {
     xml_document doc;
@@ -243,214 +258,6 @@ bool NodeToData( xml_node node, void* pclass, ClassTypeInfo& type, bool typeChec
     return true;
 }
 
-void lengthToBinaryData(char*& buf, int* len, size_t& t)
-{
-    *len += sizeof(size_t);
-    if (buf) {
-        memcpy(buf, &t, sizeof(size_t));
-        buf += sizeof(size_t);
-    }
-}
-
-//
-//  Serializes class instance to binary buffer.
-//
-//  *buf if non-null - receives encoded buffer
-//  *len - buffer encoded length
-//
-void NodeToBinaryData(char*& buf, int* len, void* pclass, BasicTypeInfo& type)
-{
-    ClassTypeInfo* clstype = dynamic_cast<ClassTypeInfo*>(&type);
-
-    if (!clstype) {
-        // Primitive data type (string, int, bool)
-        size_t s = type.GetFixedSize();
-
-        if (s == 0) {
-            s = type.GetRawSize(pclass);
-            lengthToBinaryData(buf, len, s);
-        }
-        *len += (int)s;
-
-        if (buf) {
-            memcpy(buf, type.GetRawPtr(pclass), s);
-            buf += s;
-        }
-        return;
-    }
-
-    for (FieldInfo& fi : clstype->fields)
-    {
-
-        void* p = ((char*)pclass) + fi.offset;
-        BasicTypeInfo& fieldType = *fi.fieldType;
-        BasicTypeInfo* arrayType = fi.arrayElementType;
-
-        if (!arrayType)
-        {
-            NodeToBinaryData(buf, len, p, fieldType);
-            continue;
-        }
-
-        size_t size = fieldType.ArraySize(p);
-        lengthToBinaryData(buf, len, size);
-
-        char* pstr2;
-        size_t elemSize = 0;
-
-        if (size != 0)
-        {
-            pstr2 = (char*)fieldType.ArrayElement(p, 0);
-            elemSize = arrayType->GetSizeOfType();
-        }
-
-        // Primitive flat type, can be just copied.
-        if (arrayType->GetFixedSize() != 0 && dynamic_cast<ClassTypeInfo*>(arrayType) == nullptr)
-        {
-            size_t copySize = size * elemSize;
-            if (buf && copySize)
-            {
-                memcpy(buf, pstr2, copySize);
-                buf += copySize;
-            }
-            
-            *len += (int)copySize;
-            continue;
-        }
-
-        // Complex type, requires for loop
-        for (size_t i = 0; i < size; i++)
-        {
-            NodeToBinaryData(buf, len, pstr2, *arrayType);
-            pstr2 += elemSize;
-        }
-    } // for each
-}
-
-//
-//  Serializes class instance to xml node.
-//
-bool BinaryDataToNode(char*& buf, int* left, void* pclass, BasicTypeInfo& type)
-{
-    try {
-        ClassTypeInfo* clstype = dynamic_cast<ClassTypeInfo*>(&type);
-
-        if (!clstype) {
-            // Primitive data type (string, int, bool)
-            size_t s = type.GetFixedSize();
-            size_t l = s;
-
-            if (s == 0) {
-                s = sizeof(size_t);
-                if (*left < (int)s)
-                    return false;
-
-                memcpy(&l, buf, s);
-                buf += s;
-                *left -= (int)s;
-                type.SetRawSize(pclass, l);
-            }
-
-            if (*left < (int)l)
-                return false;
-            memcpy(type.GetRawPtr(pclass), buf, l);
-            buf += l;
-            *left -= (int)l;
-            return true;
-        }
-
-        for (FieldInfo& fi : clstype->fields) {
-
-            void* p = ((char*)pclass) + fi.offset;
-            BasicTypeInfo& fieldType = *fi.fieldType;
-            BasicTypeInfo* arrayType = fi.arrayElementType;
-
-            if (!arrayType)
-            {
-                if (!BinaryDataToNode(buf, left, p, fieldType))
-                    return false;
-
-                continue;
-            }
-
-            size_t s = sizeof(size_t);
-            size_t arrSize = 0;
-            if (*left < (int)s)
-                return false;
-            memcpy(&arrSize, buf, s);
-            *left -= (int)s;
-            buf += s;
-
-            fieldType.SetArraySize(p, arrSize);
-
-            char* pstr2;
-            size_t elemSize = 0;
-
-            if (arrSize != 0)
-            {
-                pstr2 = (char*)fieldType.ArrayElement(p, 0);
-                elemSize = arrayType->GetSizeOfType();
-            }
-
-            // Primitive flat type, can be just copied.
-            if (arrayType->GetFixedSize() != 0 && dynamic_cast<ClassTypeInfo*>(arrayType) == nullptr)
-            {
-                size_t copySize = arrSize * elemSize;
-                if (*left < (int)copySize)
-                    return false;
-
-                if (buf && copySize)
-                {
-                    memcpy(pstr2, buf, copySize);
-                    buf += copySize;
-                }
-
-                *left -= (int)copySize;
-                continue;
-            }
-
-            // Complex type, requires for loop
-            for (size_t i = 0; i < arrSize; i++)
-            {
-                if (!BinaryDataToNode(buf, left, pstr2, *arrayType))
-                    return false;
-
-                pstr2 += elemSize;
-            }
-
-        } // for each
-    } catch (std::bad_alloc&) {
-        // Either out of memory or incorrectly decoded buffer
-        return false;
-    }
-    return true;
-}
-
-int getEncodedSize(void* pclass, ClassTypeInfo& type)
-{
-    int len = 0;
-    char* buf = nullptr;
-    NodeToBinaryData(buf, &len, pclass, type);
-
-    return len;
-}
-
-void serialize_to_buffer(std::string& buf, void* pclass, ClassTypeInfo& type)
-{
-    buf.resize(getEncodedSize(pclass, type));
-    char* pbuf = (char*)&buf.front();
-    int len = 0;
-    NodeToBinaryData(pbuf, &len, pclass, type);
-}
-
-bool parse_from_buffer(const void* buf, int len, void* pclass, ClassTypeInfo& type)
-{
-    char* pbuf = (char*)buf;
-    int llen = len;
-
-    return BinaryDataToNode(pbuf, &llen, pclass, type);
-}
-
 bool FromXml( void* pclass, ClassTypeInfo& type, const wchar_t* xml, wstring& error )
 {
     xml_document doc2;
@@ -466,7 +273,7 @@ bool FromXml( void* pclass, ClassTypeInfo& type, const wchar_t* xml, wstring& er
     return NodeToData( doc2.first_child(), pclass, type, true, error );
 }
 
-bool SaveToXmlFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring&)
+bool SaveToXmlFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error, CompressionCodec* codec)
 {
     xml_document doc;
 
@@ -477,7 +284,40 @@ bool SaveToXmlFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::
     if (!DataToNode(doc, pclass, true, type))
         return false;
 
-    return doc.save_file(path, L"  ", format_indent | format_save_file_text | format_write_bom, encoding_utf8);
+    unsigned int flags = format_indent | format_save_file_text | format_write_bom;
+    if (!codec)
+        return doc.save_file(path, L"  ", flags, encoding_utf8);
+
+#ifdef _WIN32
+    FILE* file = _wfopen(path, L"wb");
+#else
+    FILE* file = fopen(as_utf8(path).c_str(), "wb");
+#endif
+    if (!file)
+    {
+        error = L"Failed to create file '";
+        error.append(path);
+        error.append(L"'");
+        return false;
+    }
+
+    // xml is compressed while being written, chunk by chunk
+    BinaryFileWriter fw(file);
+    BinaryCompressWriter cw(fw, *codec);
+    xml_binary_writer writer(cw);
+    doc.save(writer, L"  ", flags, encoding_utf8);
+    cw.Finish();
+
+    bool ok = fw.Flush();
+    if (fclose(file) != 0 || !ok)
+    {
+        error = L"Failed to write file '";
+        error.append(path);
+        error.append(L"'");
+        return false;
+    }
+
+    return true;
 }
 
 std::wstring as_xml(void* pclass, ClassTypeInfo& type)
@@ -496,8 +336,33 @@ std::wstring as_xml(void* pclass, ClassTypeInfo& type)
 bool LoadFromXmlFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error)
 {
     xml_document doc2;
+    xml_parse_result res;
+
+    MappedFile file;
+    wstring mapError;
+    if (!file.OpenRead(path, mapError))
+    {
+        // Mapping failed, let pugixml report file error
+        res = doc2.load_file(path);
+    }
+    else if (IsCompressedStream(file.data, file.size))
+    {
+        string xml;
+        const char* buf = file.data;
+        size_t left = file.size;
+        if (!DecompressChunks(buf, left, [&](const char* p, size_t size) { xml.append(p, size); return true; }) || left != 0)
+        {
+            error = L"Failed to load xml: malformed compressed data";
+            return false;
+        }
+
+        res = doc2.load_buffer(xml.data(), xml.size());
+    }
+    else
+    {
+        res = doc2.load_buffer(file.data, file.size);
+    }
 
-    xml_parse_result res = doc2.load_file(path);
     if (!res)
     {
         error = L"Failed to load xml: ";
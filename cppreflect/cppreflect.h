@@ -3,8 +3,15 @@
 #include <memory>                     //shared_ptr
 #include <vector>
 #include <string>
+#include <string_view>
+#include <mutex>                      //once_flag
+#include <stdint.h>                   //uint64_t
+#include <type_traits>                //enable_if, is_same
+#include "binarywriter.h"             //BinaryWriter
 
 class FieldInfo;
+class BinaryPlan;
+class CompressionCodec;
 class ReflectClass;
 
 #if defined(__GNUC__) || defined(__llvm__)
@@ -79,6 +86,17 @@ public:
         return nullptr; // Invalid operation, since not array
     }
 
+    //
+    //  Inserts count default constructed elements before position i / removes count elements from position i.
+    //
+    virtual void InsertArrayElements(void*, size_t, size_t)
+    {
+    }
+
+    virtual void EraseArrayElements(void*, size_t, size_t)
+    {
+    }
+
     //
     // Converts specific data to String.
     //
@@ -150,6 +168,10 @@ public:
     // Get field index, -1 if not found.
     int GetFieldIndex(const char* name);
 
+    // Compiled binary encoding plan, see GetBinaryPlan().
+    std::shared_ptr<BinaryPlan> binaryPlan;
+    std::once_flag binaryPlanOnce;
+
     //  Creates new class instance, converts it to ReflectClass* base class
     virtual ReflectClass* ReflectCreateInstance() = 0;
 
@@ -181,7 +203,7 @@ class ClassTypeInfoT : public ClassTypeInfo
 {
     ReflectClass* ReflectCreateInstance()
     {
-        return new T;
+        return new T();
     }
 
     virtual size_t GetFixedSize()
@@ -297,20 +319,179 @@ std::wstring ToXML( T* pclass )
     return ToXML( pclass, type );
 }
 
+//
+//  Binary encoding format flags, can be combined. Data must be decoded with the same flags it was encoded with.
+//
+enum EBinaryFormat
+{
+    // Positional format, fixed size fields are copied as is, lengths are written as size_t.
+    binary_native = 0,
+
+    // String and array lengths are written as LEB128 varints (1 byte for lengths below 128).
+    binary_varint = 1,
+
+    // Arrays of variable sized classes are preceded by table of encoded block sizes (one entry per 64 elements),
+    // so elements can be decoded in parallel (parse_from_buffer_parallel) and skipped without parsing.
+    binary_offsets = 2,
+
+    // Data is prefixed with schema fingerprint and schema description, so it can be decoded after fields were added,
+    // removed or reordered (see GetSchemaFingerprint).
+    binary_schema = 4,
+
+    // Each field is prefixed with tag (field index and wire type), nested classes and arrays are length prefixed,
+    // so unknown (added later) or unwanted fields can be skipped without parsing. Field index is position in
+    // ClassTypeInfo::fields, so fields may only be appended. Not combined with binary_schema / binary_offsets.
+    binary_tagged = 8,
+
+    // Machine independent layout: fixed size values are little-endian, lengths are 8 bytes (unless binary_varint),
+    // std::wstring is UTF-8. Fixed size fields are byte swapped as single scalar of their size (2, 4 or 8 bytes),
+    // so types must have same size on both sides (prefer int32_t / int64_t over long).
+    binary_portable = 16,
+
+    // Encoded data is compressed in chunks (see compression.h) by built-in LZ codec, or by codec passed to
+    // serialize_to_buffer. Codec is recorded in data, decoder finds it among registered codecs. Can be combined
+    // with any other flag, but data cannot be accessed by BinaryView / BinaryPushDecoder.
+    binary_compressed = 32,
+
+    // Primitive arrays of 2, 4 or 8 byte elements (vector<int>, vector<int64_t>...) are stored as first value and
+    // zigzag encoded deltas, bit-packed in blocks of 128 with bit width per block - when it's smaller than raw data,
+    // which is decided per array. Monotonic ids take a few bits per element.
+    binary_packed = 64,
+
+    // Distinct std::string values of class instance are written once, in dictionary in front of data, and each
+    // string field / array element is written as varint index into it. Pays off when few strings repeat a lot
+    // (vector<string> of tags, enum-like names).
+    binary_dictionary = 128,
+
+    // Arrays of classes (vector<Person>) are written column by column - all values of first field, then all values
+    // of second field and so on (nested class fields are columns too), which compresses better and lets fixed size
+    // columns be scanned in place (BinaryView::GetColumn). Arrays are not preceded by offset table. Ignored with
+    // binary_tagged.
+    binary_columnar = 256,
+};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CPPREFLECT_BIG_ENDIAN
+#endif
+
+//
+//  Gets hash of class binary schema - field names, wire types and order, including nested classes.
+//
+uint64_t GetSchemaFingerprint(ClassTypeInfo& type);
+
+void NodeToBinaryData(BinaryWriter& w, void* pclass, BasicTypeInfo& type, int format = binary_native);
+bool BinaryDataToNode(const char*& buf, size_t& left, void* pclass, BasicTypeInfo& type, int format = binary_native);
+
+//
+//  int based versions, limited to INT_MAX bytes. NodeToBinaryData sets *len to -1 if data does not fit.
+//
 void NodeToBinaryData(char*& buf, int* len, void* pclass, BasicTypeInfo& type);
 bool BinaryDataToNode(char*& buf, int* left, void* pclass, BasicTypeInfo& type);
 
 //
 //  Queries size of encoded class
 //
+size_t getEncodedSize64(void* pclass, ClassTypeInfo& type, int format = binary_native);
+
+//
+//  Same as getEncodedSize64, returns -1 if encoded size does not fit into int.
+//
 int getEncodedSize(void* pclass, ClassTypeInfo& type);
 
 //
-//  Encodes class to binary buffer
+//  Encodes class to binary buffer, object graph is walked only once.
+//  buf capacity is used as initial output buffer - reserve() it if encoded size is approximately known.
 //  To decode class from binary, use BinaryDataToNode
 //
-void serialize_to_buffer(std::string& buf, void* pclass, ClassTypeInfo& type);
-bool parse_from_buffer(const void* buf, int len, void* pclass, ClassTypeInfo& type);
+void serialize_to_buffer(std::string& buf, void* pclass, ClassTypeInfo& type, int format = binary_native);
+void serialize_to_buffer(BinaryWriter& w, void* pclass, ClassTypeInfo& type, int format = binary_native);
+
+//
+//  Same as serialize_to_buffer, but encoded data is compressed using codec (binary_compressed is implied) - chunk
+//  by chunk, as encoding progresses.
+//
+void serialize_to_buffer(std::string& buf, void* pclass, ClassTypeInfo& type, int format, CompressionCodec& codec);
+void serialize_to_buffer(BinaryWriter& w, void* pclass, ClassTypeInfo& type, int format, CompressionCodec& codec);
+
+//
+//  Same as serialize_to_buffer, but large arrays of classes (vector<Person>) are encoded using up to threads
+//  threads (0 - one per CPU core). Output is byte-identical to serialize_to_buffer. Class instance must not be
+//  modified during encoding.
+//
+void serialize_to_buffer_parallel(std::string& buf, void* pclass, ClassTypeInfo& type, int format = binary_native, int threads = 0);
+void serialize_to_buffer_parallel(BinaryWriter& w, void* pclass, ClassTypeInfo& type, int format = binary_native, int threads = 0);
+
+//
+//  Decodes class from binary buffer, returns false if buffer is malformed or truncated.
+//
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, int format = binary_native);
+bool parse_from_buffer(std::string_view buf, void* pclass, ClassTypeInfo& type, int format = binary_native);
+
+//
+//  Same as above for int length (negative length is malformed). Template, so that only int length picks it, other
+//  integer types convert to size_t without ambiguity.
+//
+template <class Int, class = typename std::enable_if<std::is_same<Int, int>::value>::type>
+bool parse_from_buffer(const void* buf, Int len, void* pclass, ClassTypeInfo& type, int format = binary_native)
+{
+    return len >= 0 && parse_from_buffer(buf, (size_t)len, pclass, type, format);
+}
+
+//
+//  Same as parse_from_buffer, but std::pmr fields (std::pmr::string, std::pmr::vector) allocate from resource - with
+//  std::pmr::monotonic_buffer_resource whole message is freed at once. Decoded instance must be destroyed before
+//  resource is released.
+//
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, std::pmr::memory_resource& resource, int format = binary_native);
+
+//
+//  Limits for decoding untrusted data. Each length is checked against remaining buffer and limits before storage
+//  is allocated, so hostile length prefix fails decoding cheaply.
+//
+struct BinaryDecodeOptions
+{
+    size_t maxBytes = SIZE_MAX;             // Total storage of decoded strings, blobs, arrays and decompressed data
+    size_t maxArrayCount = SIZE_MAX;        // Elements of single array
+    size_t maxDepth = SIZE_MAX;             // Class nesting - top level class is at depth 0, its class fields and
+                                            // array elements at depth 1...
+};
+
+//
+//  Same as parse_from_buffer, but fails when decoded data exceeds options limits.
+//
+bool parse_from_buffer(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, const BinaryDecodeOptions& options, int format = binary_native);
+
+//
+//  Same as parse_from_buffer, but arrays of classes having offset table (binary_offsets format) are decoded using
+//  up to threads threads (0 - one per CPU core).
+//
+bool parse_from_buffer_parallel(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, int format = binary_offsets, int threads = 0);
+
+//
+//  Storage needed by decoded class instance, collected by ValidateBinaryData.
+//
+struct BinaryBudget
+{
+    size_t size = 0;                        // Encoded size of class instance
+    size_t allocations = 0;                 // Non-empty strings, blobs and arrays (upper bound of heap allocations)
+    size_t bytes = 0;                       // Total size of their contents
+};
+
+//
+//  Validation pass for trusted decoding: walks encoded lengths once, checks that every value fits into buffer
+//  without decoding anything, and collects storage budget (for example to reject too large message or to size
+//  arena for parse_from_buffer with memory resource). Supports binary_varint, binary_portable and binary_offsets
+//  formats, returns false for other format flags.
+//
+bool ValidateBinaryData(const void* buf, size_t len, ClassTypeInfo& type, int format = binary_native, BinaryBudget* budget = nullptr);
+
+//
+//  Decodes buffer validated by ValidateBinaryData (or produced by serialize_to_buffer and protected by checksum)
+//  without per-field bounds checks. Malformed buffer gives undefined behavior, untrusted input must go through
+//  parse_from_buffer. Formats not supported by ValidateBinaryData are decoded by parse_from_buffer. Out of memory
+//  is reported by std::bad_alloc.
+//
+bool parse_from_buffer_unchecked(const void* buf, size_t len, void* pclass, ClassTypeInfo& type, int format = binary_native);
 
 bool FromXml( void* pclass, ClassTypeInfo& type, const wchar_t* xml, std::wstring& error );
 
@@ -324,10 +505,30 @@ bool FromXml( T* pclass, const wchar_t* xml, std::wstring& error )
     return FromXml(pclass, type, xml, error);
 }
 
+//
+//  Loads class instance from xml file, file compressed by SaveToXmlFile is decompressed automatically.
+//
 bool LoadFromXmlFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error);
-bool SaveToXmlFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error);
+
+//
+//  Saves class instance to xml file. If codec is specified, xml is compressed while being written.
+//
+bool SaveToXmlFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error, CompressionCodec* codec = nullptr);
 std::wstring as_xml(void* pclass, ClassTypeInfo& type);
 
+//
+//  Loads class instance from binary file. File is memory mapped and decoded directly from mapping, without
+//  intermediate copy. Returns false and fills error if file cannot be read or contents is malformed.
+//
+bool LoadFromBinaryFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error, int format = binary_native);
+
+//
+//  Saves class instance to binary file. File is preallocated to encoded size and written through memory mapping.
+//  If codec is specified, data is compressed with it (binary_compressed is implied) and streamed to file.
+//
+bool SaveToBinaryFile(const wchar_t* path, void* pclass, ClassTypeInfo& type, std::wstring& error, int format = binary_native,
+    CompressionCodec* codec = nullptr);
+
 class ReflectClass;
 
 //
@@ -0,0 +1,135 @@
+#include "decodepool.h"
+#include <string.h>                         //memcpy
+
+DecodePool::DecodePool(size_t maxFree): maxFree(maxFree)
+{
+}
+
+DecodePool::~DecodePool()
+{
+    Clear();
+}
+
+ReflectClass* DecodePool::Acquire(ClassTypeInfo& type)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<ReflectClass*>& free = pools[&type].free;
+        if (free.size())
+        {
+            ReflectClass* instance = free.back();
+            free.pop_back();
+            return instance;
+        }
+    }
+
+    return type.ReflectCreateInstance();
+}
+
+void DecodePool::Release(ReflectClass* instance)
+{
+    if (!instance)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<ReflectClass*>& free = pools[&instance->GetInstType()].free;
+        if (free.size() < maxFree)
+        {
+            free.push_back(instance);
+            return;
+        }
+    }
+
+    delete instance;
+}
+
+//
+//  Copies field values of default instance (at defaults) to instance at p.
+//
+static void ResetFields(char* p, const char* defaults, ClassTypeInfo& type)
+{
+    for (FieldInfo& fi : type.fields)
+    {
+        BasicTypeInfo* fieldType = fi.fieldType.get();
+        char* field = p + fi.offset;
+        const char* def = defaults + fi.offset;
+
+        if (fi.arrayElementType)
+        {
+            fieldType->SetArraySize(field, 0);
+            continue;
+        }
+
+        ClassTypeInfo* classType = dynamic_cast<ClassTypeInfo*>(fieldType);
+        if (classType)
+        {
+            ResetFields(field, def, *classType);
+            continue;
+        }
+
+        size_t size = fieldType->GetFixedSize();
+        if (size)
+        {
+            memcpy(field, def, size);
+            continue;
+        }
+
+        // Variable sized value (string)
+        size = fieldType->GetRawSize((void*)def);
+        fieldType->SetRawSize(field, size);
+        if (size)
+            memcpy(fieldType->GetRawPtr(field), fieldType->GetRawPtr((void*)def), size);
+    }
+}
+
+void DecodePool::Reset(ReflectClass* instance)
+{
+    ClassTypeInfo& type = instance->GetInstType();
+    ReflectClass* defaults;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        TypePool& pool = pools[&type];
+        if (!pool.defaults)
+            pool.defaults.reset(type.ReflectCreateInstance());
+
+        defaults = pool.defaults.get();
+    }
+
+    ResetFields((char*)instance->ReflectGetInstance(), (const char*)defaults->ReflectGetInstance(), type);
+}
+
+ReflectClass* DecodePool::Parse(const void* buf, size_t len, ClassTypeInfo& type, int format)
+{
+    ReflectClass* instance = Acquire(type);
+    if (format & (binary_schema | binary_tagged))
+        Reset(instance);
+
+    if (!parse_from_buffer(buf, len, instance->ReflectGetInstance(), type, format))
+    {
+        Release(instance);
+        return nullptr;
+    }
+
+    return instance;
+}
+
+size_t DecodePool::FreeCount(ClassTypeInfo& type)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = pools.find(&type);
+    return it != pools.end() ? it->second.free.size() : 0;
+}
+
+void DecodePool::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto& it : pools)
+    {
+        for (ReflectClass* instance : it.second.free)
+            delete instance;
+
+        it.second.free.clear();
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "cppreflect.h"
+#include <unordered_map>
+#include <mutex>
+
+//
+//  Pool of class instances for repeated decode loops. Instance returned to pool keeps its strings and vectors
+//  with their capacity, so once data sizes settle decoding into pooled instance does no allocations. Instances
+//  are kept in free list per class type. Pool can be shared between threads.
+//
+//  Usage:
+//
+//      DecodePool pool;
+//      while (ReadMessage(buf))
+//      {
+//          People* ppl = pool.Parse<People>(buf.data(), buf.size());
+//          if (ppl)
+//              Process(*ppl);
+//          pool.Release(ppl);
+//      }
+//
+class DecodePool
+{
+public:
+    //
+    //  maxFree - maximum amount of free instances kept per class type, instances released above that are deleted.
+    //
+    DecodePool(size_t maxFree = 64);
+    ~DecodePool();
+
+    //
+    //  Takes instance from pool or creates new one. Taken instance keeps values from its previous use, see Reset.
+    //
+    ReflectClass* Acquire(ClassTypeInfo& type);
+
+    template <class T>
+    T* Acquire()
+    {
+        return (T*)Acquire(T::GetType())->ReflectGetInstance();
+    }
+
+    //
+    //  Returns instance to pool, nullptr is ignored. Instance must not be used afterwards.
+    //
+    void Release(ReflectClass* instance);
+
+    //
+    //  Restores field values of default constructed instance, keeping capacity of strings. Arrays are emptied,
+    //  elements of arrays of classes are destroyed.
+    //
+    void Reset(ReflectClass* instance);
+
+    //
+    //  Decodes class instance into pooled instance, returns nullptr if buffer is malformed (instance is returned
+    //  to pool). Decoding overwrites all fields, formats which may omit fields (binary_schema, binary_tagged)
+    //  reset instance first.
+    //
+    ReflectClass* Parse(const void* buf, size_t len, ClassTypeInfo& type, int format = binary_native);
+
+    template <class T>
+    T* Parse(const void* buf, size_t len, int format = binary_native)
+    {
+        ReflectClass* instance = Parse(buf, len, T::GetType(), format);
+        return instance ? (T*)instance->ReflectGetInstance() : nullptr;
+    }
+
+    //
+    //  Gets amount of free instances of given type.
+    //
+    size_t FreeCount(ClassTypeInfo& type);
+
+    //
+    //  Deletes all free instances.
+    //
+    void Clear();
+
+protected:
+    struct TypePool
+    {
+        std::vector<ReflectClass*> free;
+        std::unique_ptr<ReflectClass> defaults;     // Default constructed instance, see Reset
+    };
+
+    size_t maxFree;
+    std::mutex lock;
+    std::unordered_map<ClassTypeInfo*, TypePool> pools;
+};
+
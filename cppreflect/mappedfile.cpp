@@ -0,0 +1,201 @@
+#include "mappedfile.h"
+#include "pugixml/pugixml.hpp"              //as_utf8, as_wide
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>                       //mmap
+#include <sys/stat.h>                       //fstat
+#include <fcntl.h>                          //open, posix_fallocate
+#include <unistd.h>                         //close, ftruncate
+#include <errno.h>
+#include <string.h>                         //strerror
+#endif
+
+//
+//  Formats error message for last failed system call.
+//
+static void SetError(std::wstring& error, const wchar_t* what, const wchar_t* path)
+{
+    error = what;
+    error.append(L" '");
+    error.append(path);
+    error.append(L"': ");
+#ifdef _WIN32
+    error.append(L"error ");
+    error.append(std::to_wstring(GetLastError()));
+#else
+    error.append(pugi::as_wide(strerror(errno)));
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::OpenRead(const wchar_t* path, std::wstring& error, bool sequential)
+{
+    Close();
+    file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, NULL);
+
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+    {
+        SetError(error, L"Failed to open file", path);
+        Close();
+        return false;
+    }
+
+    size = (size_t)fileSize.QuadPart;
+    if (!Map(false, path, error))
+        return false;
+
+    return true;
+}
+
+bool MappedFile::Create(const wchar_t* path, size_t _size, std::wstring& error)
+{
+    Close();
+    file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = (LONGLONG)_size;
+    if (file == INVALID_HANDLE_VALUE || !SetFilePointerEx(file, fileSize, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+    {
+        SetError(error, L"Failed to create file", path);
+        Close();
+        return false;
+    }
+
+    size = _size;
+    if (!Map(true, path, error))
+        return false;
+
+    return true;
+}
+
+bool MappedFile::Map(bool write, const wchar_t* path, std::wstring& error)
+{
+    if (size == 0)
+        return true;
+
+    mapping = CreateFileMappingW(file, NULL, write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
+        data = (char*)MapViewOfFile(mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+
+    if (!data)
+    {
+        SetError(error, L"Failed to map file", path);
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data)
+        UnmapViewOfFile(data);
+
+    if (mapping)
+        CloseHandle(mapping);
+
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+
+    data = nullptr;
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+    size = 0;
+}
+
+#else
+
+bool MappedFile::OpenRead(const wchar_t* path, std::wstring& error, bool sequential)
+{
+    Close();
+    fd = open(pugi::as_utf8(path).c_str(), O_RDONLY);
+
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        SetError(error, L"Failed to open file", path);
+        Close();
+        return false;
+    }
+
+    size = (size_t)st.st_size;
+    if (!Map(false, path, error))
+        return false;
+
+    if (sequential && size)
+        madvise(data, size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+bool MappedFile::Create(const wchar_t* path, size_t _size, std::wstring& error)
+{
+    Close();
+    fd = open(pugi::as_utf8(path).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+    if (fd < 0)
+    {
+        SetError(error, L"Failed to create file", path);
+        return false;
+    }
+
+    int r = -1;
+#ifdef __linux__
+    // Reserve disk space up front, so writing into mapping cannot fail on full disk.
+    if (_size)
+    {
+        r = posix_fallocate(fd, 0, (off_t)_size);
+        if (r != 0)
+            errno = r;
+    }
+#endif
+    if (r != 0 && ftruncate(fd, (off_t)_size) != 0)
+    {
+        SetError(error, L"Failed to resize file", path);
+        Close();
+        return false;
+    }
+
+    size = _size;
+    if (!Map(true, path, error))
+        return false;
+
+    return true;
+}
+
+bool MappedFile::Map(bool write, const wchar_t* path, std::wstring& error)
+{
+    if (size == 0)
+        return true;
+
+    void* p = mmap(nullptr, size, write ? PROT_READ | PROT_WRITE : PROT_READ, write ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        SetError(error, L"Failed to map file", path);
+        Close();
+        return false;
+    }
+
+    data = (char*)p;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data)
+        munmap(data, size);
+
+    if (fd >= 0)
+        close(fd);
+
+    data = nullptr;
+    fd = -1;
+    size = 0;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <stddef.h>                         //size_t
+
+//
+//  Memory mapped file.
+//
+class MappedFile
+{
+public:
+    MappedFile()
+    {
+    }
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    //
+    //  Maps whole file for reading. sequential - hints operating system that file will be read from start to end.
+    //  Returns false and fills error if fails.
+    //
+    bool OpenRead(const wchar_t* path, std::wstring& error, bool sequential = true);
+
+    //
+    //  Creates (or truncates) file of given size and maps it for writing.
+    //
+    bool Create(const wchar_t* path, size_t size, std::wstring& error);
+
+    //
+    //  Unmaps and closes file.
+    //
+    void Close();
+
+    char* data = nullptr;
+    size_t size = 0;
+
+protected:
+    bool Map(bool write, const wchar_t* path, std::wstring& error);
+
+#ifdef _WIN32
+    void* file = (void*)-1;             // INVALID_HANDLE_VALUE
+    void* mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
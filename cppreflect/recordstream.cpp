@@ -0,0 +1,247 @@
+#include "recordstream.h"
+#include "pugixml/pugixml.hpp"              //as_utf8
+#include <string.h>                         //memcpy, memcmp
+
+static const char headerMagic[4] = { 'C', 'R', 'S', '1' };
+static const char trailerMagic[4] = { 'C', 'R', 'S', 'X' };
+static const size_t headerSize = 8;
+static const size_t trailerSize = 12;
+
+static FILE* OpenFile(const wchar_t* path, const wchar_t* mode)
+{
+#ifdef _WIN32
+    return _wfopen(path, mode);
+#else
+    return fopen(pugi::as_utf8(path).c_str(), pugi::as_utf8(mode).c_str());
+#endif
+}
+
+static bool SeekFile(FILE* f, uint64_t pos)
+{
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)pos, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)pos, SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t ReadU64(const char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+RecordStreamWriter::~RecordStreamWriter()
+{
+    std::wstring error;
+    Close(error);
+}
+
+bool RecordStreamWriter::Open(const wchar_t* path, std::wstring& error, bool append, int _format)
+{
+    Close(error);
+    error.clear();
+    format = _format;
+    failed = false;
+    offsets.clear();
+
+    if (append)
+    {
+        file = OpenFile(path, L"r+b");
+
+        if (file)
+        {
+            // Load existing index. New records and index are written after existing trailer, so existing stream
+            // stays valid until new index is written.
+            RecordStreamReader r;
+            if (!r.Open(path, error))
+            {
+                fclose(file);
+                file = nullptr;
+                return false;
+            }
+
+            if (r.GetFormat() != format)
+            {
+                error = L"Record stream '";
+                error.append(path);
+                error.append(L"' was written using different binary format");
+                fclose(file);
+                file = nullptr;
+                return false;
+            }
+
+            offsets.resize(r.Count());
+            for (size_t i = 0; i < offsets.size(); i++)
+            {
+                std::string_view rec;
+                if (!r.GetRecord(i, rec))
+                {
+                    error = L"Record stream index is corrupted: ";
+                    error.append(path);
+                    fclose(file);
+                    file = nullptr;
+                    return false;
+                }
+
+                offsets[i] = (uint64_t)(rec.data() - sizeof(uint64_t) - r.data);
+            }
+
+            pos = (uint64_t)r.size;
+            if (!SeekFile(file, pos))
+            {
+                error = L"Failed to seek in file '";
+                error.append(path);
+                error.append(L"'");
+                fclose(file);
+                file = nullptr;
+                return false;
+            }
+
+            return true;
+        }
+    }
+
+    file = OpenFile(path, L"wb");
+    if (!file)
+    {
+        error = L"Failed to create file '";
+        error.append(path);
+        error.append(L"'");
+        return false;
+    }
+
+    pos = 0;
+    uint32_t f = (uint32_t)format;
+    Write(headerMagic, sizeof(headerMagic));
+    Write(&f, sizeof(f));
+    return true;
+}
+
+bool RecordStreamWriter::Write(const void* p, size_t size)
+{
+    if (size && fwrite(p, 1, size, file) != size)
+        failed = true;
+
+    pos += size;
+    return !failed;
+}
+
+bool RecordStreamWriter::AppendEncoded(std::string_view record)
+{
+    if (!file)
+        return false;
+
+    offsets.push_back(pos);
+    uint64_t l = record.size();
+    Write(&l, sizeof(l));
+    return Write(record.data(), record.size());
+}
+
+bool RecordStreamWriter::Append(void* pclass, ClassTypeInfo& type)
+{
+    buf.clear();
+    serialize_to_buffer(buf, pclass, type, format);
+    return AppendEncoded(buf);
+}
+
+bool RecordStreamWriter::Close(std::wstring& error)
+{
+    if (!file)
+        return true;
+
+    if (offsets.size())
+        Write(offsets.data(), offsets.size() * sizeof(uint64_t));
+
+    uint64_t count = offsets.size();
+    Write(&count, sizeof(count));
+    Write(trailerMagic, sizeof(trailerMagic));
+
+    if (fclose(file) != 0)
+        failed = true;
+
+    file = nullptr;
+    if (failed)
+    {
+        error = L"Failed to write record stream";
+        return false;
+    }
+
+    return true;
+}
+
+bool RecordStreamReader::Open(const wchar_t* path, std::wstring& error)
+{
+    if (!file.OpenRead(path, error, false))
+        return false;
+
+    if (!Open(file.data, file.size, error))
+    {
+        error.append(L": ");
+        error.append(path);
+        file.Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool RecordStreamReader::Open(const void* buf, size_t len, std::wstring& error)
+{
+    data = (const char*)buf;
+    size = len;
+    index = nullptr;
+    count = 0;
+
+    if (len < headerSize + trailerSize || memcmp(data, headerMagic, sizeof(headerMagic)) != 0 ||
+        memcmp(data + len - sizeof(trailerMagic), trailerMagic, sizeof(trailerMagic)) != 0)
+    {
+        error = L"Not a record stream";
+        return false;
+    }
+
+    uint32_t f;
+    memcpy(&f, data + sizeof(headerMagic), sizeof(f));
+    uint64_t n = ReadU64(data + len - trailerSize);
+    if (n > (len - headerSize - trailerSize) / sizeof(uint64_t))
+    {
+        error = L"Record stream index is corrupted";
+        return false;
+    }
+
+    format = (int)f;
+    count = (size_t)n;
+    index = data + len - trailerSize - count * sizeof(uint64_t);
+    return true;
+}
+
+bool RecordStreamReader::GetRecord(size_t i, std::string_view& record) const
+{
+    if (i >= count)
+        return false;
+
+    // Records must lie between header and index
+    size_t limit = (size_t)(index - data);
+    uint64_t offset = ReadU64(index + i * sizeof(uint64_t));
+    if (offset < headerSize || offset > limit - sizeof(uint64_t))
+        return false;
+
+    uint64_t l = ReadU64(data + offset);
+    if (l > limit - sizeof(uint64_t) - offset)
+        return false;
+
+    record = std::string_view(data + offset + sizeof(uint64_t), (size_t)l);
+    return true;
+}
+
+bool RecordStreamReader::Read(size_t i, void* pclass, ClassTypeInfo& type) const
+{
+    std::string_view rec;
+    if (!GetRecord(i, rec))
+        return false;
+
+    const char* p = rec.data();
+    size_t left = rec.size();
+    return BinaryDataToNode(p, left, pclass, type, format) && left == 0;
+}
@@ -0,0 +1,206 @@
+#pragma once
+#include "cppreflect.h"
+#include "mappedfile.h"
+#include <string_view>
+#include <stdint.h>                         //uint64_t
+#include <stdio.h>                          //FILE
+
+//
+//  Record stream - container for many independently encoded class instances, with random access to any record.
+//
+//  File layout (integers in machine byte order):
+//
+//      header:     "CRS1" magic, uint32 binary format (EBinaryFormat flags used to encode records)
+//      records:    uint64 length, encoded record - repeated
+//      index:      uint64 offset of each record (pointing to its length)
+//      trailer:    uint64 record count, "CRSX" magic
+//
+//  Index is written when writer is closed. Appending writes new records, index and trailer after existing trailer
+//  (old index is left unused in between), so if appending fails, file prefix is still the original stream.
+//
+
+//
+//  Writes record stream file.
+//
+//  Usage:
+//
+//      RecordStreamWriter w;
+//      if (w.Open(L"records.bin", error))
+//      {
+//          for (Record& r: records)
+//              w.Append(r);
+//          w.Close(error);
+//      }
+//
+class RecordStreamWriter
+{
+public:
+    RecordStreamWriter()
+    {
+    }
+
+    ~RecordStreamWriter();
+
+    //
+    //  Creates new record stream file. If append is true and file exists, new records are added after
+    //  existing ones (format must match one used to create the file).
+    //
+    bool Open(const wchar_t* path, std::wstring& error, bool append = false, int format = binary_native);
+
+    //
+    //  Encodes and appends one record.
+    //
+    bool Append(void* pclass, ClassTypeInfo& type);
+
+    template <class T>
+    bool Append(T& t)
+    {
+        return Append(&t, T::GetType());
+    }
+
+    //
+    //  Appends already encoded record.
+    //
+    bool AppendEncoded(std::string_view record);
+
+    //
+    //  Amount of records in stream.
+    //
+    size_t Count() const
+    {
+        return offsets.size();
+    }
+
+    //
+    //  Writes index and closes file. Returns false if any write has failed.
+    //
+    bool Close(std::wstring& error);
+
+protected:
+    bool Write(const void* p, size_t size);
+
+    FILE* file = nullptr;
+    int format = binary_native;
+    bool failed = false;
+    uint64_t pos = 0;                       // Current file position
+    std::vector<uint64_t> offsets;
+    std::string buf;                        // Encoding buffer, reused between records
+
+    RecordStreamWriter(const RecordStreamWriter&) = delete;
+    RecordStreamWriter& operator=(const RecordStreamWriter&) = delete;
+};
+
+//
+//  Reads record stream file or buffer. Record lookup is O(1), records are not copied - file is memory mapped.
+//
+//  Usage:
+//
+//      RecordStreamReader r;
+//      Record rec;
+//      if (r.Open(L"records.bin", error) && r.Count() > 1000)
+//          r.Read(1000, rec);
+//
+class RecordStreamReader
+{
+public:
+    //
+    //  Iterates over encoded records.
+    //
+    class iterator
+    {
+    public:
+        iterator(const RecordStreamReader* _r, size_t _i) : r(_r), i(_i)
+        {
+        }
+
+        std::string_view operator*() const
+        {
+            std::string_view v;
+            r->GetRecord(i, v);
+            return v;
+        }
+
+        iterator& operator++()
+        {
+            i++;
+            return *this;
+        }
+
+        bool operator!=(const iterator& o) const
+        {
+            return i != o.i;
+        }
+
+        size_t Index() const
+        {
+            return i;
+        }
+
+    protected:
+        const RecordStreamReader* r;
+        size_t i;
+    };
+
+    //
+    //  Maps record stream file. Returns false and fills error if file is not a valid record stream.
+    //
+    bool Open(const wchar_t* path, std::wstring& error);
+
+    //
+    //  Opens record stream from memory buffer, buffer must outlive reader.
+    //
+    bool Open(const void* buf, size_t len, std::wstring& error);
+
+    size_t Count() const
+    {
+        return count;
+    }
+
+    //
+    //  Binary format of records.
+    //
+    int GetFormat() const
+    {
+        return format;
+    }
+
+    //
+    //  Gets encoded record i. Returns false if index is out of range or record is malformed.
+    //
+    bool GetRecord(size_t i, std::string_view& record) const;
+
+    //
+    //  Decodes record i.
+    //
+    bool Read(size_t i, void* pclass, ClassTypeInfo& type) const;
+
+    template <class T>
+    bool Read(size_t i, T& t) const
+    {
+        return Read(i, &t, T::GetType());
+    }
+
+    //
+    //  Range iteration over encoded records: for (std::string_view rec: reader) ...
+    //
+    iterator begin() const
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end() const
+    {
+        return iterator(this, count);
+    }
+
+protected:
+    friend class RecordStreamWriter;
+
+    MappedFile file;
+    const char* data = nullptr;
+    size_t size = 0;
+    const char* index = nullptr;            // Offset table
+    size_t count = 0;
+    int format = binary_native;
+};
+
@@ -1,6 +1,9 @@
 #pragma once
 #include <vector>
 #include <string>                       //std::vector
+#include <memory_resource>              //std::pmr::memory_resource
+#include <new>                          //placement new
+#include <algorithm>                    //rotate
 #include "enumreflect.h"                //EnumToString
 #include "pugixml/pugixml.hpp"          //as_wide, as_utf8
 #ifndef _MSC_VER
@@ -16,6 +19,60 @@ class ClassTypeInfo;
 class ReflectClass;
 
 
+//
+//  Memory resource which std::pmr fields (std::pmr::string, std::pmr::vector) decoded on this thread allocate from,
+//  nullptr - fields keep their own allocator. Set by DecodeResourceScope.
+//
+inline thread_local std::pmr::memory_resource* currentDecodeResource = nullptr;
+
+//
+//  Makes std::pmr fields decoded on this thread within scope allocate from given resource, for example:
+//
+//      std::pmr::monotonic_buffer_resource arena;
+//      DecodeResourceScope scope(&arena);
+//      decoder.Feed(buf, n);
+//
+//  Decoded instance must be destroyed before resource is released.
+//
+class DecodeResourceScope
+{
+public:
+    DecodeResourceScope(std::pmr::memory_resource* resource): prev(currentDecodeResource)
+    {
+        currentDecodeResource = resource;
+    }
+
+    ~DecodeResourceScope()
+    {
+        currentDecodeResource = prev;
+    }
+
+protected:
+    std::pmr::memory_resource* prev;
+};
+
+//
+//  Moves std::pmr container to current decode resource. Allocator of std::pmr container does not propagate on
+//  assignment, so container is recreated empty - to be used only before container is resized for decoding.
+//
+template <class T>
+void UseDecodeResource(T* p)
+{
+    std::pmr::memory_resource* resource = currentDecodeResource;
+    if (resource && p->get_allocator().resource() != resource)
+    {
+        p->~T();
+        new (p) T(resource);
+    }
+}
+
+// std::vector always allocates from std::allocator
+template <class E>
+void UseDecodeResource(std::vector<E>*)
+{
+}
+
+
 template <class T>
 std::string getTypeName()
 {
@@ -220,6 +277,58 @@ public:
 };
 
 
+//
+//  std::pmr::string - same as std::string, storage is moved to current decode resource (see DecodeResourceScope)
+//  before it's assigned or resized.
+//
+template <>
+class BasicTypeInfoT<std::pmr::string> : public BasicTypeInfo
+{
+public:
+    virtual std::string name() { return "string"; }
+
+    virtual std::wstring ToString(void* pField)
+    {
+        return pugi::as_wide(((std::pmr::string*)pField)->c_str());
+    }
+
+    virtual void FromString(void* pField, const wchar_t* value)
+    {
+        auto& s = *((std::pmr::string*)pField);
+        UseDecodeResource(&s);
+        std::string utf8 = pugi::as_utf8(value);
+        s.assign(utf8.data(), utf8.size());
+    }
+
+    virtual void* GetRawPtr(void* pField)
+    {
+        return (char*)((std::pmr::string*)pField)->data();
+    }
+
+    virtual size_t GetRawSize(void* pField)
+    {
+        return ((std::pmr::string*)pField)->length();
+    }
+
+    virtual void SetRawSize(void* pField, size_t size)
+    {
+        auto s = (std::pmr::string*)pField;
+        UseDecodeResource(s);
+        s->resize(size);
+    }
+
+    virtual size_t GetFixedSize()
+    {
+        return 0;
+    }
+
+    virtual size_t GetSizeOfType()
+    {
+        return sizeof(std::pmr::string);
+    }
+};
+
+
 template <>
 class BasicTypeInfoT<int> : public BasicTypeInfo
 {
@@ -385,10 +494,16 @@ public:
 };
 
 
-template <class E>
-class BasicTypeInfoT< std::vector<E> > : public BasicTypeInfo
+//
+//  std::vector and std::pmr::vector. Storage of std::pmr::vector is moved to current decode resource (see
+//  DecodeResourceScope) before it's resized, its std::pmr::string elements follow the vector allocator.
+//
+template <class E, class A>
+class BasicTypeInfoT< std::vector<E, A> > : public BasicTypeInfo
 {
 public:
+    typedef std::vector<E, A> Vector;
+
     std::shared_ptr<BasicTypeInfo> elementType;
 
     BasicTypeInfoT()
@@ -398,7 +513,7 @@ public:
 
     virtual std::string name()
     {
-        return getTypeName<std::vector<E>>();
+        return getTypeName<Vector>();
     }
 
     virtual bool GetArrayElementType(BasicTypeInfo*& type)
@@ -419,22 +534,38 @@ public:
     
     virtual size_t ArraySize( void* p )
     {
-        std::vector<E>* v = (std::vector<E>*) p;
+        Vector* v = (Vector*) p;
         return v->size();
     }
 
     virtual void SetArraySize( void* p, size_t size )
     {
-        std::vector<E>* v = (std::vector<E>*) p;
+        Vector* v = (Vector*) p;
+        UseDecodeResource(v);
         v->resize(size);
     }
 
     virtual void* ArrayElement( void* p, size_t i )
     {
-        std::vector<E>* v = (std::vector<E>*) p;
+        Vector* v = (Vector*) p;
         return &v->at( i );
     }
 
+    virtual void InsertArrayElements(void* p, size_t i, size_t count)
+    {
+        // Appended and rotated into place, so element type needs to be movable only
+        Vector* v = (Vector*)p;
+        size_t size = v->size();
+        v->resize(size + count);
+        std::rotate(v->begin() + i, v->begin() + size, v->end());
+    }
+
+    virtual void EraseArrayElements(void* p, size_t i, size_t count)
+    {
+        Vector* v = (Vector*)p;
+        v->erase(v->begin() + i, v->begin() + i + count);
+    }
+
     virtual std::wstring ToString(void*)
     {
         return std::wstring();
@@ -442,7 +573,7 @@ public:
 
     virtual void* GetRawPtr(void* p)
     {
-        std::vector<E>* v = (std::vector<E>*)p;
+        Vector* v = (Vector*)p;
 
         if (v->empty())
             return nullptr;
@@ -452,14 +583,15 @@ public:
 
     virtual size_t GetRawSize(void* p)
     {
-        std::vector<E>* v = (std::vector<E>*)p;
+        Vector* v = (Vector*)p;
         return sizeof(E) * v->size();
     }
 
     virtual void SetRawSize(void* p, size_t size)
     {
-        std::vector<E>* v = (std::vector<E>*)p;
+        Vector* v = (Vector*)p;
         size_t count = size / sizeof(E);
+        UseDecodeResource(v);
         v->resize(count);
     }
 
@@ -470,7 +602,7 @@ public:
 
     virtual size_t GetSizeOfType()
     {
-        return sizeof( std::vector<E> );
+        return sizeof(Vector);
     }
 };
 
@@ -1,5 +1,18 @@
 #include "cppreflect/cppreflect.h"
+#include "cppreflect/binaryplan.h"
+#include "cppreflect/binarydecoder.h"
+#include "cppreflect/binaryview.h"
+#include "cppreflect/recordstream.h"
+#include "cppreflect/compression.h"
+#include "cppreflect/decodepool.h"
+#include "cppreflect/binaryprojection.h"
+#include "cppreflect/binarylocator.h"
+#include "cppreflect/binarypatch.h"
 #include <chrono>
+#include <fstream>
+#include <limits.h>
+#include <sstream>
+#include <thread>
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
@@ -41,6 +54,322 @@ public:
     );
 };
 
+class Address : public ReflectClassT<Address>
+{
+public:
+    REFLECTABLE(Address,
+        (int) zip,
+        (bool) verified,
+        (wstring) street,
+        (std::vector<wstring>) lines
+    )
+};
+
+class Company : public ReflectClassT<Company>
+{
+public:
+    REFLECTABLE(Company,
+        (int) id,
+        (Address) office,
+        (int) employees,
+        (vector<Address>) branches,
+        (vector<Person>) staff
+    )
+};
+
+//
+//  Two versions of same data, for binary schema evolution tests.
+//
+class MemberV1 : public ReflectClassT<MemberV1>
+{
+public:
+    REFLECTABLE(MemberV1,
+        (wstring) name,
+        (int) age,
+        (vector<string>) hobbies,
+        (Address) home
+    )
+};
+
+class TeamV1 : public ReflectClassT<TeamV1>
+{
+public:
+    REFLECTABLE(TeamV1,
+        (string) title,
+        (vector<MemberV1>) members,
+        (MemberV1) lead
+    )
+};
+
+class MemberV2 : public ReflectClassT<MemberV2>
+{
+public:
+    REFLECTABLE(MemberV2,
+        (int) age,
+        (double) salary,
+        (wstring) name,
+        (Address) home,
+        (string) hobbies
+    )
+};
+
+class TeamV2 : public ReflectClassT<TeamV2>
+{
+public:
+    REFLECTABLE(TeamV2,
+        (int) rank,
+        (MemberV2) lead,
+        (vector<MemberV2>) members
+    )
+};
+
+//
+//  Same field names and sizes, but other field types.
+//
+class ScoreV1 : public ReflectClassT<ScoreV1>
+{
+public:
+    REFLECTABLE(ScoreV1,
+        (int) score,
+        (EGender) gender,
+        (vector<int>) history
+    )
+};
+
+class ScoreV2 : public ReflectClassT<ScoreV2>
+{
+public:
+    REFLECTABLE(ScoreV2,
+        (float) score,
+        (int) gender,
+        (vector<float>) history
+    )
+};
+
+//
+//  Deeply nested classes, alternating nested class and array of classes.
+//
+class Deep0 : public ReflectClassT<Deep0>
+{
+public:
+    REFLECTABLE(Deep0,
+        (vector<string>) strings
+    )
+};
+
+class Deep1 : public ReflectClassT<Deep1>
+{
+public:
+    REFLECTABLE(Deep1,
+        (int) level,
+        (Deep0) inner
+    )
+};
+
+class Deep2 : public ReflectClassT<Deep2>
+{
+public:
+    REFLECTABLE(Deep2,
+        (int) level,
+        (vector<Deep1>) inner
+    )
+};
+
+class Deep3 : public ReflectClassT<Deep3>
+{
+public:
+    REFLECTABLE(Deep3,
+        (int) level,
+        (Deep2) inner
+    )
+};
+
+class Deep4 : public ReflectClassT<Deep4>
+{
+public:
+    REFLECTABLE(Deep4,
+        (int) level,
+        (vector<Deep3>) inner
+    )
+};
+
+class Deep5 : public ReflectClassT<Deep5>
+{
+public:
+    REFLECTABLE(Deep5,
+        (int) level,
+        (Deep4) inner
+    )
+};
+
+class Deep6 : public ReflectClassT<Deep6>
+{
+public:
+    REFLECTABLE(Deep6,
+        (int) level,
+        (vector<Deep5>) inner
+    )
+};
+
+class Deep7 : public ReflectClassT<Deep7>
+{
+public:
+    REFLECTABLE(Deep7,
+        (int) level,
+        (Deep6) inner
+    )
+};
+
+class Deep8 : public ReflectClassT<Deep8>
+{
+public:
+    REFLECTABLE(Deep8,
+        (int) level,
+        (vector<Deep7>) inner
+    )
+};
+
+class Deep9 : public ReflectClassT<Deep9>
+{
+public:
+    REFLECTABLE(Deep9,
+        (int) level,
+        (Deep8) inner
+    )
+};
+
+class Deep10 : public ReflectClassT<Deep10>
+{
+public:
+    REFLECTABLE(Deep10,
+        (int) level,
+        (vector<Deep9>) inner
+    )
+};
+
+//
+//  Address with fields appended, for tagged format tests.
+//
+class AddressExt : public ReflectClassT<AddressExt>
+{
+public:
+    REFLECTABLE(AddressExt,
+        (int) zip,
+        (bool) verified,
+        (wstring) street,
+        (std::vector<wstring>) lines,
+        (vector<Person>) residents,
+        (Address) mail,
+        (double) latitude
+    )
+};
+
+//
+//  Same as Person / People, allocating from std::pmr::memory_resource.
+//
+class PmrPerson : public ReflectClassT<PmrPerson>
+{
+public:
+    REFLECTABLE(PmrPerson,
+        (std::pmr::string) name,
+        (int) age,
+        (std::pmr::vector<int>) childrenAges,
+        (std::pmr::vector<std::pmr::string>) hobbies
+    )
+};
+
+class PmrPeople : public ReflectClassT<PmrPeople>
+{
+public:
+    REFLECTABLE(PmrPeople,
+        (std::pmr::string) groupName,
+        (std::pmr::vector<PmrPerson>) people
+    )
+};
+
+//
+//  Counts allocations passed to upstream resource.
+//
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    size_t allocations = 0;
+
+protected:
+    virtual void* do_allocate(size_t bytes, size_t alignment)
+    {
+        allocations++;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    virtual void do_deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+    {
+        return this == &other;
+    }
+};
+
+//
+//  Forwards to other resource, counts allocations made by threads other than the one which created it.
+//
+class ThreadCheckingResource : public std::pmr::memory_resource
+{
+public:
+    ThreadCheckingResource(std::pmr::memory_resource& _target) : target(_target)
+    {
+    }
+
+    std::atomic<size_t> allocations{ 0 };
+    std::atomic<size_t> otherThreadAllocations{ 0 };
+
+protected:
+    virtual void* do_allocate(size_t bytes, size_t alignment)
+    {
+        allocations++;
+        if (std::this_thread::get_id() != owner)
+            otherThreadAllocations++;
+        return target.allocate(bytes, alignment);
+    }
+
+    virtual void do_deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        target.deallocate(p, bytes, alignment);
+    }
+
+    virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+    {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource& target;
+    std::thread::id owner = std::this_thread::get_id();
+};
+
+//
+//  Generates sample data for binary encoding tests.
+//
+static void MakePeople(People& ppl, int count)
+{
+    ppl.groupName = "Generated";
+    ppl.people.resize(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        Person& p = ppl.people[i];
+        p.name = L"Person" + to_wstring(i);
+        p.gender = (i % 2) ? gender_female : gender_male;
+        p.age = i % 90;
+        p.isAdult = p.age >= 18;
+        for (int j = 0; j < i % 4; j++)
+            p.childrenAges.push_back(j * 2 + 1);
+        p.hobbies.push_back((i % 3) ? "reading books" : "fishing");
+    }
+}
+
 #define TEST_SET1
 #define TEST_SET2
 
@@ -128,6 +457,2071 @@ TEST_CASE("doCppReflectionTest")
 
 }
 
+TEST_CASE("binaryPlanTest")
+{
+    Company c;
+    c.id = 7;
+    c.employees = 3;
+    c.office.zip = 12345;
+    c.office.verified = true;
+    c.office.street = L"Main street";
+    c.office.lines.push_back(L"floor 2");
+    c.employees = 3;
+    c.branches.resize(2);
+    c.branches[1].zip = 54321;
+    c.branches[1].lines.push_back(L"");
+    c.staff.resize(1);
+    c.staff[0].name = L"Bob";
+    c.staff[0].childrenAges.push_back(4);
+
+    ClassTypeInfo& CompanyType = Company::GetType();
+    BinaryPlan& plan = GetBinaryPlan(CompanyType);
+
+    // id is not adjacent to office.zip (ReflectClass base in between), so first op is id alone.
+    REQUIRE(plan.ops.size() > 0);
+    REQUIRE(plan.ops[0].kind == binop_copy);
+    REQUIRE(&plan == &GetBinaryPlan(CompanyType));
+
+    string s;
+    serialize_to_buffer(s, &c, CompanyType);
+    REQUIRE(s.size() == getEncodedSize64(&c, CompanyType));
+
+    Company c2;
+    REQUIRE(parse_from_buffer(&s[0], s.size(), &c2, CompanyType));
+    REQUIRE(as_xml(&c, CompanyType) == as_xml(&c2, CompanyType));
+
+    // Truncated buffer must fail, not crash.
+    for (size_t len = 0; len < s.size(); len++)
+    {
+        Company c3;
+        REQUIRE(!parse_from_buffer(&s[0], (int)len, &c3, CompanyType));
+    }
+
+    // Any integer type of length selects one overload, negative int length is malformed
+    Company c4;
+    REQUIRE(parse_from_buffer(&s[0], (unsigned)s.size(), &c4, CompanyType));
+    REQUIRE(parse_from_buffer(&s[0], (uint64_t)s.size(), &c4, CompanyType));
+    REQUIRE(!parse_from_buffer(&s[0], -1, &c4, CompanyType));
+}
+
+TEST_CASE("binaryWriterTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+    size_t size = getEncodedSize64(&ppl, PeopleType);
+
+    // Starts from empty string, requires several chained chunks.
+    string s;
+    serialize_to_buffer(s, &ppl, PeopleType);
+    REQUIRE(s.size() == size);
+
+    // Reused string - encoded into existing capacity.
+    const char* data = s.data();
+    serialize_to_buffer(s, &ppl, PeopleType);
+    REQUIRE(s.size() == size);
+    REQUIRE(s.data() == data);
+
+    People ppl2;
+    REQUIRE(parse_from_buffer(&s[0], s.size(), &ppl2, PeopleType));
+    REQUIRE(as_xml(&ppl, PeopleType) == as_xml(&ppl2, PeopleType));
+
+    // Small message into string with large capacity - grown in place, only as far as needed.
+    People small;
+    MakePeople(small, 3);
+    string sm;
+    sm.reserve(size);
+    data = sm.data();
+    serialize_to_buffer(sm, &small, PeopleType);
+    REQUIRE(sm.size() == getEncodedSize64(&small, PeopleType));
+    REQUIRE(sm.data() == data);
+    People small2;
+    REQUIRE(parse_from_buffer(sm, &small2, PeopleType));
+    REQUIRE(as_xml(&small, PeopleType) == as_xml(&small2, PeopleType));
+
+    // Standalone writer with size hint, smaller than needed.
+    BinaryBufferWriter w(100);
+    serialize_to_buffer(w, &ppl, PeopleType);
+    REQUIRE(w.Size() == size);
+    string s2(w.Size(), 0);
+    w.CopyTo(&s2[0]);
+    REQUIRE(s == s2);
+
+    // Fixed buffer, too small.
+    string s3(10, 0);
+    BinaryMemoryWriter mw(&s3[0], s3.size());
+    serialize_to_buffer(mw, &ppl, PeopleType);
+    REQUIRE(mw.overflow);
+    REQUIRE(mw.Size() == size);
+    REQUIRE(s3 == s.substr(0, 10));
+}
+
+TEST_CASE("binarySizeTest")
+{
+    Record r;
+    r.ids.push_back(5);
+    r.strings.push_back("abc");
+    ClassTypeInfo& RecordType = Record::GetType();
+
+    string s;
+    serialize_to_buffer(s, &r, RecordType);
+    REQUIRE(getEncodedSize(&r, RecordType) == (int)s.size());
+
+    // Legacy int based API.
+    string s2(s.size(), 0);
+    char* p = &s2[0];
+    int len = 0;
+    NodeToBinaryData(p, &len, &r, RecordType);
+    REQUIRE(len == (int)s.size());
+    REQUIRE(p == &s2[0] + s2.size());
+    REQUIRE(s == s2);
+
+    // Accumulated length would not fit into int.
+    p = nullptr;
+    len = INT_MAX - 1;
+    NodeToBinaryData(p, &len, &r, RecordType);
+    REQUIRE(len == -1);
+
+    Record r2;
+    REQUIRE(!parse_from_buffer(s.data(), -1, &r2, RecordType));
+    REQUIRE(parse_from_buffer(std::string_view(s), &r2, RecordType));
+    REQUIRE(r2.ids == r.ids);
+    REQUIRE(r2.strings == r.strings);
+
+    // Element count which would overflow size_t when multiplied by element size.
+    size_t hostile = ~(size_t)0 / 4;
+    memcpy(&s[0], &hostile, sizeof(size_t));
+    REQUIRE(!parse_from_buffer(s.data(), s.size(), &r2, RecordType));
+}
+
+TEST_CASE("binaryVarintTest")
+{
+    People ppl;
+    MakePeople(ppl, 100);
+    ClassTypeInfo& PeopleType = People::GetType();
+
+    string native, compact;
+    serialize_to_buffer(native, &ppl, PeopleType);
+    serialize_to_buffer(compact, &ppl, PeopleType, binary_varint);
+    REQUIRE(compact.size() < native.size());
+    REQUIRE(compact.size() == getEncodedSize64(&ppl, PeopleType, binary_varint));
+
+    People ppl2;
+    REQUIRE(parse_from_buffer(compact.data(), compact.size(), &ppl2, PeopleType, binary_varint));
+    REQUIRE(as_xml(&ppl, PeopleType) == as_xml(&ppl2, PeopleType));
+
+    // Lengths around varint byte boundaries, last string is decoded near end of buffer (byte by byte path).
+    Record r;
+    ClassTypeInfo& RecordType = Record::GetType();
+    for (size_t len : { 0, 1, 127, 128, 255, 16383, 16384, 70000, 3 })
+        r.strings.push_back(string(len, 'x'));
+
+    string s;
+    serialize_to_buffer(s, &r, RecordType, binary_varint);
+    Record r2;
+    REQUIRE(parse_from_buffer(s.data(), s.size(), &r2, RecordType, binary_varint));
+    REQUIRE(r2.strings == r.strings);
+    REQUIRE(!parse_from_buffer(s.data(), s.size() - 4, &r2, RecordType, binary_varint));
+}
+
+TEST_CASE("binaryStreamWriterTest")
+{
+    People ppl;
+    MakePeople(ppl, 200);
+    ppl.people[10].hobbies.push_back(string(1000, 'h'));     // Bigger than stream buffer
+    ClassTypeInfo& PeopleType = People::GetType();
+
+    string expected;
+    serialize_to_buffer(expected, &ppl, PeopleType, binary_varint);
+
+    // Callback
+    string s;
+    size_t maxChunk = 0;
+    {
+        BinaryCallbackWriter w([&](const void* p, size_t size)
+        {
+            s.append((const char*)p, size);
+            maxChunk = std::max(maxChunk, size);
+            return true;
+        }, 256);
+
+        serialize_to_buffer(w, &ppl, PeopleType, binary_varint);
+        REQUIRE(w.Flush());
+        REQUIRE(w.Size() == expected.size());
+    }
+    REQUIRE(s == expected);
+    REQUIRE(maxChunk > 256);
+
+    // std::ostream
+    std::stringstream ss;
+    {
+        BinaryOstreamWriter w(ss, 100);
+        serialize_to_buffer(w, &ppl, PeopleType, binary_varint);
+    }
+    REQUIRE(ss.str() == expected);
+
+    // FILE* and file descriptor
+    FILE* f = tmpfile();
+    REQUIRE(f != nullptr);
+    {
+        BinaryFileWriter w(f);
+        serialize_to_buffer(w, &ppl, PeopleType, binary_varint);
+        REQUIRE(w.Flush());
+    }
+    {
+        BinaryFdWriter w(fileno(f), 1000);
+        serialize_to_buffer(w, &ppl, PeopleType, binary_varint);
+        REQUIRE(w.Flush());
+    }
+    string s2(expected.size() * 2, 0);
+    rewind(f);
+    REQUIRE(fread(&s2[0], 1, s2.size(), f) == s2.size());
+    fclose(f);
+    REQUIRE(s2 == expected + expected);
+
+    // Failing destination
+    BinaryCallbackWriter fw([](const void*, size_t) { return false; }, 64);
+    serialize_to_buffer(fw, &ppl, PeopleType);
+    REQUIRE(!fw.Flush());
+}
+
+TEST_CASE("binaryPushDecoderTest")
+{
+    People ppl;
+    MakePeople(ppl, 50);
+    ClassTypeInfo& PeopleType = People::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    for (int format : { (int)binary_native, (int)binary_varint })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+
+        for (size_t chunk : { 1, 3, 7, 64, 100000 })
+        {
+            People ppl2;
+            BinaryPushDecoder decoder(&ppl2, PeopleType, format);
+            EDecodeStatus status = decode_need_more;
+
+            for (size_t pos = 0; pos < s.size(); pos += chunk)
+            {
+                REQUIRE(status == decode_need_more);
+                status = decoder.Feed(&s[pos], std::min(chunk, s.size() - pos));
+            }
+
+            REQUIRE(status == decode_done);
+            REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+        }
+
+        // Two messages back to back - decoding stops at end of first one.
+        string two = s + s;
+        People ppl3;
+        size_t consumed;
+        BinaryPushDecoder decoder(&ppl3, PeopleType, format);
+        REQUIRE(decoder.Feed(two.data(), two.size(), &consumed) == decode_done);
+        REQUIRE(consumed == s.size());
+    }
+
+    // wstring length which is not multiple of wchar_t
+    Address a;
+    a.street = L"x";
+    string s;
+    serialize_to_buffer(s, &a, Address::GetType());
+    size_t bad = 3;
+    memcpy(&s[sizeof(int) + sizeof(bool)], &bad, sizeof(size_t));
+    Address a2;
+    BinaryPushDecoder decoder(&a2, Address::GetType());
+    REQUIRE(decoder.Feed(s.data(), s.size()) == decode_error);
+}
+
+TEST_CASE("binaryViewTest")
+{
+    People ppl;
+    MakePeople(ppl, 20);
+    ppl.people[5].childrenAges = { 4, 8, 15 };
+    ClassTypeInfo& PeopleType = People::GetType();
+    ClassTypeInfo& PersonType = Person::GetType();
+
+    for (int format : { (int)binary_native, (int)binary_varint })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+
+        BinaryView v;
+        REQUIRE(v.Parse(s.data(), s.size(), PeopleType, format));
+        REQUIRE(v.GetString(PeopleType.GetFieldIndex("groupName")) == "Generated");
+
+        int peopleIndex = PeopleType.GetFieldIndex("people");
+        REQUIRE(v.ArraySize(peopleIndex) == 20);
+        vector<BinaryView> people = v.GetObjects(peopleIndex);
+        REQUIRE(people.size() == 20);
+
+        BinaryView& p = people[5];
+        REQUIRE(p.GetWString(PersonType.GetFieldIndex("name")) == L"Person5");
+        REQUIRE(p.Get<int>(PersonType.GetFieldIndex("age")) == 5);
+        REQUIRE(p.Get<EGender>(PersonType.GetFieldIndex("gender")) == gender_female);
+
+        BinaryArrayView<int> ages = p.GetArray<int>(PersonType.GetFieldIndex("childrenAges"));
+        REQUIRE(ages.size() == 3);
+        REQUIRE(ages[2] == 15);
+
+        vector<string_view> hobbies = p.GetStrings(PersonType.GetFieldIndex("hobbies"));
+        REQUIRE(hobbies.size() == 1);
+        REQUIRE(hobbies[0] == ppl.people[5].hobbies[0]);
+
+        // Points directly into source buffer
+        REQUIRE(hobbies[0].data() >= s.data());
+        REQUIRE(hobbies[0].data() < s.data() + s.size());
+
+        REQUIRE(!v.Parse(s.data(), s.size() - 1, PeopleType, format));
+    }
+
+    Company c;
+    c.office.street = L"Elm";
+    c.office.zip = 777;
+    string s;
+    serialize_to_buffer(s, &c, Company::GetType());
+    BinaryView v;
+    REQUIRE(v.Parse(s.data(), s.size(), Company::GetType()));
+    BinaryView office = v.GetObject(Company::GetType().GetFieldIndex("office"));
+    REQUIRE(office.Get<int>(Address::GetType().GetFieldIndex("zip")) == 777);
+    REQUIRE(office.GetWString(Address::GetType().GetFieldIndex("street")) == L"Elm");
+
+    // Elements behind offset table are validated: groupName, people count, offset table, first name length
+    People two;
+    MakePeople(two, 2);
+    string os;
+    serialize_to_buffer(os, &two, People::GetType(), binary_offsets);
+    size_t nameLength = 5000;
+    memcpy(&os[sizeof(size_t) + two.groupName.size() + 2 * sizeof(size_t)], &nameLength, sizeof(nameLength));
+    BinaryView ov;
+    REQUIRE(!ov.Parse(os.data(), os.size(), People::GetType(), binary_offsets));
+
+    // Out of range fields
+    REQUIRE(v.Get<int>(-1) == 0);
+    REQUIRE(v.Get<int>(100) == 0);
+    REQUIRE(v.GetBytes(100).empty());
+    REQUIRE(v.GetWString(100).empty());
+    REQUIRE(v.ArraySize(100) == 0);
+    REQUIRE(v.GetArray<int>(100).empty());
+    REQUIRE(v.GetValues<int>(100).empty());
+    REQUIRE(v.GetStrings(100).empty());
+    REQUIRE(v.GetObject(100).GetType() == nullptr);
+    REQUIRE(v.GetObjects(100).empty());
+    REQUIRE(v.GetColumn<int>(100, 0).empty());
+
+    // Malformed element content of tagged array is found only when element is parsed
+    string ts;
+    serialize_to_buffer(ts, &two, People::GetType(), binary_tagged);
+    string name((const char*)L"Person1", 7 * sizeof(wchar_t));
+    size_t pos = ts.find(name);
+    REQUIRE(pos != string::npos);
+    ts[pos - 2] = 7;                            // Name tag with invalid wire type
+    BinaryView tv;
+    REQUIRE(tv.Parse(ts.data(), ts.size(), People::GetType(), binary_tagged));
+    vector<BinaryView> people = tv.GetObjects(People::GetType().GetFieldIndex("people"));
+    REQUIRE(people.size() == 1);
+    REQUIRE(people[0].GetWString(Person::GetType().GetFieldIndex("name")) == L"Person0");
+}
+
+TEST_CASE("binaryFileTest")
+{
+    People ppl;
+    MakePeople(ppl, 100);
+    ClassTypeInfo& PeopleType = People::GetType();
+    wstring error;
+
+    for (int format : { (int)binary_native, (int)binary_varint })
+    {
+        REQUIRE(SaveToBinaryFile(L"people.bin", &ppl, PeopleType, error, format));
+
+        People ppl2;
+        REQUIRE(LoadFromBinaryFile(L"people.bin", &ppl2, PeopleType, error, format));
+        REQUIRE(as_xml(&ppl, PeopleType) == as_xml(&ppl2, PeopleType));
+    }
+
+    People empty;
+    REQUIRE(SaveToBinaryFile(L"people.bin", &empty, PeopleType, error));
+    REQUIRE(LoadFromBinaryFile(L"people.bin", &ppl, PeopleType, error));
+    REQUIRE(ppl.people.size() == 0);
+
+    REQUIRE(!LoadFromBinaryFile(L"no_such_file.bin", &ppl, PeopleType, error));
+    REQUIRE(error.find(L"no_such_file.bin") != wstring::npos);
+    remove("people.bin");
+}
+
+TEST_CASE("recordStreamTest")
+{
+    wstring error;
+    RecordStreamWriter w;
+    REQUIRE(w.Open(L"records.bin", error, false, binary_varint));
+
+    for (int i = 0; i < 1000; i++)
+    {
+        Record r;
+        r.ids.assign(i % 7, i);
+        r.strings.push_back(std::to_string(i));
+        REQUIRE(w.Append(r));
+    }
+    REQUIRE(w.Close(error));
+
+    string original;
+    {
+        ifstream in("records.bin", ios::binary);
+        original.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    // Add more records to existing stream
+    REQUIRE(w.Open(L"records.bin", error, true, binary_varint));
+    Record last;
+    last.strings.push_back("last");
+    REQUIRE(w.Append(last));
+    REQUIRE(w.Count() == 1001);
+    REQUIRE(w.Close(error));
+    REQUIRE(!w.Open(L"records.bin", error, true, binary_native));
+
+    RecordStreamReader r;
+    REQUIRE(r.Open(L"records.bin", error));
+    REQUIRE(r.Count() == 1001);
+
+    Record rec;
+    REQUIRE(r.Read(500, rec));
+    REQUIRE(rec.ids.size() == 500 % 7);
+    REQUIRE(rec.ids[0] == 500);
+    REQUIRE(rec.strings[0] == "500");
+    REQUIRE(r.Read(1000, rec));
+    REQUIRE(rec.strings[0] == "last");
+    REQUIRE(!r.Read(1001, rec));
+
+    size_t n = 0;
+    for (string_view v : r)
+    {
+        REQUIRE(v.size() != 0);
+        n++;
+    }
+    REQUIRE(n == 1001);
+
+    // In-memory stream, truncated index
+    string s;
+    {
+        ifstream in("records.bin", ios::binary);
+        s.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    RecordStreamReader r2;
+    REQUIRE(r2.Open(s.data(), s.size(), error));
+    REQUIRE(r2.Read(999, rec));
+    REQUIRE(rec.strings[0] == "999");
+    REQUIRE(!r2.Open(s.data(), s.size() - 1, error));
+
+    // Appending keeps original stream as file prefix
+    REQUIRE(s.compare(0, original.size(), original) == 0);
+    REQUIRE(r2.Open(s.data(), original.size(), error));
+    REQUIRE(r2.Count() == 1000);
+
+    // Stream with corrupted index cannot be appended to
+    uint64_t badOffset = original.size();
+    memcpy(&original[original.size() - 12 - 1000 * sizeof(uint64_t)], &badOffset, sizeof(badOffset));
+    {
+        ofstream out("records.bin", ios::binary);
+        out.write(original.data(), original.size());
+    }
+    REQUIRE(!w.Open(L"records.bin", error, true, binary_varint));
+
+    remove("records.bin");
+}
+
+TEST_CASE("binaryParallelEncodeTest")
+{
+    People ppl;
+    MakePeople(ppl, 5000);
+    ClassTypeInfo& PeopleType = People::GetType();
+
+    for (int format : { (int)binary_native, (int)binary_varint })
+    {
+        string s1, s2;
+        serialize_to_buffer(s1, &ppl, PeopleType, format);
+        serialize_to_buffer_parallel(s2, &ppl, PeopleType, format, 4);
+        REQUIRE(s1 == s2);
+
+        // Writer without contiguous space
+        string s3;
+        BinaryCallbackWriter w([&](const void* p, size_t size)
+        {
+            s3.append((const char*)p, size);
+            return true;
+        }, 1024);
+        serialize_to_buffer_parallel(w, &ppl, PeopleType, format, 4);
+        w.Flush();
+        REQUIRE(s1 == s3);
+    }
+
+    // Nested arrays
+    Company c;
+    c.branches.resize(1000);
+    for (size_t i = 0; i < c.branches.size(); i++)
+        c.branches[i].street = to_wstring(i);
+    MakePeople(ppl, 600);
+    c.staff = ppl.people;
+
+    string s1, s2;
+    serialize_to_buffer(s1, &c, Company::GetType());
+    s2.reserve(s1.size());
+    serialize_to_buffer_parallel(s2, &c, Company::GetType());
+    REQUIRE(s1 == s2);
+}
+
+TEST_CASE("binaryParallelDecodeTest")
+{
+    Company c;
+    c.branches.resize(300);
+    People ppl;
+    MakePeople(ppl, 1000);
+    c.staff = ppl.people;
+    ClassTypeInfo& CompanyType = Company::GetType();
+    wstring xml = as_xml(&c, CompanyType);
+
+    for (int format : { (int)binary_offsets, (int)(binary_offsets | binary_varint) })
+    {
+        string s, s2;
+        serialize_to_buffer(s, &c, CompanyType, format);
+        serialize_to_buffer_parallel(s2, &c, CompanyType, format, 4);
+        REQUIRE(s == s2);
+
+        Company c2;
+        REQUIRE(parse_from_buffer_parallel(s.data(), s.size(), &c2, CompanyType, format, 4));
+        REQUIRE(as_xml(&c2, CompanyType) == xml);
+
+        Company c3;
+        REQUIRE(parse_from_buffer(s, &c3, CompanyType, format));
+        REQUIRE(as_xml(&c3, CompanyType) == xml);
+
+        Company c4;
+        BinaryPushDecoder decoder(&c4, CompanyType, format);
+        for (size_t i = 0; i < s.size(); i += 7)
+            decoder.Feed(s.data() + i, min((size_t)7, s.size() - i));
+        REQUIRE(decoder.GetStatus() == decode_done);
+        REQUIRE(as_xml(&c4, CompanyType) == xml);
+
+        BinaryView v;
+        REQUIRE(v.Parse(s.data(), s.size(), CompanyType, format));
+        vector<BinaryView> staff = v.GetObjects(CompanyType.GetFieldIndex("staff"));
+        REQUIRE(staff.size() == 1000);
+        REQUIRE(staff[999].Get<int>(Person::GetType().GetFieldIndex("age")) == c.staff[999].age);
+
+        // Truncated data and corrupted table
+        REQUIRE(!parse_from_buffer_parallel(s.data(), s.size() - 1, &c2, CompanyType, format, 4));
+    }
+
+    // groupName, people count, first offset table entry
+    MakePeople(ppl, 200);
+    string s;
+    serialize_to_buffer(s, &ppl, People::GetType(), binary_offsets);
+    size_t tablePos = sizeof(size_t) + ppl.groupName.length() + sizeof(size_t);
+    size_t l;
+    memcpy(&l, &s[tablePos], sizeof(l));
+    size_t firstBlock = 0;
+    for (int i = 0; i < 64; i++)
+        firstBlock += getEncodedSize64(&ppl.people[i], Person::GetType());
+    REQUIRE(l == firstBlock);
+    l++;
+    memcpy(&s[tablePos], &l, sizeof(l));
+
+    People ppl2;
+    REQUIRE(!parse_from_buffer(s, &ppl2, People::GetType(), binary_offsets));
+    REQUIRE(!parse_from_buffer_parallel(s.data(), s.size(), &ppl2, People::GetType(), binary_offsets, 4));
+}
+
+TEST_CASE("binarySchemaTest")
+{
+    TeamV1 t1;
+    t1.title = "Team";
+    t1.members.resize(200);
+    for (int i = 0; i < 200; i++)
+    {
+        t1.members[i].name = L"Member" + to_wstring(i);
+        t1.members[i].age = i;
+        t1.members[i].hobbies.push_back("chess");
+        t1.members[i].home.zip = 1000 + i;
+        t1.members[i].home.street = L"Elm";
+    }
+    t1.lead = t1.members[7];
+
+    REQUIRE(GetSchemaFingerprint(TeamV1::GetType()) != GetSchemaFingerprint(TeamV2::GetType()));
+    REQUIRE(GetSchemaFingerprint(TeamV1::GetType()) == GetSchemaFingerprint(TeamV1::GetType()));
+
+    for (int format : { (int)binary_schema, (int)(binary_schema | binary_varint | binary_offsets) })
+    {
+        string s;
+        serialize_to_buffer(s, &t1, TeamV1::GetType(), format);
+
+        // Same schema
+        TeamV1 t1b;
+        REQUIRE(parse_from_buffer(s, &t1b, TeamV1::GetType(), format));
+        REQUIRE(as_xml(&t1, TeamV1::GetType()) == as_xml(&t1b, TeamV1::GetType()));
+
+        BinaryView v;
+        REQUIRE(v.Parse(s.data(), s.size(), TeamV1::GetType(), format));
+        REQUIRE(v.GetString(TeamV1::GetType().GetFieldIndex("title")) == "Team");
+        REQUIRE(!v.Parse(s.data(), s.size(), TeamV2::GetType(), format));
+
+        TeamV1 t1c;
+        BinaryPushDecoder decoder(&t1c, TeamV1::GetType(), format);
+        for (size_t i = 0; i < s.size(); i += 5)
+            decoder.Feed(s.data() + i, min((size_t)5, s.size() - i));
+        REQUIRE(decoder.GetStatus() == decode_done);
+        REQUIRE(as_xml(&t1, TeamV1::GetType()) == as_xml(&t1c, TeamV1::GetType()));
+
+        // Evolved schema, decoded twice to go through cached mapping
+        for (int pass = 0; pass < 2; pass++)
+        {
+            TeamV2 t2;
+            t2.rank = 3;
+            t2.lead.salary = 1.5;
+            REQUIRE(parse_from_buffer(s, &t2, TeamV2::GetType(), format));
+            REQUIRE(t2.rank == 3);
+            REQUIRE(t2.lead.name == L"Member7");
+            REQUIRE(t2.lead.age == 7);
+            REQUIRE(t2.lead.salary == 1.5);
+            REQUIRE(t2.lead.home.zip == 1007);
+            REQUIRE(t2.lead.hobbies.empty());
+            REQUIRE(t2.members.size() == 200);
+            REQUIRE(t2.members[199].name == L"Member199");
+            REQUIRE(t2.members[199].home.street == L"Elm");
+        }
+
+        TeamV2 t2;
+        BinaryPushDecoder decoder2(&t2, TeamV2::GetType(), format);
+        REQUIRE(decoder2.Feed(s.data(), s.size()) == decode_error);
+
+        // Schema not matching fingerprint
+        string s2 = s;
+        s2[0] ^= 1;
+        REQUIRE(!parse_from_buffer(s2, &t2, TeamV2::GetType(), format));
+        REQUIRE(!parse_from_buffer(s.data(), s.size() - 1, &t2, TeamV2::GetType(), format));
+    }
+
+    // Value of same size, but other type is not reinterpreted
+    REQUIRE(GetSchemaFingerprint(ScoreV1::GetType()) != GetSchemaFingerprint(ScoreV2::GetType()));
+    ScoreV1 sc1;
+    sc1.score = 7;
+    sc1.gender = gender_female;
+    sc1.history = { 1, 2, 3 };
+    string s;
+    serialize_to_buffer(s, &sc1, ScoreV1::GetType(), binary_schema);
+
+    ScoreV2 sc2;
+    sc2.score = 0.5f;
+    sc2.gender = -1;
+    REQUIRE(parse_from_buffer(s, &sc2, ScoreV2::GetType(), binary_schema));
+    REQUIRE(sc2.score == 0.5f);
+    REQUIRE(sc2.gender == -1);
+    REQUIRE(sc2.history.empty());
+}
+
+TEST_CASE("binaryTaggedTest")
+{
+    People ppl;
+    MakePeople(ppl, 50);
+    ppl.people[3].childrenAges = { 1, 2 };
+    ClassTypeInfo& PeopleType = People::GetType();
+    ClassTypeInfo& PersonType = Person::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    for (int format : { (int)binary_tagged, (int)(binary_tagged | binary_varint) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+        REQUIRE(s.size() == getEncodedSize64(&ppl, PeopleType, format));
+
+        People ppl2;
+        REQUIRE(parse_from_buffer(s, &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+        REQUIRE(!parse_from_buffer(s.data(), s.size() - 1, &ppl2, PeopleType, format));
+
+        BinaryView v;
+        size_t consumed;
+        REQUIRE(v.Parse(s.data(), s.size(), PeopleType, format, &consumed));
+        REQUIRE(consumed == s.size());
+        REQUIRE(v.GetString(PeopleType.GetFieldIndex("groupName")) == "Generated");
+        vector<BinaryView> people = v.GetObjects(PeopleType.GetFieldIndex("people"));
+        REQUIRE(people.size() == 50);
+        REQUIRE(people[3].GetWString(PersonType.GetFieldIndex("name")) == L"Person3");
+        REQUIRE(people[3].Get<int>(PersonType.GetFieldIndex("age")) == 3);
+        REQUIRE(people[3].GetArray<int>(PersonType.GetFieldIndex("childrenAges"))[1] == 2);
+        REQUIRE(people[3].GetStrings(PersonType.GetFieldIndex("hobbies")).size() == ppl.people[3].hobbies.size());
+
+        BinaryPushDecoder decoder(&ppl2, PeopleType, format);
+        REQUIRE(decoder.Feed(s.data(), s.size()) == decode_error);
+
+        // Appended fields are skipped
+        AddressExt ext;
+        ext.zip = 12345;
+        ext.street = L"Main";
+        ext.lines = { L"a", L"b" };
+        ext.residents = ppl.people;
+        ext.mail.zip = 5;
+        ext.latitude = 1.25;
+        serialize_to_buffer(s, &ext, AddressExt::GetType(), format);
+
+        Address a;
+        REQUIRE(parse_from_buffer(s, &a, Address::GetType(), format));
+        REQUIRE(a.zip == 12345);
+        REQUIRE(a.street == L"Main");
+        REQUIRE(a.lines.size() == 2);
+
+        BinaryView av;
+        REQUIRE(av.Parse(s.data(), s.size(), Address::GetType(), format));
+        REQUIRE(av.GetWString(Address::GetType().GetFieldIndex("street")) == L"Main");
+    }
+}
+
+TEST_CASE("binaryTaggedDeepTest")
+{
+    // Strings nested 10 classes deep
+    Deep10 deep;
+    deep.inner.resize(1);
+    deep.inner[0].inner.inner.resize(1);
+    deep.inner[0].inner.inner[0].inner.inner.resize(1);
+    deep.inner[0].inner.inner[0].inner.inner[0].inner.inner.resize(1);
+    deep.inner[0].inner.inner[0].inner.inner[0].inner.inner[0].inner.inner.resize(1);
+    Deep0& leaf = deep.inner[0].inner.inner[0].inner.inner[0].inner.inner[0].inner.inner[0].inner;
+    for (int i = 0; i < 100000; i++)
+        leaf.strings.push_back(to_string(i));
+
+    ClassTypeInfo& DeepType = Deep10::GetType();
+    string native;
+    serialize_to_buffer(native, &deep, DeepType, binary_native);
+
+    // Each nesting level must not multiply encoding work
+    auto start = std::chrono::steady_clock::now();
+    string s;
+    serialize_to_buffer(s, &deep, DeepType, binary_tagged);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    REQUIRE(elapsed.count() < 1000);
+    REQUIRE(s.size() < native.size() * 2);
+
+    Deep10 deep2;
+    REQUIRE(parse_from_buffer(s.data(), s.size(), &deep2, DeepType, binary_tagged));
+    REQUIRE(deep2.inner[0].inner.inner[0].inner.inner[0].inner.inner[0].inner.inner[0].inner.strings == leaf.strings);
+
+    string counted;
+    serialize_to_buffer(counted, &deep, DeepType, binary_tagged | binary_dictionary);
+    Deep10 deep3;
+    REQUIRE(parse_from_buffer(counted.data(), counted.size(), &deep3, DeepType, binary_tagged | binary_dictionary));
+    REQUIRE(deep3.inner[0].inner.inner[0].inner.inner[0].inner.inner[0].inner.inner[0].inner.strings == leaf.strings);
+}
+
+TEST_CASE("binaryPortableTest")
+{
+    People ppl;
+    MakePeople(ppl, 100);
+    ppl.people[7].name = L"J\u00fcrgen \u6771\u4eac";
+    ppl.people[7].childrenAges = { 1, 0x01020304, -5 };
+    ClassTypeInfo& PeopleType = People::GetType();
+    ClassTypeInfo& PersonType = Person::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    for (int format : { (int)binary_portable, (int)(binary_portable | binary_varint), (int)(binary_portable | binary_offsets),
+        (int)(binary_portable | binary_schema), (int)(binary_portable | binary_tagged) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+        REQUIRE(s.size() == getEncodedSize64(&ppl, PeopleType, format));
+
+        People ppl2;
+        REQUIRE(parse_from_buffer(s, &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+        REQUIRE(!parse_from_buffer(s.data(), s.size() - 1, &ppl2, PeopleType, format));
+
+        // wstring is UTF-8, integers are little-endian
+        REQUIRE(s.find("J\xc3\xbcrgen \xe6\x9d\xb1\xe4\xba\xac") != string::npos);
+        REQUIRE(s.find(string("\x04\x03\x02\x01", 4)) != string::npos);
+
+        BinaryView v;
+        REQUIRE(v.Parse(s.data(), s.size(), PeopleType, format));
+        vector<BinaryView> people = v.GetObjects(PeopleType.GetFieldIndex("people"));
+        REQUIRE(people.size() == 100);
+        REQUIRE(people[7].GetWString(PersonType.GetFieldIndex("name")) == ppl.people[7].name);
+        REQUIRE(people[7].Get<int>(PersonType.GetFieldIndex("age")) == 7);
+        REQUIRE(people[7].GetArray<int>(PersonType.GetFieldIndex("childrenAges"))[2] == -5);
+
+        if (format & binary_tagged)
+            continue;
+
+        for (size_t chunk : { 1, 5, 100000 })
+        {
+            People ppl3;
+            BinaryPushDecoder decoder(&ppl3, PeopleType, format);
+            EDecodeStatus status = decode_need_more;
+
+            for (size_t pos = 0; pos < s.size() && status == decode_need_more; pos += chunk)
+                status = decoder.Feed(&s[pos], std::min(chunk, s.size() - pos));
+
+            REQUIRE(status == decode_done);
+            REQUIRE(as_xml(&ppl3, PeopleType) == xml);
+        }
+    }
+
+    // Lengths are 8 bytes, little-endian
+    Record r;
+    r.strings = { "abc" };
+    string s;
+    serialize_to_buffer(s, &r, Record::GetType(), binary_portable);
+    REQUIRE(s == string("\0\0\0\0\0\0\0\0\1\0\0\0\0\0\0\0\3\0\0\0\0\0\0\0abc", 27));
+
+    // Malformed UTF-8
+    Address a;
+    a.street = L"x";
+    serialize_to_buffer(s, &a, Address::GetType(), binary_portable);
+    s[sizeof(int) + sizeof(bool) + 8] = '\xc0';
+    Address a2;
+    REQUIRE(!parse_from_buffer(s, &a2, Address::GetType(), binary_portable));
+    BinaryPushDecoder decoder(&a2, Address::GetType(), binary_portable);
+    REQUIRE(decoder.Feed(s.data(), s.size()) == decode_error);
+
+    // Byte swapping, odd element counts exercise both vectorized and scalar part
+    for (size_t unit : { 2, 4, 8 })
+    {
+        for (size_t count : { 1, 7, 33 })
+        {
+            vector<unsigned char> src(count * unit), dest(count * unit);
+            for (size_t i = 0; i < src.size(); i++)
+                src[i] = (unsigned char)i;
+
+            SwapBytes(dest.data(), src.data(), count, unit);
+            for (size_t i = 0; i < src.size(); i++)
+                REQUIRE(dest[i] == src[i - i % unit + unit - 1 - i % unit]);
+
+            SwapBytes(dest.data(), dest.data(), count, unit);
+            REQUIRE(dest == src);
+        }
+    }
+}
+
+//
+//  LZ codec under other id, with marker byte - for codec registration test.
+//
+class MarkedLzCodec : public CompressionCodec
+{
+public:
+    virtual int GetId()
+    {
+        return 200;
+    }
+
+    virtual size_t Compress(const char* src, size_t size, char* dest, size_t capacity)
+    {
+        if (capacity < 2)
+            return 0;
+
+        size_t n = GetLzCodec().Compress(src, size, dest + 1, capacity - 1);
+        dest[0] = 'M';
+        return n ? n + 1 : 0;
+    }
+
+    virtual bool Decompress(const char* src, size_t size, char* dest, size_t destSize)
+    {
+        return size && src[0] == 'M' && GetLzCodec().Decompress(src + 1, size - 1, dest, destSize);
+    }
+};
+
+TEST_CASE("compressionTest")
+{
+    CompressionCodec& lz = GetLzCodec();
+
+    // Codec on its own: empty, incompressible, repetitive, overlapping matches
+    string random(5000, 0);
+    for (size_t i = 0, x = 1; i < random.size(); i++)
+        random[i] = (char)((x = x * 1103515245 + 12345) >> 16);
+
+    string text;
+    for (int i = 0; i < 300; i++)
+        text += "hobby " + to_string(i % 7) + ";";
+
+    for (const string& src : { string(), string("a"), random, text, string(70000, 'x'), text + random + text })
+    {
+        string packed(src.size() + 64, 0);
+        size_t n = lz.Compress(src.data(), src.size(), &packed[0], packed.size());
+        REQUIRE(n != 0);
+
+        string out(src.size(), 0);
+        REQUIRE(lz.Decompress(packed.data(), n, &out[0], out.size()));
+        REQUIRE(out == src);
+
+        if (n > 1)
+            REQUIRE(!lz.Decompress(packed.data(), n - 1, &out[0], out.size()));
+    }
+
+    string packed(text.size(), 0);
+    REQUIRE(lz.Compress(text.data(), text.size(), &packed[0], packed.size()) < text.size() / 10);
+    REQUIRE(lz.Compress(random.data(), random.size(), &packed[0], 100) == 0);
+
+    // Chunked stream
+    string stream;
+    {
+        BinaryBufferWriter bw(stream);
+        BinaryCompressWriter cw(bw, lz, 4096);
+        for (int i = 0; i < 10; i++)
+            cw.Write((text + random).data(), text.size() + random.size());
+        cw.Finish();
+        bw.Finish();
+    }
+
+    REQUIRE(IsCompressedStream(stream.data(), stream.size()));
+    string out;
+    size_t chunks = 0;
+    const char* p = stream.data();
+    size_t left = stream.size();
+    REQUIRE(DecompressChunks(p, left, [&](const char* data, size_t size) { out.append(data, size); chunks++; return size <= 4096; }));
+    REQUIRE(left == 0);
+    REQUIRE(out.size() == 10 * (text.size() + random.size()));
+    REQUIRE(chunks == (out.size() + 4095) / 4096);
+
+    // Truncated or corrupted stream fails gracefully
+    for (size_t i = 0; i < stream.size(); i += 97)
+    {
+        string bad = stream;
+        bad[i] ^= 0x5a;
+        p = bad.data();
+        left = bad.size();
+        DecompressChunks(p, left, [](const char*, size_t) { return true; });
+
+        p = stream.data();
+        left = i;
+        REQUIRE(!DecompressChunks(p, left, [](const char*, size_t) { return true; }));
+    }
+
+    // Chunk declaring more data than its compressed size can expand to is rejected
+    string hostile("CRZ\x01\x00\x00\x00\x04" "\x00\x00\x00\x04" "\x04\x00\x00\x00" "\x00\x00\x00\x00" "\x00\x00\x00\x00", 24);
+    p = hostile.data();
+    left = hostile.size();
+    REQUIRE(!DecompressChunks(p, left, [](const char*, size_t) { return true; }));
+
+    // Data compressed to expansion limit is accepted
+    string zeros;
+    {
+        BinaryBufferWriter bw(zeros);
+        BinaryCompressWriter cw(bw, lz, 1 << 20);
+        string z(1 << 20, '\0');
+        cw.Write(z.data(), z.size());
+        cw.Finish();
+        bw.Finish();
+    }
+    p = zeros.data();
+    left = zeros.size();
+    size_t unpacked = 0;
+    REQUIRE(DecompressChunks(p, left, [&](const char*, size_t size) { unpacked += size; return true; }));
+    REQUIRE(unpacked == 1 << 20);
+
+    // Class encoding
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+    string plain;
+    serialize_to_buffer(plain, &ppl, PeopleType);
+
+    for (int format : { (int)binary_compressed, (int)(binary_compressed | binary_varint), (int)(binary_compressed | binary_tagged),
+        (int)(binary_compressed | binary_schema | binary_offsets) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+        REQUIRE(s.size() < plain.size() / 3);
+        REQUIRE(s.size() == getEncodedSize64(&ppl, PeopleType, format));
+
+        People ppl2;
+        REQUIRE(parse_from_buffer(s, &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+        REQUIRE(!parse_from_buffer(s.data(), s.size() - 1, &ppl2, PeopleType, format));
+
+        People ppl3;
+        REQUIRE(parse_from_buffer_parallel(s.data(), s.size(), &ppl3, PeopleType, format, 4));
+        REQUIRE(as_xml(&ppl3, PeopleType) == xml);
+
+        string sp;
+        serialize_to_buffer_parallel(sp, &ppl, PeopleType, format, 4);
+        REQUIRE(sp == s);
+    }
+
+    People empty;
+    string s;
+    serialize_to_buffer(s, &empty, PeopleType, binary_compressed);
+    REQUIRE(parse_from_buffer(s, &ppl, PeopleType, binary_compressed));
+    REQUIRE(ppl.people.empty());
+    MakePeople(ppl, 1000);
+
+    // Registered codec
+    static MarkedLzCodec marked;
+    REQUIRE(!parse_from_buffer(plain, &empty, PeopleType, binary_compressed));
+    serialize_to_buffer(s, &ppl, PeopleType, binary_native, marked);
+    REQUIRE(!parse_from_buffer(s, &empty, PeopleType, binary_compressed));
+    REQUIRE(RegisterCompressionCodec(marked));
+    REQUIRE(RegisterCompressionCodec(marked));
+    REQUIRE(GetCompressionCodec(200) == &marked);
+    MarkedLzCodec other;
+    REQUIRE(!RegisterCompressionCodec(other));
+    People ppl4;
+    REQUIRE(parse_from_buffer(s, &ppl4, PeopleType, binary_compressed));
+    REQUIRE(as_xml(&ppl4, PeopleType) == xml);
+
+    // Files
+    wstring error;
+    REQUIRE(SaveToBinaryFile(L"people.bin", &ppl, PeopleType, error, binary_compressed));
+    People ppl5;
+    REQUIRE(LoadFromBinaryFile(L"people.bin", &ppl5, PeopleType, error, binary_compressed));
+    REQUIRE(as_xml(&ppl5, PeopleType) == xml);
+    remove("people.bin");
+
+    REQUIRE(SaveToXmlFile(L"people.xml", &ppl, PeopleType, error));
+    ifstream plainXml("people.xml", ios::binary | ios::ate);
+    size_t plainSize = (size_t)plainXml.tellg();
+    plainXml.close();
+
+    REQUIRE(SaveToXmlFile(L"people.xml", &ppl, PeopleType, error, &lz));
+    ifstream packedXml("people.xml", ios::binary | ios::ate);
+    REQUIRE((size_t)packedXml.tellg() < plainSize / 5);
+    packedXml.close();
+
+    People ppl6;
+    REQUIRE(LoadFromXmlFile(L"people.xml", &ppl6, PeopleType, error));
+    REQUIRE(as_xml(&ppl6, PeopleType) == xml);
+    remove("people.xml");
+}
+
+TEST_CASE("binaryPackedTest")
+{
+    ClassTypeInfo& RecordType = Record::GetType();
+    int ids = RecordType.GetFieldIndex("ids");
+
+    // Sorted ids, negative deltas, block boundaries, full 64 bit deltas in middle of compressible data
+    vector<vector<int64_t>> samples;
+    for (size_t count : { 1, 2, 128, 129, 1000 })
+    {
+        vector<int64_t> v(count);
+        for (size_t i = 0; i < count; i++)
+            v[i] = 1000000 + (int64_t)i * 3;
+        samples.push_back(v);
+    }
+
+    vector<int64_t> wave(300);
+    for (size_t i = 0; i < wave.size(); i++)
+        wave[i] = (i % 2 ? -1 : 1) * (int64_t)(i * i);
+    samples.push_back(wave);
+
+    vector<int64_t> extremes = samples[4];
+    extremes[500] = INT64_MIN;
+    extremes[501] = INT64_MAX;
+    samples.push_back(extremes);
+    samples.push_back({ INT64_MIN, INT64_MAX, INT64_MIN, INT64_MAX, 0, -1 });
+
+    for (const vector<int64_t>& sample : samples)
+    {
+        Record r;
+        r.ids = sample;
+        r.strings = { "x" };
+
+        string plain;
+        serialize_to_buffer(plain, &r, RecordType);
+
+        for (int format : { (int)binary_packed, (int)(binary_packed | binary_varint), (int)(binary_packed | binary_tagged),
+            (int)(binary_packed | binary_schema | binary_offsets), (int)(binary_packed | binary_portable),
+            (int)(binary_packed | binary_compressed) })
+        {
+            string s;
+            serialize_to_buffer(s, &r, RecordType, format);
+            REQUIRE(s.size() == getEncodedSize64(&r, RecordType, format));
+            if (format == binary_packed)
+                REQUIRE(s.size() <= plain.size() + 1);
+
+            Record r2;
+            REQUIRE(parse_from_buffer(s, &r2, RecordType, format));
+            REQUIRE(r2.ids == sample);
+            REQUIRE(r2.strings == r.strings);
+            REQUIRE(!parse_from_buffer(s.data(), s.size() - 1, &r2, RecordType, format));
+
+            if (format & binary_compressed)
+                continue;
+
+            BinaryView v;
+            REQUIRE(v.Parse(s.data(), s.size(), RecordType, format));
+            REQUIRE(v.GetValues<int64_t>(ids) == sample);
+            REQUIRE(v.GetValues<int>(ids).empty());
+
+            if (format & binary_tagged)
+                continue;
+
+            for (size_t chunk : { 1, 5, 100000 })
+            {
+                Record r3;
+                BinaryPushDecoder decoder(&r3, RecordType, format);
+                EDecodeStatus status = decode_need_more;
+
+                for (size_t pos = 0; pos < s.size() && status == decode_need_more; pos += chunk)
+                    status = decoder.Feed(&s[pos], std::min(chunk, s.size() - pos));
+
+                REQUIRE(status == decode_done);
+                REQUIRE(r3.ids == sample);
+            }
+        }
+    }
+
+    // Dense ids shrink to few bits per value, extreme values cost only their own block
+    Record r;
+    r.ids = samples[4];
+    string plain, s;
+    serialize_to_buffer(plain, &r, RecordType);
+    serialize_to_buffer(s, &r, RecordType, binary_packed);
+    REQUIRE(s.size() < plain.size() / 10);
+
+    r.ids = extremes;
+    serialize_to_buffer(s, &r, RecordType, binary_packed);
+    REQUIRE(s.size() < plain.size() / 5);
+
+    // Array which does not pack is stored raw and can be still viewed in place
+    r.ids = samples.back();
+    serialize_to_buffer(s, &r, RecordType, binary_packed);
+    BinaryView v;
+    REQUIRE(v.Parse(s.data(), s.size(), RecordType, binary_packed));
+    REQUIRE(v.GetArray<int64_t>(ids).size() == r.ids.size());
+    REQUIRE(v.GetArray<int64_t>(ids)[0] == INT64_MIN);
+
+    // Bit width larger than element is rejected
+    r.ids = samples[4];
+    serialize_to_buffer(s, &r, RecordType, binary_packed);
+    s[sizeof(size_t) + 1 + sizeof(int64_t)] = 65;
+    Record r2;
+    REQUIRE(!parse_from_buffer(s, &r2, RecordType, binary_packed));
+    BinaryPushDecoder decoder(&r2, RecordType, binary_packed);
+    REQUIRE(decoder.Feed(s.data(), s.size()) == decode_error);
+
+    // 4 byte elements
+    People ppl;
+    MakePeople(ppl, 100);
+    ppl.people[3].childrenAges = { INT_MIN, INT_MAX, 0, -7, 5 };
+    for (int i = 0; i < 1000; i++)
+        ppl.people[5].childrenAges.push_back(i / 10);
+    ClassTypeInfo& PeopleType = People::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    for (int format : { (int)binary_packed, (int)(binary_packed | binary_portable) })
+    {
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+        People ppl2;
+        REQUIRE(parse_from_buffer(s, &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+    }
+}
+
+TEST_CASE("binaryDictionaryTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ppl.groupName = "fishing";
+    for (int i = 0; i < 1000; i += 7)
+        ppl.people[i].hobbies.push_back("hobby" + to_string(i % 50));
+    ppl.people[3].hobbies.push_back("");
+
+    ClassTypeInfo& PeopleType = People::GetType();
+    ClassTypeInfo& PersonType = Person::GetType();
+    int hobbies = PersonType.GetFieldIndex("hobbies");
+    wstring xml = as_xml(&ppl, PeopleType);
+    string plain;
+    serialize_to_buffer(plain, &ppl, PeopleType, binary_varint);
+
+    for (int format : { (int)binary_dictionary, (int)(binary_dictionary | binary_varint), (int)(binary_dictionary | binary_tagged),
+        (int)(binary_dictionary | binary_schema | binary_offsets), (int)(binary_dictionary | binary_portable),
+        (int)(binary_dictionary | binary_compressed), (int)(binary_dictionary | binary_packed | binary_varint) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+        REQUIRE(s.size() == getEncodedSize64(&ppl, PeopleType, format));
+        if (format & binary_varint)
+            REQUIRE(s.size() + 10000 < plain.size());
+
+        People ppl2;
+        REQUIRE(parse_from_buffer(s, &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+        REQUIRE(!parse_from_buffer(s.data(), s.size() - 1, &ppl2, PeopleType, format));
+
+        People ppl3;
+        REQUIRE(parse_from_buffer_parallel(s.data(), s.size(), &ppl3, PeopleType, format, 4));
+        REQUIRE(as_xml(&ppl3, PeopleType) == xml);
+
+        string sp;
+        serialize_to_buffer_parallel(sp, &ppl, PeopleType, format, 4);
+        REQUIRE(sp == s);
+
+        if (format & binary_compressed)
+            continue;
+
+        BinaryView v;
+        REQUIRE(v.Parse(s.data(), s.size(), PeopleType, format));
+        REQUIRE(v.GetString(PeopleType.GetFieldIndex("groupName")) == "fishing");
+        vector<BinaryView> people = v.GetObjects(PeopleType.GetFieldIndex("people"));
+        REQUIRE(people.size() == 1000);
+        vector<string_view> h = people[3].GetStrings(hobbies);
+        REQUIRE(h.size() == 2);
+        REQUIRE(h[0] == "fishing");
+        REQUIRE(h[1].empty());
+        REQUIRE(people[14].GetStrings(hobbies)[1] == "hobby14");
+        REQUIRE(people[7].GetWString(PersonType.GetFieldIndex("name")) == L"Person7");
+
+        if (format & binary_tagged)
+            continue;
+
+        for (size_t chunk : { 1, 5, 100000 })
+        {
+            People ppl4;
+            BinaryPushDecoder decoder(&ppl4, PeopleType, format);
+            EDecodeStatus status = decode_need_more;
+
+            for (size_t pos = 0; pos < s.size() && status == decode_need_more; pos += chunk)
+                status = decoder.Feed(&s[pos], std::min(chunk, s.size() - pos));
+
+            REQUIRE(status == decode_done);
+            REQUIRE(as_xml(&ppl4, PeopleType) == xml);
+        }
+    }
+
+    // Evolved schema skips strings by reference
+    TeamV1 t1;
+    t1.title = "Team";
+    t1.members.resize(50);
+    for (int i = 0; i < 50; i++)
+    {
+        t1.members[i].name = L"Member" + to_wstring(i);
+        t1.members[i].hobbies = { "chess", "go" };
+    }
+    t1.lead = t1.members[7];
+
+    string s;
+    int format = binary_dictionary | binary_schema | binary_varint;
+    serialize_to_buffer(s, &t1, TeamV1::GetType(), format);
+    TeamV2 t2;
+    REQUIRE(parse_from_buffer(s, &t2, TeamV2::GetType(), format));
+    REQUIRE(t2.lead.name == L"Member7");
+    REQUIRE(t2.members.size() == 50);
+    REQUIRE(t2.members[49].name == L"Member49");
+
+    // Reference past end of dictionary
+    Record r;
+    r.strings = { "a", "b" };
+    serialize_to_buffer(s, &r, Record::GetType(), binary_dictionary);
+    Record r2;
+    REQUIRE(parse_from_buffer(s, &r2, Record::GetType(), binary_dictionary));
+    REQUIRE(r2.strings == r.strings);
+
+    s.back() = 2;
+    REQUIRE(!parse_from_buffer(s, &r2, Record::GetType(), binary_dictionary));
+    BinaryView v;
+    REQUIRE(!v.Parse(s.data(), s.size(), Record::GetType(), binary_dictionary));
+    BinaryPushDecoder decoder(&r2, Record::GetType(), binary_dictionary);
+    REQUIRE(decoder.Feed(s.data(), s.size()) == decode_error);
+}
+
+TEST_CASE("binaryColumnarTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+    ClassTypeInfo& PersonType = Person::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    Company c;
+    c.id = 5;
+    c.office.zip = 10115;
+    c.office.lines = { L"Main", L"Floor 2" };
+    c.branches.resize(70);
+    for (int i = 0; i < 70; i++)
+    {
+        c.branches[i].zip = i;
+        c.branches[i].verified = i % 2 == 0;
+        c.branches[i].street = L"Street" + to_wstring(i);
+        c.branches[i].lines.assign(i % 3, L"line");
+    }
+    c.staff = ppl.people;
+    c.staff.resize(100);
+    ClassTypeInfo& CompanyType = Company::GetType();
+    wstring companyXml = as_xml(&c, CompanyType);
+
+    for (int format : { (int)binary_columnar, (int)(binary_columnar | binary_varint), (int)(binary_columnar | binary_offsets),
+        (int)(binary_columnar | binary_schema), (int)(binary_columnar | binary_portable), (int)(binary_columnar | binary_compressed),
+        (int)(binary_columnar | binary_dictionary | binary_packed), (int)(binary_columnar | binary_tagged) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+        REQUIRE(s.size() == getEncodedSize64(&ppl, PeopleType, format));
+
+        People ppl2;
+        REQUIRE(parse_from_buffer(s, &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+        REQUIRE(!parse_from_buffer(s.data(), s.size() - 1, &ppl2, PeopleType, format));
+
+        People ppl3;
+        REQUIRE(parse_from_buffer_parallel(s.data(), s.size(), &ppl3, PeopleType, format, 4));
+        REQUIRE(as_xml(&ppl3, PeopleType) == xml);
+
+        string sp;
+        serialize_to_buffer_parallel(sp, &ppl, PeopleType, format, 4);
+        REQUIRE(sp == s);
+
+        string cs;
+        serialize_to_buffer(cs, &c, CompanyType, format);
+        Company c2;
+        REQUIRE(parse_from_buffer(cs, &c2, CompanyType, format));
+        REQUIRE(as_xml(&c2, CompanyType) == companyXml);
+
+        if (format & (binary_compressed | binary_tagged))
+            continue;
+
+        // Fixed size columns are contiguous
+        BinaryView v;
+        REQUIRE(v.Parse(s.data(), s.size(), PeopleType, format));
+        int people = PeopleType.GetFieldIndex("people");
+        BinaryArrayView<int> ages = v.GetColumn<int>(people, PersonType.GetFieldIndex("age"));
+        REQUIRE(ages.size() == 1000);
+        size_t matching = 0;
+        for (size_t i = 0; i < ages.size(); i++)
+            matching += ages[i] == ppl.people[i].age;
+        REQUIRE(matching == 1000);
+
+        BinaryArrayView<bool> adult = v.GetColumn<bool>(people, PersonType.GetFieldIndex("isAdult"));
+        REQUIRE(adult.size() == 1000);
+        REQUIRE(adult[20] == true);
+        REQUIRE(v.GetColumn<int>(people, PersonType.GetFieldIndex("name")).empty());
+        REQUIRE(v.GetColumn<int64_t>(people, PersonType.GetFieldIndex("age")).empty());
+        REQUIRE(v.GetObjects(people).empty());
+
+        REQUIRE(v.Parse(cs.data(), cs.size(), CompanyType, format));
+        BinaryArrayView<int> zips = v.GetColumn<int>(CompanyType.GetFieldIndex("branches"), Address::GetType().GetFieldIndex("zip"));
+        REQUIRE(zips.size() == 70);
+        REQUIRE(zips[69] == 69);
+
+        for (size_t chunk : { 1, 5, 100000 })
+        {
+            People ppl4;
+            BinaryPushDecoder decoder(&ppl4, PeopleType, format);
+            EDecodeStatus status = decode_need_more;
+
+            for (size_t pos = 0; pos < s.size() && status == decode_need_more; pos += chunk)
+                status = decoder.Feed(&s[pos], std::min(chunk, s.size() - pos));
+
+            REQUIRE(status == decode_done);
+            REQUIRE(as_xml(&ppl4, PeopleType) == xml);
+
+            Company c3;
+            BinaryPushDecoder decoder2(&c3, CompanyType, format);
+            status = decode_need_more;
+
+            for (size_t pos = 0; pos < cs.size() && status == decode_need_more; pos += chunk)
+                status = decoder2.Feed(&cs[pos], std::min(chunk, cs.size() - pos));
+
+            REQUIRE(status == decode_done);
+            REQUIRE(as_xml(&c3, CompanyType) == companyXml);
+        }
+    }
+
+    // Evolved schema, nested class columns
+    TeamV1 t1;
+    t1.title = "Team";
+    t1.members.resize(50);
+    for (int i = 0; i < 50; i++)
+    {
+        t1.members[i].name = L"Member" + to_wstring(i);
+        t1.members[i].age = i;
+        t1.members[i].hobbies = { "chess" };
+        t1.members[i].home.zip = 1000 + i;
+        t1.members[i].home.street = L"Elm";
+    }
+
+    string s;
+    int format = binary_columnar | binary_schema | binary_varint;
+    serialize_to_buffer(s, &t1, TeamV1::GetType(), format);
+    TeamV2 t2;
+    REQUIRE(parse_from_buffer(s, &t2, TeamV2::GetType(), format));
+    REQUIRE(t2.members.size() == 50);
+    REQUIRE(t2.members[49].name == L"Member49");
+    REQUIRE(t2.members[49].age == 49);
+    REQUIRE(t2.members[49].home.zip == 1049);
+    REQUIRE(t2.members[49].home.street == L"Elm");
+    REQUIRE(t2.members[49].hobbies.empty());
+
+    // Columns compress better than rows
+    string rows, columns;
+    serialize_to_buffer(rows, &ppl, PeopleType, binary_compressed);
+    serialize_to_buffer(columns, &ppl, PeopleType, binary_compressed | binary_columnar);
+    REQUIRE(columns.size() < rows.size());
+}
+
+TEST_CASE("binaryArenaTest")
+{
+    static CountingResource heap;
+    std::pmr::memory_resource* prevDefault = std::pmr::set_default_resource(&heap);
+
+    PmrPeople ppl;
+    ppl.groupName = "Group with rather long name";
+    ppl.people.resize(200);
+    for (int i = 0; i < 200; i++)
+    {
+        PmrPerson& p = ppl.people[i];
+        p.name = ("Person number " + to_string(i)).c_str();
+        p.age = i % 90;
+        for (int j = 0; j < i % 4; j++)
+            p.childrenAges.push_back(j * 2 + 1);
+        p.hobbies.push_back((i % 3) ? "reading books and magazines" : "fishing in the lake");
+    }
+
+    ClassTypeInfo& PmrPeopleType = PmrPeople::GetType();
+    wstring xml = as_xml(&ppl, PmrPeopleType);
+    REQUIRE(xml.find(L"name=\"Person number 199\"") != wstring::npos);
+
+    for (int format : { (int)binary_native, (int)(binary_varint | binary_packed), (int)(binary_offsets | binary_schema),
+        (int)binary_columnar, (int)binary_tagged, (int)(binary_dictionary | binary_portable) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PmrPeopleType, format);
+
+        // Nothing is allocated from default resource
+        CountingResource upstream;
+        heap.allocations = 0;
+        {
+            std::pmr::monotonic_buffer_resource arena(&upstream);
+            PmrPeople ppl2;
+            REQUIRE(parse_from_buffer(s.data(), s.size(), &ppl2, PmrPeopleType, arena, format));
+            REQUIRE(heap.allocations == 0);
+            REQUIRE(upstream.allocations > 0);
+            REQUIRE(ppl2.people.get_allocator().resource() == &arena);
+            REQUIRE(ppl2.people[5].hobbies[0].get_allocator().resource() == &arena);
+            REQUIRE(as_xml(&ppl2, PmrPeopleType) == xml);
+
+            // Arena is not thread safe, so parallel decoding into it allocates from calling thread only
+            ThreadCheckingResource checked(arena);
+            PmrPeople ppl3;
+            DecodeResourceScope scope(&checked);
+            REQUIRE(parse_from_buffer_parallel(s.data(), s.size(), &ppl3, PmrPeopleType, format, 4));
+            REQUIRE(ppl3.people[199].name.get_allocator().resource() == &checked);
+            REQUIRE(as_xml(&ppl3, PmrPeopleType) == xml);
+            REQUIRE(checked.allocations > 0);
+            REQUIRE(checked.otherThreadAllocations == 0);
+            REQUIRE(heap.allocations == 0);
+
+            // Push decoder
+            PmrPeople ppl4;
+            BinaryPushDecoder decoder(&ppl4, PmrPeopleType, format);
+            if (!(format & binary_tagged))
+            {
+                REQUIRE(decoder.Feed(s.data(), s.size()) == decode_done);
+                REQUIRE(as_xml(&ppl4, PmrPeopleType) == xml);
+                REQUIRE(heap.allocations == 0);
+            }
+        }
+
+        // Without resource containers keep their own allocator
+        PmrPeople ppl5;
+        REQUIRE(parse_from_buffer(s, &ppl5, PmrPeopleType, format));
+        REQUIRE(heap.allocations > 0);
+        REQUIRE(as_xml(&ppl5, PmrPeopleType) == xml);
+    }
+
+    // Xml
+    std::pmr::monotonic_buffer_resource arena;
+    PmrPeople ppl6;
+    wstring error;
+    {
+        DecodeResourceScope scope(&arena);
+        REQUIRE(FromXml(&ppl6, xml.c_str(), error));
+    }
+    REQUIRE(ppl6.people[10].hobbies[0].get_allocator().resource() == &arena);
+    REQUIRE(as_xml(&ppl6, PmrPeopleType) == xml);
+
+    std::pmr::set_default_resource(prevDefault);
+}
+
+TEST_CASE("decodePoolTest")
+{
+    People ppl;
+    MakePeople(ppl, 100);
+    ClassTypeInfo& PeopleType = People::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    string s;
+    serialize_to_buffer(s, &ppl, PeopleType);
+
+    DecodePool pool;
+    People* p1 = pool.Parse<People>(s.data(), s.size());
+    REQUIRE(p1 != nullptr);
+    REQUIRE(as_xml(p1, PeopleType) == xml);
+    const Person* people = p1->people.data();
+    const wchar_t* name = p1->people[50].name.data();
+    pool.Release(p1);
+    REQUIRE(pool.FreeCount(PeopleType) == 1);
+
+    // Same instance and storage is reused
+    for (int i = 0; i < 3; i++)
+    {
+        People* p2 = pool.Parse<People>(s.data(), s.size());
+        REQUIRE(p2 == p1);
+        REQUIRE(pool.FreeCount(PeopleType) == 0);
+        REQUIRE(p2->people.data() == people);
+        REQUIRE(p2->people[50].name.data() == name);
+        REQUIRE(as_xml(p2, PeopleType) == xml);
+        pool.Release(p2);
+    }
+
+    // Smaller message keeps capacity
+    People small;
+    MakePeople(small, 10);
+    string ss;
+    serialize_to_buffer(ss, &small, PeopleType);
+    People* p3 = pool.Parse<People>(ss.data(), ss.size());
+    REQUIRE(as_xml(p3, PeopleType) == as_xml(&small, PeopleType));
+    REQUIRE(p3->people.capacity() >= 100);
+
+    // Second instance while first is in use, malformed data returns instance to pool
+    REQUIRE(pool.Parse<People>(s.data(), s.size() - 1) == nullptr);
+    REQUIRE(pool.FreeCount(PeopleType) == 1);
+    pool.Release(p3);
+    REQUIRE(pool.FreeCount(PeopleType) == 2);
+
+    // Fields missing from evolved schema get default values
+    TeamV2 t2;
+    t2.rank = 3;
+    t2.lead.salary = 1000;
+    t2.lead.hobbies = "chess";
+    t2.members.resize(2);
+    t2.members[1].salary = 2000;
+    string s2;
+    serialize_to_buffer(s2, &t2, TeamV2::GetType(), binary_schema);
+    TeamV2* pt = pool.Parse<TeamV2>(s2.data(), s2.size(), binary_schema);
+    REQUIRE(pt->lead.salary == 1000);
+    pool.Release(pt);
+
+    TeamV1 t1;
+    t1.title = "Team";
+    t1.lead.age = 40;
+    t1.members.resize(1);
+    string s1;
+    serialize_to_buffer(s1, &t1, TeamV1::GetType(), binary_schema);
+    pt = pool.Parse<TeamV2>(s1.data(), s1.size(), binary_schema);
+    REQUIRE(pt->rank == 0);
+    REQUIRE(pt->lead.age == 40);
+    REQUIRE(pt->lead.salary == 0);
+    REQUIRE(pt->lead.hobbies.empty());
+    REQUIRE(pt->members.size() == 1);
+    REQUIRE(pt->members[0].salary == 0);
+
+    // Explicit reset
+    pt->lead.name = L"Lead";
+    pt->members.resize(5);
+    pool.Reset(pt);
+    REQUIRE(pt->lead.name.empty());
+    REQUIRE(pt->lead.age == 0);
+    REQUIRE(pt->members.empty());
+    pool.Release(pt);
+
+    // Instances above limit are deleted
+    DecodePool limited(1);
+    ReflectClass* a = limited.Acquire(PeopleType);
+    People* b = limited.Acquire<People>();
+    REQUIRE((void*)a->ReflectGetInstance() != (void*)b);
+    limited.Release(a);
+    limited.Release(b);
+    REQUIRE(limited.FreeCount(PeopleType) == 1);
+    limited.Clear();
+    REQUIRE(limited.FreeCount(PeopleType) == 0);
+}
+
+TEST_CASE("binaryUncheckedTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    Company c;
+    c.id = 3;
+    c.office.street = L"Main";
+    c.office.lines = { L"Floor 1", L"" };
+    c.branches.resize(10);
+    c.staff = ppl.people;
+    c.staff.resize(200);
+    ClassTypeInfo& CompanyType = Company::GetType();
+    wstring companyXml = as_xml(&c, CompanyType);
+
+    for (int format : { (int)binary_native, (int)binary_varint, (int)binary_portable, (int)(binary_portable | binary_varint),
+        (int)(binary_offsets | binary_varint), (int)binary_offsets })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+
+        BinaryBudget budget;
+        REQUIRE(ValidateBinaryData(s.data(), s.size(), PeopleType, format, &budget));
+        REQUIRE(budget.size == s.size());
+        REQUIRE(budget.allocations > 1000);
+        REQUIRE(budget.bytes > 1000 * sizeof(Person));
+
+        People ppl2;
+        REQUIRE(parse_from_buffer_unchecked(s.data(), s.size(), &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+
+        // Trailing data belongs to next message
+        string twice = s + s;
+        REQUIRE(ValidateBinaryData(twice.data(), twice.size(), PeopleType, format, &budget));
+        REQUIRE(budget.size == s.size());
+
+        string cs;
+        serialize_to_buffer(cs, &c, CompanyType, format);
+        REQUIRE(ValidateBinaryData(cs.data(), cs.size(), CompanyType, format));
+        Company c2;
+        REQUIRE(parse_from_buffer_unchecked(cs.data(), cs.size(), &c2, CompanyType, format));
+        REQUIRE(as_xml(&c2, CompanyType) == companyXml);
+
+        // Truncated buffers are rejected
+        size_t rejected = 0, truncated = 0;
+        for (size_t len = 0; len < s.size(); len += 97, truncated++)
+            rejected += !ValidateBinaryData(s.data(), len, PeopleType, format);
+        REQUIRE(rejected == truncated);
+
+        // Validation agrees with checked decoding on corrupted data
+        size_t agree = 0, corrupted = 0;
+        for (size_t pos = 0; pos < s.size(); pos += 131, corrupted++)
+        {
+            string bad = s;
+            bad[pos] = (char)(bad[pos] ^ 0xA5);
+            People ppl3;
+            bool valid = ValidateBinaryData(bad.data(), bad.size(), PeopleType, format);
+            agree += valid == parse_from_buffer(bad, &ppl3, PeopleType, format);
+        }
+        REQUIRE(agree == corrupted);
+    }
+
+    // Malformed UTF-8 is found inside and after long ASCII runs
+    Address a;
+    a.street = wstring(70, L'x');
+    string as;
+    serialize_to_buffer(as, &a, Address::GetType(), binary_portable);
+    REQUIRE(ValidateBinaryData(as.data(), as.size(), Address::GetType(), binary_portable));
+    for (size_t pos : { 0, 31, 32, 40, 69 })
+    {
+        string bad = as;
+        bad[sizeof(int) + sizeof(bool) + 8 + pos] = '\xc0';
+        REQUIRE(!ValidateBinaryData(bad.data(), bad.size(), Address::GetType(), binary_portable));
+    }
+
+    // Other formats are decoded by checked decoder
+    string s;
+    serialize_to_buffer(s, &ppl, PeopleType, binary_schema | binary_packed);
+    REQUIRE(!ValidateBinaryData(s.data(), s.size(), PeopleType, binary_schema | binary_packed));
+    People ppl4;
+    REQUIRE(parse_from_buffer_unchecked(s.data(), s.size(), &ppl4, PeopleType, binary_schema | binary_packed));
+    REQUIRE(as_xml(&ppl4, PeopleType) == xml);
+}
+
+TEST_CASE("binaryDecodeLimitsTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+    wstring xml = as_xml(&ppl, PeopleType);
+
+    for (int format : { (int)binary_native, (int)binary_varint, (int)(binary_offsets | binary_varint), (int)binary_schema,
+        (int)binary_tagged, (int)binary_dictionary, (int)binary_columnar, (int)binary_packed, (int)binary_compressed,
+        (int)binary_portable, (int)(binary_schema | binary_columnar) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+
+        BinaryDecodeOptions options;
+        People ppl2;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &ppl2, PeopleType, options, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == xml);
+
+        options.maxBytes = 1000 * sizeof(Person);
+        People ppl3;
+        REQUIRE(!parse_from_buffer(s.data(), s.size(), &ppl3, PeopleType, options, format));
+        options.maxBytes = 100 << 20;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &ppl3, PeopleType, options, format));
+
+        options.maxArrayCount = 999;
+        People ppl4;
+        REQUIRE(!parse_from_buffer(s.data(), s.size(), &ppl4, PeopleType, options, format));
+        options.maxArrayCount = 1000;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &ppl4, PeopleType, options, format));
+
+        // Array elements are nested one level deeper
+        options.maxDepth = 0;
+        People ppl5;
+        REQUIRE(!parse_from_buffer(s.data(), s.size(), &ppl5, PeopleType, options, format));
+        options.maxDepth = 1;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &ppl5, PeopleType, options, format));
+        REQUIRE(as_xml(&ppl5, PeopleType) == xml);
+    }
+
+    Company c;
+    c.office.lines = { L"Main" };
+    c.staff.resize(3);
+    ClassTypeInfo& CompanyType = Company::GetType();
+    string cs;
+    serialize_to_buffer(cs, &c, CompanyType, binary_varint);
+    BinaryDecodeOptions options;
+    options.maxDepth = 0;
+    Company c2;
+    REQUIRE(!parse_from_buffer(cs.data(), cs.size(), &c2, CompanyType, options, binary_varint));
+    options.maxDepth = 1;
+    REQUIRE(parse_from_buffer(cs.data(), cs.size(), &c2, CompanyType, options, binary_varint));
+
+    // Hostile element count within remaining bytes fails before array is allocated
+    string hostile;
+    hostile += (char)0;                             // groupName
+    hostile += "\xC0\x84\x3D";                      // 1000000 people
+    hostile.append(1000000, (char)0);
+    options = BinaryDecodeOptions();
+    options.maxBytes = 1 << 20;
+    People ppl6;
+    REQUIRE(!parse_from_buffer(hostile.data(), hostile.size(), &ppl6, PeopleType, options, binary_varint));
+    REQUIRE(ppl6.people.capacity() == 0);
+
+    options = BinaryDecodeOptions();
+    options.maxArrayCount = 1000;
+    REQUIRE(!parse_from_buffer(hostile.data(), hostile.size(), &ppl6, PeopleType, options, binary_varint));
+    REQUIRE(ppl6.people.capacity() == 0);
+
+    // Push decoder does not know remaining data size, so it relies on limits only
+    BinaryPushDecoder decoder(&ppl6, PeopleType, binary_varint, options);
+    REQUIRE(decoder.Feed(hostile.data(), 4) == decode_error);
+    REQUIRE(ppl6.people.capacity() == 0);
+
+    string hostileName = "\xC0\x84\x3D";         // 1000000 bytes long groupName
+    options = BinaryDecodeOptions();
+    options.maxBytes = 1000;
+    decoder.Reset(&ppl6, PeopleType, binary_varint, options);
+    REQUIRE(decoder.Feed(hostileName.data(), hostileName.size()) == decode_error);
+    REQUIRE(ppl6.groupName.capacity() < 1000);
+
+    options = BinaryDecodeOptions();
+    options.maxBytes = 1000 * sizeof(Person);
+    string cs2;
+    serialize_to_buffer(cs2, &ppl, PeopleType, binary_compressed | binary_dictionary);
+    REQUIRE(!parse_from_buffer(cs2.data(), cs2.size(), &ppl6, PeopleType, options, binary_compressed | binary_dictionary));
+}
+
+TEST_CASE("binaryProjectionTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+
+    BinaryProjection proj(PeopleType);
+    REQUIRE(proj.Select("people.age"));
+    REQUIRE(proj.Select("people.gender"));
+    REQUIRE(!proj.Select("people.unknown"));
+    REQUIRE(!proj.Select("people.age.value"));
+    REQUIRE(!proj.Select("groupName2"));
+
+    for (int format : { (int)binary_native, (int)binary_varint, (int)(binary_offsets | binary_varint), (int)binary_schema,
+        (int)binary_tagged, (int)binary_dictionary, (int)binary_columnar, (int)binary_packed, (int)binary_compressed,
+        (int)binary_portable, (int)(binary_schema | binary_columnar), (int)(binary_tagged | binary_dictionary) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+
+        People ppl2;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &ppl2, proj, format));
+        REQUIRE(ppl2.groupName.empty());
+        REQUIRE(ppl2.people.size() == ppl.people.size());
+
+        for (size_t i = 0; i < ppl.people.size(); i++)
+        {
+            REQUIRE(ppl2.people[i].age == ppl.people[i].age);
+            REQUIRE(ppl2.people[i].gender == ppl.people[i].gender);
+            REQUIRE(ppl2.people[i].name.empty());
+            REQUIRE(ppl2.people[i].hobbies.empty());
+            REQUIRE(ppl2.people[i].childrenAges.empty());
+        }
+
+        // Truncated data
+        REQUIRE(!parse_from_buffer(s.data(), s.size() / 2, &ppl2, proj, format));
+    }
+
+    // Whole field selection, nested classes
+    Company c;
+    c.id = 7;
+    c.employees = 3;
+    c.office.zip = 12345;
+    c.office.street = L"Main street";
+    c.office.lines = { L"First", L"Second" };
+    c.branches.resize(2);
+    c.branches[1].zip = 555;
+    c.branches[1].lines = { L"Branch" };
+    c.staff.resize(3);
+    c.staff[2].name = L"Staff";
+    c.staff[2].hobbies = { "chess" };
+    ClassTypeInfo& CompanyType = Company::GetType();
+
+    BinaryProjection cproj(CompanyType);
+    REQUIRE(cproj.Select("office.zip"));
+    REQUIRE(cproj.Select("branches.lines"));
+    REQUIRE(cproj.Select("staff"));
+
+    for (int format : { (int)binary_native, (int)binary_varint, (int)binary_tagged, (int)binary_columnar, (int)binary_schema })
+    {
+        string s;
+        serialize_to_buffer(s, &c, CompanyType, format);
+
+        // Unselected fields keep their values
+        Company c2;
+        c2.id = -1;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &c2, cproj, format));
+        REQUIRE(c2.id == -1);
+        REQUIRE(c2.office.zip == 12345);
+        REQUIRE(c2.office.street.empty());
+        REQUIRE(c2.office.lines.empty());
+        REQUIRE(c2.branches.size() == 2);
+        REQUIRE(c2.branches[1].zip == 0);
+        REQUIRE(c2.branches[1].lines == c.branches[1].lines);
+        REQUIRE(c2.staff.size() == 3);
+        REQUIRE(c2.staff[2].name == c.staff[2].name);
+        REQUIRE(c2.staff[2].hobbies == c.staff[2].hobbies);
+    }
+
+    // Selecting whole class decodes all fields
+    BinaryProjection all(CompanyType);
+    REQUIRE(all.Select("staff"));
+    REQUIRE(all.Select("staff.name"));          // Already selected
+    REQUIRE(all.Select("id"));
+    REQUIRE(all.Select("employees"));
+    REQUIRE(all.Select("office"));
+    REQUIRE(all.Select("branches"));
+    string s;
+    serialize_to_buffer(s, &c, CompanyType, binary_varint);
+    Company c3;
+    REQUIRE(parse_from_buffer(s.data(), s.size(), &c3, all, binary_varint));
+    REQUIRE(as_xml(&c3, CompanyType) == as_xml(&c, CompanyType));
+
+    // Data of other schema version is not supported
+    TeamV1 t1;
+    t1.members.resize(2);
+    string ts;
+    serialize_to_buffer(ts, &t1, TeamV1::GetType(), binary_schema);
+    TeamV2 t2;
+    BinaryProjection tproj(TeamV2::GetType());
+    REQUIRE(tproj.Select("members.age"));
+    REQUIRE(!parse_from_buffer(ts.data(), ts.size(), &t2, tproj, binary_schema));
+}
+
+TEST_CASE("binaryLocatorTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+
+    for (int format : { (int)binary_native, (int)binary_varint, (int)(binary_offsets | binary_varint), (int)binary_schema,
+        (int)binary_tagged, (int)binary_dictionary, (int)binary_columnar, (int)binary_packed, (int)binary_portable,
+        (int)(binary_tagged | binary_dictionary) })
+    {
+        string s;
+        serialize_to_buffer(s, &ppl, PeopleType, format);
+
+        People expected = ppl;
+        expected.people[3].age = 42;
+        expected.people[999].gender = gender_male;
+        expected.people[0].isAdult = true;
+
+        BinaryLocator loc;
+        REQUIRE(loc.Parse(&s[0], s.size(), PeopleType, format));
+        REQUIRE(loc.Set("people[3].age", 42));
+        REQUIRE(loc.Set("people[999].gender", gender_male));
+        REQUIRE(loc.Set("people[0].isAdult", true));
+
+        bool columnar = (format & binary_columnar) && !(format & binary_tagged);
+        if (!columnar && !(format & binary_packed))
+        {
+            expected.people[3].childrenAges[2] = 77;
+            REQUIRE(loc.Set("people[3].childrenAges[2]", 77));
+        }
+
+        int age = 0;
+        REQUIRE(loc.Get("people[3].age", age));
+        REQUIRE(age == 42);
+
+        // Located fields are cached
+        size_t offset, size, offset2, size2;
+        REQUIRE(loc.Find("people[3].age", offset, size));
+        REQUIRE(loc.Find("people[3].age", offset2, size2));
+        REQUIRE(offset == offset2);
+        REQUIRE(size == sizeof(int));
+        REQUIRE(offset + size <= s.size());
+
+        // Not fixed size fields or out of range
+        REQUIRE(!loc.Set("people[3].age", (int64_t)42));
+        REQUIRE(!loc.Set("people[1000].age", 1));
+        REQUIRE(!loc.Set("people.age", 1));
+        REQUIRE(!loc.Set("people[3]", 1));
+        REQUIRE(!loc.Set("people[3].name", 1));
+        REQUIRE(!loc.Set("people[3].age.x", 1));
+        REQUIRE(!loc.Set("people[-1].age", 1));
+        REQUIRE(!loc.Set("groupName", 1));
+        REQUIRE(!loc.Set("", 1));
+
+        People ppl2;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &ppl2, PeopleType, format));
+        REQUIRE(as_xml(&ppl2, PeopleType) == as_xml(&expected, PeopleType));
+    }
+
+    // Compressed data cannot be patched
+    string cs;
+    serialize_to_buffer(cs, &ppl, PeopleType, binary_compressed);
+    BinaryLocator cloc;
+    REQUIRE(!cloc.Parse(&cs[0], cs.size(), PeopleType, binary_compressed));
+    REQUIRE(!cloc.Set("people[3].age", 42));
+
+    // Nested classes
+    Company c;
+    c.id = 7;
+    c.employees = 3;
+    c.office.zip = 12345;
+    c.office.verified = false;
+    c.branches.resize(2);
+    c.staff.resize(3);
+    c.staff[2].name = L"Staff";
+    ClassTypeInfo& CompanyType = Company::GetType();
+
+    for (int format : { (int)binary_native, (int)binary_varint, (int)binary_tagged, (int)binary_portable })
+    {
+        string s;
+        serialize_to_buffer(s, &c, CompanyType, format);
+
+        Company expected = c;
+        expected.id = 8;
+        expected.office.verified = true;
+        expected.branches[1].zip = 555;
+        expected.staff[2].age = 30;
+
+        BinaryLocator loc;
+        REQUIRE(loc.Parse(&s[0], s.size(), CompanyType, format));
+        REQUIRE(loc.Set("id", 8));
+        REQUIRE(loc.Set("office.verified", true));
+        REQUIRE(loc.Set("branches[1].zip", 555));
+        REQUIRE(loc.Set("staff[2].age", 30));
+        REQUIRE(!loc.Set("office", 1));
+        REQUIRE(!loc.Set("office.lines[0]", 1));
+
+        Company c2;
+        REQUIRE(parse_from_buffer(s.data(), s.size(), &c2, CompanyType, format));
+        REQUIRE(as_xml(&c2, CompanyType) == as_xml(&expected, CompanyType));
+    }
+}
+
+TEST_CASE("binaryPatchTest")
+{
+    People ppl;
+    MakePeople(ppl, 1000);
+    ClassTypeInfo& PeopleType = People::GetType();
+
+    // Equal instances
+    People same = ppl;
+    REQUIRE(Diff(&ppl, &same, PeopleType).empty());
+    REQUIRE(ApplyPatch(&same, PeopleType, "", 0));
+
+    People changed = ppl;
+    changed.groupName = "Changed";
+    changed.people[10].age = 77;
+    changed.people[500].name = L"Renamed";
+    changed.people[20].childrenAges.push_back(5);
+    changed.people[30].hobbies.insert(changed.people[30].hobbies.begin(), "swimming");
+    changed.people.erase(changed.people.begin() + 3);
+    changed.people.resize(changed.people.size() + 2);
+    changed.people.back().name = L"Appended";
+
+    string patch = Diff(&ppl, &changed, PeopleType);
+    string full;
+    serialize_to_buffer(full, &changed, PeopleType, binary_varint);
+    REQUIRE(patch.size() < full.size() / 10);
+
+    People replica = ppl;
+    REQUIRE(ApplyPatch(&replica, PeopleType, patch.data(), patch.size()));
+    REQUIRE(as_xml(&replica, PeopleType) == as_xml(&changed, PeopleType));
+    REQUIRE(Diff(&replica, &changed, PeopleType).empty());
+
+    // Patch does not fit other instance, or is malformed
+    People small;
+    MakePeople(small, 10);
+    REQUIRE(!ApplyPatch(&small, PeopleType, patch.data(), patch.size()));
+    for (size_t len = 1; len < patch.size(); len += 7)
+    {
+        People truncated = ppl;
+        REQUIRE(!ApplyPatch(&truncated, PeopleType, patch.data(), len));
+    }
+
+    // Series of edits, each replicated by patch
+    People state = ppl;
+    replica = ppl;
+    for (int i = 0; i < 50; i++)
+    {
+        People next = state;
+        size_t n = next.people.size();
+        switch (i % 5)
+        {
+            case 0: next.people[(i * 37) % n].age += i; break;
+            case 1: next.people.erase(next.people.begin() + (i * 13) % n, next.people.begin() + (i * 13) % n + 1 + i % 3); break;
+            case 2: next.people.insert(next.people.begin() + (i * 7) % n, next.people[i]); break;
+            case 3: next.people[(i * 11) % n].childrenAges.clear(); next.people[(i * 17) % n].hobbies.push_back("cycling"); break;
+            case 4: next.people[0].gender = gender_female; next.people[n - 1].isAdult = !next.people[n - 1].isAdult; break;
+        }
+
+        string p = Diff(&state, &next, PeopleType);
+        REQUIRE(ApplyPatch(&replica, PeopleType, p.data(), p.size()));
+        REQUIRE(as_xml(&replica, PeopleType) == as_xml(&next, PeopleType));
+        state = next;
+    }
+
+    // Too many edits for edit script search, changed range is replaced
+    People reversed = ppl;
+    std::reverse(reversed.people.begin() + 100, reversed.people.end() - 100);
+    patch = Diff(&ppl, &reversed, PeopleType);
+    replica = ppl;
+    REQUIRE(ApplyPatch(&replica, PeopleType, patch.data(), patch.size()));
+    REQUIRE(as_xml(&replica, PeopleType) == as_xml(&reversed, PeopleType));
+
+    // Nested classes
+    Company c;
+    c.id = 7;
+    c.employees = 3;
+    c.office.zip = 12345;
+    c.office.verified = false;
+    c.office.lines = { L"First", L"Second" };
+    c.branches.resize(3);
+    for (Address& a : c.branches)
+        a.zip = 1, a.verified = false;
+    c.staff.resize(3);
+    ClassTypeInfo& CompanyType = Company::GetType();
+
+    Company c2 = c;
+    c2.office.verified = true;
+    c2.office.lines[1] = L"Changed";
+    c2.branches.insert(c2.branches.begin() + 1, Address());
+    c2.branches[1].zip = 555;
+    c2.branches[1].verified = true;
+    c2.branches[1].street = L"Inserted";
+    c2.staff.pop_back();
+    c2.staff[0].name = L"Staff";
+
+    patch = Diff(&c, &c2, CompanyType);
+    Company c3 = c;
+    REQUIRE(ApplyPatch(&c3, CompanyType, patch.data(), patch.size()));
+    REQUIRE(as_xml(&c3, CompanyType) == as_xml(&c2, CompanyType));
+
+    // Removing everything
+    Company empty = c;
+    empty.office.lines.clear();
+    empty.branches.clear();
+    empty.staff.clear();
+    patch = Diff(&c, &empty, CompanyType);
+    c3 = c;
+    REQUIRE(ApplyPatch(&c3, CompanyType, patch.data(), patch.size()));
+    REQUIRE(as_xml(&c3, CompanyType) == as_xml(&empty, CompanyType));
+}
+
 #define TEST_SET1
 #define TEST_SET2
 /*
@@ -150,4 +2544,4 @@ int main(void)
     return 0;
 }
 
-*/
\ No newline at end of file
+*/
\ No newline at end of file